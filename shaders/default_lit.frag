@@ -1,17 +1,35 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require  // runtime descriptor arrays
 
 layout (location = 0) in vec3 inColor;
 layout (location = 1) in float inDist;
 
 layout (location = 0) out vec4 outFragColor;
 
-layout (set = 0, binding = 1) uniform SceneData{
+// Specialization constants, see LitSpecConstants
+layout (constant_id = 0) const bool FOG_ENABLED = true;
+layout (constant_id = 1) const int LIGHTING_MODEL = 0;  // 0: ambient, 1: unlit
+
+struct SceneData {
     vec4 fog_color;
     vec4 fog_distances;  // min, max, unused, unused
     vec4 ambient_color;
     vec4 sun_direction;  // x, y, z, power
     vec4 sun_color;
-} sceneData;
+};
+
+// Bindless set, see BindlessSet.  One scene entry per frame in flight.
+layout (std430, set = 0, binding = 0) readonly buffer SceneBuffer {
+    SceneData scenes[];
+} sceneBuffers[];
+
+// see FramePushConstants
+layout (push_constant) uniform FrameConstants {
+    uint camera_buf;
+    uint scene_buf;
+    uint object_buf;
+    uint frame_idx;
+} frame;
 
 // inverse lerp
 float inv_mix(float x, float y, float a) {
@@ -19,8 +37,17 @@ float inv_mix(float x, float y, float a) {
 }
 
 void main() {
-    vec3 fog = vec3(0, 0, 0);
+    SceneData sceneData = sceneBuffers[frame.scene_buf].scenes[frame.frame_idx];
+    vec3 lit = inColor;
+    if (LIGHTING_MODEL == 0) {
+        lit += sceneData.ambient_color.xyz;
+    }
+
+    if (!FOG_ENABLED) {
+        outFragColor = vec4(lit, 1.0f);
+        return;
+    }
+
     float fog_p = clamp(inv_mix(sceneData.fog_distances.x, sceneData.fog_distances.y, inDist), 0.0f, 1.0f);
-    vec3 lit = inColor + sceneData.ambient_color.xyz;
     outFragColor = vec4(fog_p * sceneData.fog_color.rgb + (1 - fog_p) * lit, 1.0f);
 }
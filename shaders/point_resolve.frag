@@ -0,0 +1,68 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require  // runtime descriptor arrays
+
+// Writes the points rasterized by point_raster.comp, drawn as a fullscreen
+// triangle.  Lit and fogged like point.frag.
+
+layout (location = 0) out vec4 outFragColor;
+
+// Specialization constants, see PointResolveSpecConstants
+layout (constant_id = 0) const bool FOG_ENABLED = true;
+layout (constant_id = 1) const int LIGHTING_MODEL = 0;  // 0: ambient, 1: unlit
+layout (constant_id = 2) const uint RASTER_BUF = 0;     // bindless slot
+layout (constant_id = 3) const uint WIDTH = 1;
+
+struct SceneData {
+    vec4 fog_color;
+    vec4 fog_distances;  // min, max, unused, unused
+    vec4 ambient_color;
+    vec4 sun_direction;  // x, y, z, power
+    vec4 sun_color;
+};
+
+// Bindless set, see BindlessSet
+layout (std430, set = 0, binding = 0) readonly buffer SceneBuffer {
+    SceneData scenes[];
+} sceneBuffers[];
+
+// 64-bit words, read as x: color, y: depth
+layout (std430, set = 0, binding = 0) readonly buffer RasterBuffer {
+    uvec2 pixels[];
+} rasterBuffers[];
+
+// see FramePushConstants
+layout (push_constant) uniform FrameConstants {
+    uint camera_buf;
+    uint scene_buf;
+    uint object_buf;
+    uint frame_idx;
+} frame;
+
+// inverse lerp
+float inv_mix(float x, float y, float a) {
+    return (a - x) / (y - x);
+}
+
+void main() {
+    uvec2 px = uvec2(gl_FragCoord.xy);
+    uvec2 pixel = rasterBuffers[RASTER_BUF].pixels[px.y * WIDTH + px.x];
+    if (pixel.y == 0xFFFFFFFFu) {
+        discard;  // no point here
+    }
+    float depth = uintBitsToFloat(pixel.y);
+    gl_FragDepth = depth;
+
+    SceneData sceneData = sceneBuffers[frame.scene_buf].scenes[frame.frame_idx];
+    vec3 lit = unpackUnorm4x8(pixel.x).rgb;
+    if (LIGHTING_MODEL == 0) {
+        lit += sceneData.ambient_color.xyz;
+    }
+
+    if (!FOG_ENABLED) {
+        outFragColor = vec4(lit, 1.0f);
+        return;
+    }
+
+    float fog_p = clamp(inv_mix(sceneData.fog_distances.x, sceneData.fog_distances.y, depth), 0.0f, 1.0f);
+    outFragColor = vec4(fog_p * sceneData.fog_color.rgb + (1 - fog_p) * lit, 1.0f);
+}
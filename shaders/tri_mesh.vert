@@ -1,4 +1,5 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require  // runtime descriptor arrays
 
 layout (location = 0) in vec3 vPos;
 layout (location = 1) in vec3 vNormal;
@@ -7,31 +8,42 @@ layout (location = 2) in vec3 vColor;
 layout (location = 0) out vec3 outColor;
 layout (location = 1) out float outDist;
 
-// Decriptor set at slot 0
-// Binding 0 within that set
-layout (set = 0, binding = 0) uniform CameraBuffer {
+// Bindless set, see BindlessSet.  All storage buffers live in binding 0,
+// the push constants say which slot holds what.
+layout (std430, set = 0, binding = 0) readonly buffer CameraBuffer {
     mat4 view;
     mat4 proj;
     mat4 viewproj;
-} CameraData;
+} cameraBuffers[];
 
 struct ObjectData {
-    mat4 model_mat;
+    vec4 position_scale;  // model transform, see to_world()
+    vec4 rotation;        // unit quaternion
 };
 
-layout(std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
+layout (std430, set = 0, binding = 0) readonly buffer ObjectBuffer {
     ObjectData objects[];
-} objectBuffer;
+} objectBuffers[];
 
-layout (push_constant) uniform constants {
-    vec4 data;
-    mat4 render_matrix;
-} PushConstants;
+// a model space point in world space: scaled, rotated, then translated
+vec3 to_world(ObjectData obj, vec3 p) {
+    vec4 q = obj.rotation;
+    p += 2.0f * cross(q.xyz, cross(q.xyz, p) + q.w * p);
+    return obj.position_scale.xyz + obj.position_scale.w * p;
+}
+
+// see FramePushConstants
+layout (push_constant) uniform FrameConstants {
+    uint camera_buf;
+    uint scene_buf;
+    uint object_buf;
+    uint frame_idx;
+} frame;
 
 void main() {
-    mat4 model = objectBuffer.objects[gl_BaseInstance].model_mat;
-    mat4 transform = CameraData.viewproj * model;
-    gl_Position = transform * vec4(vPos, 1.0f);
+    ObjectData obj = objectBuffers[frame.object_buf].objects[gl_BaseInstance];
+    vec3 world = to_world(obj, vPos);
+    gl_Position = cameraBuffers[frame.camera_buf].viewproj * vec4(world, 1.0f);
     outColor = vColor;
     outDist = gl_Position.z / gl_Position.w;
 }
@@ -0,0 +1,133 @@
+#include "bindless.h"
+#include <stdexcept>
+#include "engine.h"
+#include "vk_init.h"
+
+uint32_t BindlessSet::Slots::alloc() {
+    if (!free.empty()) {
+        uint32_t slot = free.back();
+        free.pop_back();
+        return slot;
+    }
+    if (next == max) {
+        throw std::runtime_error("Out of bindless descriptor slots.");
+    }
+    return next++;
+}
+
+void BindlessSet::init(VkDevice device,
+                       DescriptorLayoutCache& layout_cache,
+                       uint32_t max_buffers,
+                       uint32_t max_textures) {
+    _device = device;
+    _buffers.max = max_buffers;
+    _textures.max = max_textures;
+
+    VkDescriptorSetLayoutBinding bindings[] = {
+        {
+            .binding = BINDLESS_BUFFER_BINDING,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = max_buffers,
+            .stageFlags = VK_SHADER_STAGE_ALL,
+        },
+        {
+            .binding = BINDLESS_TEXTURE_BINDING,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .descriptorCount = max_textures,
+            .stageFlags = VK_SHADER_STAGE_ALL,
+        },
+    };
+    // unused slots are never written, hence partially bound
+    VkDescriptorBindingFlags binding_flags[] = {
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+        VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+            VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT,
+    };
+    VkDescriptorSetLayoutBindingFlagsCreateInfo flags_info = {
+        .sType =
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .pNext = nullptr,
+        .bindingCount = 2,
+        .pBindingFlags = binding_flags,
+    };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &flags_info,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = 2,
+        .pBindings = bindings,
+    };
+    _layout = layout_cache.create_layout(layout_info);
+
+    VkDescriptorPoolSize sizes[] = {
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, max_buffers},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, max_textures},
+    };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets = 1,
+        .poolSizeCount = 2,
+        .pPoolSizes = sizes,
+    };
+    VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &_pool));
+
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .descriptorPool = _pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &_layout,
+    };
+    VK_CHECK(vkAllocateDescriptorSets(device, &alloc_info, &_set));
+}
+
+uint32_t BindlessSet::add_buffer(VkBuffer buf, VkDeviceSize range) {
+    uint32_t slot = _buffers.alloc();
+    VkDescriptorBufferInfo buf_info = {
+        .buffer = buf,
+        .offset = 0,
+        .range = range,
+    };
+    auto write = vkinit::write_descriptor_buffer(
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        _set,
+        &buf_info,
+        BINDLESS_BUFFER_BINDING);
+    write.dstArrayElement = slot;
+    vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+    return slot;
+}
+
+uint32_t BindlessSet::add_texture(VkImageView view, VkSampler sampler) {
+    uint32_t slot = _textures.alloc();
+    VkDescriptorImageInfo img_info = {
+        .sampler = sampler,
+        .imageView = view,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext = nullptr,
+        .dstSet = _set,
+        .dstBinding = BINDLESS_TEXTURE_BINDING,
+        .dstArrayElement = slot,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &img_info,
+    };
+    vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+    return slot;
+}
+
+void BindlessSet::remove_buffer(uint32_t slot) {
+    // the stale descriptor stays; partially bound allows that as long as
+    // shaders don't use it
+    _buffers.free.push_back(slot);
+}
+
+void BindlessSet::remove_texture(uint32_t slot) {
+    _textures.free.push_back(slot);
+}
@@ -0,0 +1,62 @@
+#ifndef BINDLESS_H
+#define BINDLESS_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include "descriptors.h"
+
+// Slot value meaning "no resource", must match the shaders
+static constexpr uint32_t BINDLESS_NONE = ~0u;
+
+// Bindings within the set, must match the shaders
+#define BINDLESS_BUFFER_BINDING 0
+#define BINDLESS_TEXTURE_BINDING 1
+
+/**
+ * A single descriptor set holding every storage buffer and texture, which
+ * shaders index by slot.  It is bound once per frame.  Slots are written
+ * with update-after-bind, so they may change while the set is bound, as
+ * long as no submitted work still uses the slot being overwritten.
+ *
+ * It is a single fixed-size set with update-after-bind flags, so it gets
+ * a dedicated pool, which goes to the caller's deletion queue.  The
+ * layout comes from, and is owned by, the layout cache.
+ */
+class BindlessSet {
+   public:
+    void init(VkDevice device,
+              DescriptorLayoutCache& layout_cache,
+              uint32_t max_buffers,
+              uint32_t max_textures);
+
+    /** Write `buf` into a free slot and return the slot. */
+    uint32_t add_buffer(VkBuffer buf, VkDeviceSize range = VK_WHOLE_SIZE);
+    uint32_t add_texture(VkImageView view, VkSampler sampler);
+
+    /** Make a slot reusable.  The GPU must be done with it. */
+    void remove_buffer(uint32_t slot);
+    void remove_texture(uint32_t slot);
+
+    VkDescriptorSetLayout layout() const { return _layout; }
+    VkDescriptorPool pool() const { return _pool; }
+    VkDescriptorSet set() const { return _set; }
+
+   private:
+    struct Slots {
+        uint32_t max{0};
+        uint32_t next{0};  // slots below this have been handed out before
+        std::vector<uint32_t> free;
+
+        uint32_t alloc();
+    };
+
+    VkDevice _device{VK_NULL_HANDLE};
+    VkDescriptorSetLayout _layout{VK_NULL_HANDLE};
+    VkDescriptorPool _pool{VK_NULL_HANDLE};
+    VkDescriptorSet _set{VK_NULL_HANDLE};
+    Slots _buffers;
+    Slots _textures;
+};
+
+#endif  // BINDLESS_H
@@ -0,0 +1,193 @@
+#include "deletion_queue.h"
+#include "memory_stats.h"
+
+DeletionQueue::DeletionQueue(size_t capacity) {
+    _deletions.reserve(capacity);
+}
+
+void DeletionQueue::enqueue(Deletion const& d) {
+    // only allocates if we outgrow the reserved capacity
+    _deletions.push_back(d);
+}
+
+void DeletionQueue::push(VmaAllocator allocator) {
+    Deletion d{.type = Deletion::Type::Allocator};
+    d.allocator = allocator;
+    enqueue(d);
+}
+
+void DeletionQueue::push(AllocatedBuffer buffer) {
+    Deletion d{.type = Deletion::Type::Buffer};
+    d.buffer = buffer;
+    enqueue(d);
+}
+
+void DeletionQueue::push(AllocatedImage image) {
+    Deletion d{.type = Deletion::Type::Image};
+    d.image = image;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkImageView image_view) {
+    Deletion d{.type = Deletion::Type::ImageView};
+    d.image_view = image_view;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkSampler sampler) {
+    Deletion d{.type = Deletion::Type::Sampler};
+    d.sampler = sampler;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkPipeline pipeline) {
+    Deletion d{.type = Deletion::Type::Pipeline};
+    d.pipeline = pipeline;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkPipelineLayout pipeline_layout) {
+    Deletion d{.type = Deletion::Type::PipelineLayout};
+    d.pipeline_layout = pipeline_layout;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkDescriptorSetLayout descriptor_set_layout) {
+    Deletion d{.type = Deletion::Type::DescriptorSetLayout};
+    d.descriptor_set_layout = descriptor_set_layout;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkDescriptorPool descriptor_pool) {
+    Deletion d{.type = Deletion::Type::DescriptorPool};
+    d.descriptor_pool = descriptor_pool;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkRenderPass render_pass) {
+    Deletion d{.type = Deletion::Type::RenderPass};
+    d.render_pass = render_pass;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkFramebuffer framebuffer) {
+    Deletion d{.type = Deletion::Type::Framebuffer};
+    d.framebuffer = framebuffer;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkCommandPool command_pool) {
+    Deletion d{.type = Deletion::Type::CommandPool};
+    d.command_pool = command_pool;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkFence fence) {
+    Deletion d{.type = Deletion::Type::Fence};
+    d.fence = fence;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkSemaphore semaphore) {
+    Deletion d{.type = Deletion::Type::Semaphore};
+    d.semaphore = semaphore;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkSwapchainKHR swapchain) {
+    Deletion d{.type = Deletion::Type::Swapchain};
+    d.swapchain = swapchain;
+    enqueue(d);
+}
+
+void DeletionQueue::push(VkShaderModule shader_module) {
+    Deletion d{.type = Deletion::Type::ShaderModule};
+    d.shader_module = shader_module;
+    enqueue(d);
+}
+
+void DeletionQueue::push(RenderGraph* graph) {
+    Deletion d{.type = Deletion::Type::RenderGraph};
+    d.graph = graph;
+    enqueue(d);
+}
+
+void DeletionQueue::push(DescriptorAllocator* descriptor_allocator) {
+    Deletion d{.type = Deletion::Type::DescriptorAllocator};
+    d.descriptor_allocator = descriptor_allocator;
+    enqueue(d);
+}
+
+void DeletionQueue::push(DescriptorLayoutCache* layout_cache) {
+    Deletion d{.type = Deletion::Type::DescriptorLayoutCache};
+    d.layout_cache = layout_cache;
+    enqueue(d);
+}
+
+void DeletionQueue::flush(VkDevice device, VmaAllocator allocator) {
+    // reverse order, so things are destroyed before what they depend on
+    for (auto it = _deletions.rbegin(); it != _deletions.rend(); ++it) {
+        auto& d = *it;
+        switch (d.type) {
+            case Deletion::Type::Allocator:
+                vmaDestroyAllocator(d.allocator);
+                break;
+            case Deletion::Type::Buffer:
+                destroy_buffer(allocator, d.buffer);
+                break;
+            case Deletion::Type::Image:
+                destroy_image(allocator, d.image);
+                break;
+            case Deletion::Type::ImageView:
+                vkDestroyImageView(device, d.image_view, nullptr);
+                break;
+            case Deletion::Type::Sampler:
+                vkDestroySampler(device, d.sampler, nullptr);
+                break;
+            case Deletion::Type::Pipeline:
+                vkDestroyPipeline(device, d.pipeline, nullptr);
+                break;
+            case Deletion::Type::PipelineLayout:
+                vkDestroyPipelineLayout(device, d.pipeline_layout, nullptr);
+                break;
+            case Deletion::Type::DescriptorSetLayout:
+                vkDestroyDescriptorSetLayout(
+                    device, d.descriptor_set_layout, nullptr);
+                break;
+            case Deletion::Type::DescriptorPool:
+                vkDestroyDescriptorPool(device, d.descriptor_pool, nullptr);
+                break;
+            case Deletion::Type::RenderPass:
+                vkDestroyRenderPass(device, d.render_pass, nullptr);
+                break;
+            case Deletion::Type::Framebuffer:
+                vkDestroyFramebuffer(device, d.framebuffer, nullptr);
+                break;
+            case Deletion::Type::CommandPool:
+                vkDestroyCommandPool(device, d.command_pool, nullptr);
+                break;
+            case Deletion::Type::Fence:
+                vkDestroyFence(device, d.fence, nullptr);
+                break;
+            case Deletion::Type::Semaphore:
+                vkDestroySemaphore(device, d.semaphore, nullptr);
+                break;
+            case Deletion::Type::Swapchain:
+                vkDestroySwapchainKHR(device, d.swapchain, nullptr);
+                break;
+            case Deletion::Type::ShaderModule:
+                vkDestroyShaderModule(device, d.shader_module, nullptr);
+                break;
+            case Deletion::Type::RenderGraph:
+                d.graph->destroy(device, allocator);
+                break;
+            case Deletion::Type::DescriptorAllocator:
+                d.descriptor_allocator->destroy();
+                break;
+            case Deletion::Type::DescriptorLayoutCache:
+                d.layout_cache->destroy();
+                break;
+        }
+    }
+    _deletions.clear();  // keeps capacity
+}
@@ -0,0 +1,102 @@
+#ifndef DELETION_QUEUE_H
+#define DELETION_QUEUE_H
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "descriptors.h"
+#include "render_graph.h"
+#include "vk_types.h"
+
+/**
+ * A Vulkan object waiting to be destroyed.  Plain data, so queueing one
+ * doesn't allocate (unlike a std::function).
+ */
+struct Deletion {
+    enum class Type : uint8_t {
+        Allocator,
+        Buffer,
+        Image,
+        ImageView,
+        Sampler,
+        Pipeline,
+        PipelineLayout,
+        DescriptorSetLayout,
+        DescriptorPool,
+        RenderPass,
+        Framebuffer,
+        CommandPool,
+        Fence,
+        Semaphore,
+        Swapchain,
+        ShaderModule,
+        RenderGraph,
+        DescriptorAllocator,
+        DescriptorLayoutCache,
+    };
+
+    Type type;
+    union {
+        VmaAllocator allocator;
+        AllocatedBuffer buffer;
+        AllocatedImage image;
+        VkImageView image_view;
+        VkSampler sampler;
+        VkPipeline pipeline;
+        VkPipelineLayout pipeline_layout;
+        VkDescriptorSetLayout descriptor_set_layout;
+        VkDescriptorPool descriptor_pool;
+        VkRenderPass render_pass;
+        VkFramebuffer framebuffer;
+        VkCommandPool command_pool;
+        VkFence fence;
+        VkSemaphore semaphore;
+        VkSwapchainKHR swapchain;
+        VkShaderModule shader_module;
+        RenderGraph* graph;
+        DescriptorAllocator* descriptor_allocator;
+        DescriptorLayoutCache* layout_cache;
+    };
+};
+
+/**
+ * Typed deletion records, destroyed in reverse order on flush().
+ * Storage is reserved up front and reused after each flush.
+ *
+ * Overloads rely on distinct handle types, i.e. a 64-bit build.
+ */
+class DeletionQueue {
+   public:
+    explicit DeletionQueue(size_t capacity = 256);
+
+    void push(VmaAllocator allocator);
+    void push(AllocatedBuffer buffer);
+    void push(AllocatedImage image);
+    void push(VkImageView image_view);
+    void push(VkSampler sampler);
+    void push(VkPipeline pipeline);
+    void push(VkPipelineLayout pipeline_layout);
+    void push(VkDescriptorSetLayout descriptor_set_layout);
+    void push(VkDescriptorPool descriptor_pool);
+    void push(VkRenderPass render_pass);
+    void push(VkFramebuffer framebuffer);
+    void push(VkCommandPool command_pool);
+    void push(VkFence fence);
+    void push(VkSemaphore semaphore);
+    void push(VkSwapchainKHR swapchain);
+    void push(VkShaderModule shader_module);
+    void push(RenderGraph* graph);
+    void push(DescriptorAllocator* descriptor_allocator);
+    void push(DescriptorLayoutCache* layout_cache);
+
+    void flush(VkDevice device, VmaAllocator allocator);
+
+    size_t size() const { return _deletions.size(); }
+
+   private:
+    std::vector<Deletion> _deletions;
+
+    void enqueue(Deletion const& d);
+};
+
+#endif  // DELETION_QUEUE_H
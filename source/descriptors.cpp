@@ -0,0 +1,187 @@
+#include "descriptors.h"
+#include <algorithm>
+#include <cassert>
+#include "engine.h"
+
+// Pools grow geometrically up to this many sets
+static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+void DescriptorAllocator::init(VkDevice device,
+                               uint32_t initial_sets,
+                               VkDescriptorPoolCreateFlags flags) {
+    _device = device;
+    _flags = flags;
+    _next_pool_sets = initial_sets;
+    _ratios = {
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.f},
+    };
+}
+
+VkDescriptorPool DescriptorAllocator::create_pool(uint32_t max_sets) {
+    std::vector<VkDescriptorPoolSize> sizes;
+    for (auto& r : _ratios) {
+        sizes.push_back({
+            .type = r.type,
+            .descriptorCount = std::max(1u, (uint32_t)(r.ratio * max_sets)),
+        });
+    }
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = _flags,
+        .maxSets = max_sets,
+        .poolSizeCount = (uint32_t)sizes.size(),
+        .pPoolSizes = sizes.data(),
+    };
+    VkDescriptorPool pool;
+    VK_CHECK(vkCreateDescriptorPool(_device, &pool_info, nullptr, &pool));
+    return pool;
+}
+
+VkDescriptorPool DescriptorAllocator::grab_pool() {
+    if (!_free.empty()) {
+        auto pool = _free.back();
+        _free.pop_back();
+        return pool;
+    }
+    auto pool = create_pool(_next_pool_sets);
+    _next_pool_sets = std::min(_next_pool_sets * 3 / 2, MAX_SETS_PER_POOL);
+    return pool;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout,
+                                              void const* next) {
+    if (_current == VK_NULL_HANDLE) {
+        _current = grab_pool();
+        _used.push_back(_current);
+    }
+
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = next,
+        .descriptorPool = _current,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &layout,
+    };
+    VkDescriptorSet set;
+    VkResult res = vkAllocateDescriptorSets(_device, &alloc_info, &set);
+    if (res == VK_ERROR_OUT_OF_POOL_MEMORY ||
+        res == VK_ERROR_FRAGMENTED_POOL) {
+        // current pool is full, move on to a fresh one
+        _current = grab_pool();
+        _used.push_back(_current);
+        alloc_info.descriptorPool = _current;
+        res = vkAllocateDescriptorSets(_device, &alloc_info, &set);
+    }
+    VK_CHECK(res);  // a fresh pool should always fit one set
+    return set;
+}
+
+void DescriptorAllocator::reset_pools() {
+    for (auto pool : _used) {
+        vkResetDescriptorPool(_device, pool, 0);
+        _free.push_back(pool);
+    }
+    _used.clear();
+    _current = VK_NULL_HANDLE;
+}
+
+void DescriptorAllocator::destroy() {
+    for (auto pool : _used) {
+        vkDestroyDescriptorPool(_device, pool, nullptr);
+    }
+    for (auto pool : _free) {
+        vkDestroyDescriptorPool(_device, pool, nullptr);
+    }
+    _used.clear();
+    _free.clear();
+    _current = VK_NULL_HANDLE;
+}
+
+bool DescriptorLayoutCache::LayoutKey::operator==(
+    LayoutKey const& other) const {
+    if (flags != other.flags || bindings.size() != other.bindings.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < bindings.size(); ++i) {
+        auto& a = bindings[i];
+        auto& b = other.bindings[i];
+        if (a.binding.binding != b.binding.binding ||
+            a.binding.descriptorType != b.binding.descriptorType ||
+            a.binding.descriptorCount != b.binding.descriptorCount ||
+            a.binding.stageFlags != b.binding.stageFlags ||
+            a.flags != b.flags) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t DescriptorLayoutCache::LayoutHash::operator()(
+    LayoutKey const& key) const {
+    auto combine = [](size_t seed, size_t v) {
+        return seed ^ (v + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+    };
+    size_t h = combine(key.flags, key.bindings.size());
+    for (auto& b : key.bindings) {
+        // pack binding, type, count and stages into one word
+        size_t packed = b.binding.binding |
+                        (size_t)b.binding.descriptorType << 8 |
+                        (size_t)b.binding.descriptorCount << 16 |
+                        (size_t)b.binding.stageFlags << 40;
+        h = combine(h, packed);
+        h = combine(h, b.flags);
+    }
+    return h;
+}
+
+VkDescriptorSetLayout DescriptorLayoutCache::create_layout(
+    VkDescriptorSetLayoutCreateInfo const& info) {
+    // binding flags, if any, are chained in
+    VkDescriptorBindingFlags const* binding_flags = nullptr;
+    for (auto p = static_cast<VkBaseInStructure const*>(info.pNext); p;
+         p = p->pNext) {
+        if (p->sType ==
+            VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO) {
+            auto flags_info =
+                (VkDescriptorSetLayoutBindingFlagsCreateInfo const*)p;
+            assert(flags_info->bindingCount == info.bindingCount);
+            binding_flags = flags_info->pBindingFlags;
+        }
+    }
+
+    LayoutKey key{.flags = info.flags};
+    for (uint32_t i = 0; i < info.bindingCount; ++i) {
+        assert(info.pBindings[i].pImmutableSamplers == nullptr);
+        key.bindings.push_back({
+            .binding = info.pBindings[i],
+            .flags = binding_flags ? binding_flags[i] : 0,
+        });
+    }
+    std::sort(key.bindings.begin(),
+              key.bindings.end(),
+              [](auto const& a, auto const& b) {
+                  return a.binding.binding < b.binding.binding;
+              });
+
+    auto it = _layouts.find(key);
+    if (it != _layouts.end()) {
+        return it->second;
+    }
+    VkDescriptorSetLayout layout;
+    VK_CHECK(vkCreateDescriptorSetLayout(_device, &info, nullptr, &layout));
+    _layouts[key] = layout;
+    return layout;
+}
+
+void DescriptorLayoutCache::destroy() {
+    for (auto& [key, layout] : _layouts) {
+        vkDestroyDescriptorSetLayout(_device, layout, nullptr);
+    }
+    _layouts.clear();
+}
@@ -0,0 +1,99 @@
+#ifndef DESCRIPTORS_H
+#define DESCRIPTORS_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Hands out descriptor sets from a growing list of pools.  When a pool
+ * runs out (or is too fragmented), the next one is created, sized by
+ * per-type ratios and larger than the last, so allocation never limits
+ * the scene.
+ *
+ * For per-frame sets, allocate from the frame's allocator and call
+ * reset_pools() once the frame's fence has passed; that frees all of its
+ * sets at once and keeps the pools for reuse.
+ */
+class DescriptorAllocator {
+   public:
+    /** Descriptors of `type` per set, on average. */
+    struct PoolRatio {
+        VkDescriptorType type;
+        float ratio;
+    };
+
+    void init(VkDevice device,
+              uint32_t initial_sets = 64,
+              VkDescriptorPoolCreateFlags flags = 0);
+
+    /** Override the default ratios; affects pools created from now on. */
+    void set_ratios(std::vector<PoolRatio> ratios) { _ratios = ratios; }
+
+    /** `next` is chained into VkDescriptorSetAllocateInfo. */
+    VkDescriptorSet allocate(VkDescriptorSetLayout layout,
+                             void const* next = nullptr);
+
+    /** Free all sets handed out so far.  The GPU must be done with them. */
+    void reset_pools();
+
+    void destroy();
+
+    size_t pool_count() const { return _used.size() + _free.size(); }
+
+   private:
+    VkDescriptorPool grab_pool();
+    VkDescriptorPool create_pool(uint32_t max_sets);
+
+    VkDevice _device{VK_NULL_HANDLE};
+    VkDescriptorPoolCreateFlags _flags{0};
+    std::vector<PoolRatio> _ratios;
+    uint32_t _next_pool_sets{0};  // size of the next new pool
+
+    VkDescriptorPool _current{VK_NULL_HANDLE};
+    std::vector<VkDescriptorPool> _used;  // including _current
+    std::vector<VkDescriptorPool> _free;  // reset, ready for reuse
+};
+
+/**
+ * Creates each distinct VkDescriptorSetLayout once.  Layouts are compared
+ * by their bindings, binding flags and create flags, so identical layouts
+ * from different places share a handle.  The cache owns the layouts.
+ *
+ * Immutable samplers are not supported.
+ */
+class DescriptorLayoutCache {
+   public:
+    void init(VkDevice device) { _device = device; }
+
+    VkDescriptorSetLayout create_layout(
+        VkDescriptorSetLayoutCreateInfo const& info);
+
+    void destroy();
+
+    size_t size() const { return _layouts.size(); }
+
+   private:
+    struct Binding {
+        VkDescriptorSetLayoutBinding binding;
+        VkDescriptorBindingFlags flags;
+    };
+
+    struct LayoutKey {
+        VkDescriptorSetLayoutCreateFlags flags;
+        std::vector<Binding> bindings;  // sorted by binding index
+
+        bool operator==(LayoutKey const& other) const;
+    };
+
+    struct LayoutHash {
+        size_t operator()(LayoutKey const& key) const;
+    };
+
+    VkDevice _device{VK_NULL_HANDLE};
+    std::unordered_map<LayoutKey, VkDescriptorSetLayout, LayoutHash>
+        _layouts;
+};
+
+#endif  // DESCRIPTORS_H
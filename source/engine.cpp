@@ -1,5 +1,7 @@
 #include "engine.h"
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <fstream>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
@@ -14,6 +16,14 @@ static constexpr uint64_t TIMEOUT_SECOND = 1000000000;  // ns
 #define PRINT_DRAW_TIME
 
 void Engine::init() {
+    _frame_overlap =
+        std::clamp(_frame_overlap, 1u, (uint32_t)MAX_FRAME_OVERLAP);
+    _frames.resize(_frame_overlap);
+    _frame_timings.resize(100);
+    std::cout << "Using " << _frame_overlap << " frame(s) in flight.\n";
+    _jobs.init(_worker_count, 1);  // and the update thread
+    std::cout << "Using " << _jobs.worker_count() << " worker(s).\n";
+
     std::cout << "Initializing GLFW...\n";
     init_glfw();
 
@@ -26,25 +36,24 @@ void Engine::init() {
     std::cout << "Initializing Commands...\n";
     init_commands();
 
-    std::cout << "Initializing Default Renderpass...\n";
-    init_default_renderpass();
-
-    std::cout << "Initializing Framebuffers...\n";
-    init_framebuffers();
+    std::cout << "Initializing Render Graph...\n";
+    init_render_graph();
 
     std::cout << "Initializing Sync Structures...\n";
     init_sync_structures();
 
     std::cout << "Initializing Descriptors...\n";
+    init_descriptor_allocators();
     init_descriptors();
 
+    // before the pipelines, so spawned loads overlap with compiling them
+    std::cout << "Loading Meshes...\n";
+    load_meshes();
+
     std::cout << "Initializing Pipelines...\n";
     init_pipelines();
     init_materials();
 
-    std::cout << "Loading Meshes...\n";
-    load_meshes();
-
     std::cout << "Initializing Scene...\n";
     init_scene();
 
@@ -60,11 +69,29 @@ void Engine::cleanup() {
         return;
     }
 
-    for (int i = 0; i < FRAME_OVERLAP; ++i) {
+    wait_async();
+    for (auto& frame : _frames) {
         vkWaitForFences(
-            _device, 1, &_frames[i].render_fence, true, 1 * TIMEOUT_SECOND);
+            _device, 1, &frame.render_fence, true, 1 * TIMEOUT_SECOND);
+    }
+#ifdef PRINT_DRAW_TIME
+    _mem_stats.print(_allocator, std::cout);
+#endif  // PRINT_DRAW_TIME
+    unload_meshes();
+    _jobs.shutdown();
+    for (auto& frame : _frames) {
+        frame.del_queue.flush(_device, _allocator);
+    }
+    std::cout << "Deleting " << _del_queue.size() << " things...\n";
+    _del_queue.flush(_device, _allocator);
+    for (int c = 0; c < (int)MemCategory::Count; ++c) {
+        auto& stats = _mem_stats.get((MemCategory)c);
+        if (stats.count > 0) {
+            std::cerr << "Leaked " << stats.count.load() << " "
+                      << to_string((MemCategory)c) << " allocations ("
+                      << stats.bytes.load() / 1e6 << " MB).\n";
+        }
     }
-    _del_queue.flush();
 
     // vulkan stuff
     vkDestroyDevice(_device, nullptr);
@@ -82,16 +109,39 @@ void Engine::cleanup() {
     std::cout << "Average draw time over the last " << _draw_times.size()
               << " frames: " << total / _draw_times.size() << " ms ("
               << _draw_times.size() / (total / 1000.f) << " fps).\n";
+    auto timings = average_frame_timings();
+    std::cout << "CPU per frame: " << timings.fence_wait_ms
+              << " ms waiting on render fence, " << timings.acquire_ms
+              << " ms acquiring the image, " << timings.record_ms
+              << " ms recording (" << _frame_overlap
+              << " frame(s) in flight).\n";
 #endif  // PRINT_DRAW_TIME
 }
 
 void Engine::draw() {
-    auto f = get_current_frame();
+    auto& f = get_current_frame();
+    auto wait_start = std::chrono::high_resolution_clock::now();
     VK_CHECK(
         vkWaitForFences(_device, 1, &f.render_fence, true, 1 * TIMEOUT_SECOND));
+    auto wait_end = std::chrono::high_resolution_clock::now();
     VK_CHECK(vkResetFences(_device, 1, &f.render_fence));
 
+    // the GPU is done with this slot, so is everything retired during it
+    f.del_queue.flush(_device, _allocator);
+    f.descriptors.reset_pools();
+    update_memory_budget();
+    pump_async();  // after the flush, tasks may retire resources into it
+
+    // passes switched on or off, see RenderGraph::Pass::enable_if()
+    if (_graph.outdated()) {
+        VK_CHECK(vkDeviceWaitIdle(_device));
+        _graph.relink(_device);
+        _render_pass = _graph.get_render_pass("forward");
+    }
+    prepare_frame();
+
     // request image
+    auto acquire_start = std::chrono::high_resolution_clock::now();
     uint32_t swapchain_im_idx;
     VK_CHECK(vkAcquireNextImageKHR(_device,
                                    _swapchain,
@@ -103,6 +153,7 @@ void Engine::draw() {
                                    f.present_semaphore,
                                    nullptr,
                                    &swapchain_im_idx));
+    auto acquire_end = std::chrono::high_resolution_clock::now();
 
     VK_CHECK(vkResetCommandBuffer(f.cmd, 0));
     VkCommandBufferBeginInfo begin_info = {
@@ -113,32 +164,10 @@ void Engine::draw() {
         .pInheritanceInfo = nullptr,  // no secondary cmd bufs
     };
     // start recording
+    auto record_start = std::chrono::high_resolution_clock::now();
     VK_CHECK(vkBeginCommandBuffer(f.cmd, &begin_info));
 
-    VkClearValue clear = {
-        .color = {1.0f, 1.0f, 1.0f, 1.0f},
-    };
-
-    VkClearValue depth_clear;
-    depth_clear.depthStencil.depth = 1.f;
-
-    VkClearValue clears[2] = {clear, depth_clear};
-
-    VkRenderPassBeginInfo rp_info = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-        .pNext = nullptr,
-        .renderPass = _render_pass,
-        .framebuffer = _framebuffers[swapchain_im_idx],
-        .clearValueCount = 2,
-        .pClearValues = &clears[0],
-    };
-    rp_info.renderArea.offset.x = 0;
-    rp_info.renderArea.offset.y = 0;
-    rp_info.renderArea.extent = _window_extent;
-
-    vkCmdBeginRenderPass(f.cmd, &rp_info, VK_SUBPASS_CONTENTS_INLINE);
-    render_pass(f.cmd);
-    vkCmdEndRenderPass(f.cmd);
+    _graph.execute(f.cmd, swapchain_im_idx);
 
     VK_CHECK(vkEndCommandBuffer(f.cmd));
 
@@ -160,6 +189,15 @@ void Engine::draw() {
     };
     VK_CHECK(vkQueueSubmit(_gfx_queue, 1, &submit, f.render_fence));
 
+    auto record_end = std::chrono::high_resolution_clock::now();
+    auto ms = [](auto d) {
+        return std::chrono::duration<float, std::milli>(d).count();
+    };
+    auto& timings = _frame_timings[_frame_number % _frame_timings.size()];
+    timings.fence_wait_ms = ms(wait_end - wait_start);
+    timings.acquire_ms = ms(acquire_end - acquire_start);
+    timings.record_ms = ms(record_end - record_start);
+
     // presentation time
     VkPresentInfoKHR present_info = {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
@@ -178,6 +216,12 @@ void Engine::draw() {
 void Engine::run() {
     bool run = true;
 
+    // the first snapshot is ready before the first frame
+    run_posted_updates();
+    update(0);
+    _updating = true;
+    _update_thread = std::thread(&Engine::update_loop, this);
+
     while (run) {
         glfwPollEvents();
 
@@ -197,6 +241,42 @@ void Engine::run() {
         _draw_times[_frame_number % _draw_times.size()] = ms;
 #endif
     }
+
+    _updating = false;
+    _update_thread.join();
+}
+
+void Engine::update_loop() {
+    using clock = std::chrono::steady_clock;
+    auto period = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(1. / std::max(_tick_rate, 1u)));
+    auto next = clock::now();
+    _jobs.attach(0);  // for parallel updates, see JobSystem::init()
+    for (uint64_t tick = 1; _updating; ++tick) {
+        next += period;
+        if (clock::now() > next + 4 * period) {
+            next = clock::now();  // fell behind, don't try to catch up
+        }
+        std::this_thread::sleep_until(next);
+        run_posted_updates();
+        update(tick);
+    }
+}
+
+void Engine::post_update(std::function<void()> fn) {
+    std::lock_guard lock{_update_mutex};
+    _update_queue.push_back(std::move(fn));
+}
+
+void Engine::run_posted_updates() {
+    std::vector<std::function<void()>> queue;
+    {
+        std::lock_guard lock{_update_mutex};
+        queue.swap(_update_queue);
+    }
+    for (auto& fn : queue) {
+        fn();
+    }
 }
 
 void Engine::init_glfw() {
@@ -208,6 +288,15 @@ void Engine::init_glfw() {
                                APP_NAME,
                                nullptr,
                                nullptr);
+    glfwSetWindowUserPointer(_window, this);
+    glfwSetKeyCallback(
+        _window, [](GLFWwindow* window, int key, int, int action, int) {
+            if (action == GLFW_PRESS) {
+                auto engine =
+                    static_cast<Engine*>(glfwGetWindowUserPointer(window));
+                engine->on_key(key);
+            }
+        });
 }
 
 void Engine::init_vulkan() {
@@ -216,13 +305,13 @@ void Engine::init_vulkan() {
 
     uint32_t glfw_ext_count = 0;
     auto glfw_exts = glfwGetRequiredInstanceExtensions(&glfw_ext_count);
-    for (int i = 0; i < glfw_ext_count; ++i) {
+    for (uint32_t i = 0; i < glfw_ext_count; ++i) {
         inst_builder.enable_extension(glfw_exts[i]);
     }
 
     auto res = inst_builder.set_app_name(APP_NAME)
                    .enable_validation_layers(true)
-                   .require_api_version(1, 1, 0)
+                   .require_api_version(1, 2, 0)
                    .use_default_debug_messenger()
                    .build();
 
@@ -233,11 +322,60 @@ void Engine::init_vulkan() {
     glfwCreateWindowSurface(_instance, _window, nullptr, &_surface);
 
     // Device
+    // descriptor indexing for the bindless set, see BindlessSet
+    VkPhysicalDeviceVulkan12Features features_12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = nullptr,
+        .descriptorIndexing = VK_TRUE,
+        .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+        .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+        .descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE,
+        .descriptorBindingPartiallyBound = VK_TRUE,
+        .runtimeDescriptorArray = VK_TRUE,
+    };
     vkb::PhysicalDeviceSelector selector{inst};
-    vkb::PhysicalDevice phys_dev = selector.set_minimum_version(1, 1)
-                                       .set_surface(_surface)
-                                       .select()
-                                       .value();
+    vkb::PhysicalDevice phys_dev =
+        selector.set_minimum_version(1, 2)
+            .set_required_features_12(features_12)
+            .set_surface(_surface)
+            .add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)
+            .select()
+            .value();
+
+    // Optional: 64-bit buffer atomics for the compute point rasterizer,
+    // indirect multi-draws for occlusion culling
+    VkPhysicalDeviceVulkan12Features supported_12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = nullptr,
+    };
+    VkPhysicalDeviceFeatures2 supported = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supported_12,
+    };
+    vkGetPhysicalDeviceFeatures2(phys_dev.physical_device, &supported);
+    _has_int64_atomics = supported.features.shaderInt64 &&
+                         supported_12.shaderBufferInt64Atomics;
+    if (_has_int64_atomics) {
+        features_12.shaderBufferInt64Atomics = VK_TRUE;
+        phys_dev =
+            selector.set_required_features_12(features_12).select().value();
+    }
+    _has_multi_draw_indirect = supported.features.multiDrawIndirect &&
+                               supported.features.drawIndirectFirstInstance;
+
+    // desired extensions get enabled if the device supports them
+    uint32_t ext_count = 0;
+    vkEnumerateDeviceExtensionProperties(
+        phys_dev.physical_device, nullptr, &ext_count, nullptr);
+    std::vector<VkExtensionProperties> exts(ext_count);
+    vkEnumerateDeviceExtensionProperties(
+        phys_dev.physical_device, nullptr, &ext_count, exts.data());
+    auto budget_ext = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    for (auto& ext : exts) {
+        if (strcmp(ext.extensionName, budget_ext) == 0) {
+            _has_memory_budget = true;
+        }
+    }
 
     vkb::DeviceBuilder dev_builder{phys_dev};
     VkPhysicalDeviceFeatures2 features = {
@@ -245,6 +383,9 @@ void Engine::init_vulkan() {
         .pNext = nullptr,
     };
     features.features.fillModeNonSolid = VK_TRUE;
+    features.features.shaderInt64 = _has_int64_atomics;
+    features.features.multiDrawIndirect = _has_multi_draw_indirect;
+    features.features.drawIndirectFirstInstance = _has_multi_draw_indirect;
     VkPhysicalDeviceShaderDrawParametersFeatures features_draw_params = {
         .sType =
             VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_DRAW_PARAMETERS_FEATURES,
@@ -265,12 +406,20 @@ void Engine::init_vulkan() {
 
     // allocator
     VmaAllocatorCreateInfo allocator_info = {
+        // without the extension, VMA estimates the budget (80% of heap size)
+        .flags = _has_memory_budget
+                     ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT
+                     : (VmaAllocatorCreateFlags)0,
         .physicalDevice = _phys_device,
         .device = _device,
         .instance = _instance,
+        .vulkanApiVersion = VK_API_VERSION_1_2,
     };
     vmaCreateAllocator(&allocator_info, &_allocator);
-    ENQUEUE_DELETE(vmaDestroyAllocator(_allocator));
+    std::cout << "Memory budget: "
+              << (_has_memory_budget ? "VK_EXT_memory_budget" : "estimated")
+              << "\n";
+    ENQUEUE_DELETE(_allocator);
 
     _gpu_properties = dev.physical_device.properties;
     _gpu_features = dev.physical_device.features;
@@ -289,36 +438,14 @@ void Engine::init_swapchain() {
     _swapchain_views = swapchain.get_image_views().value();
     _swapchain_format = swapchain.image_format;
 
-    ENQUEUE_DELETE(vkDestroySwapchainKHR(_device, _swapchain, nullptr));
+    ENQUEUE_DELETE(_swapchain);
 
-    // depth buffer
-    VkExtent3D depth_ext = {
-        _window_extent.width,
-        _window_extent.height,
-        1,
-    };
+    for (auto view : _swapchain_views) {
+        ENQUEUE_DELETE(view);
+    }
+
+    // the depth buffer is owned by the render graph
     _depth_format = VK_FORMAT_D32_SFLOAT;
-    auto depth_img_info = vkinit::image_create_info(
-        _depth_format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, depth_ext);
-    VmaAllocationCreateInfo depth_alloc_info = {
-        .usage = VMA_MEMORY_USAGE_GPU_ONLY,
-        // ensure image is in GPU memory
-        .requiredFlags =
-            VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
-    };
-    vmaCreateImage(_allocator,
-                   &depth_img_info,
-                   &depth_alloc_info,
-                   &_depth_img.img,
-                   &_depth_img.alloc,
-                   nullptr);
-    auto depth_view_info = vkinit::imageview_create_info(
-        _depth_format, _depth_img.img, VK_IMAGE_ASPECT_DEPTH_BIT);
-    VK_CHECK(
-        vkCreateImageView(_device, &depth_view_info, nullptr, &_depth_view));
-    ENQUEUE_DELETE(vkDestroyImageView(_device, _depth_view, nullptr));
-    ENQUEUE_DELETE(
-        vmaDestroyImage(_allocator, _depth_img.img, _depth_img.alloc));
 }
 
 void Engine::init_commands() {
@@ -326,7 +453,7 @@ void Engine::init_commands() {
     auto command_pool_info = vkinit::command_pool_create_info(
         _gfx_queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
-    for (int i = 0; i < FRAME_OVERLAP; ++i) {
+    for (size_t i = 0; i < _frames.size(); ++i) {
         VK_CHECK(vkCreateCommandPool(
             _device, &command_pool_info, nullptr, &_frames[i].command_pool));
 
@@ -336,8 +463,7 @@ void Engine::init_commands() {
         VK_CHECK(vkAllocateCommandBuffers(
             _device, &command_buffer_info, &_frames[i].cmd));
 
-        ENQUEUE_DELETE(
-            vkDestroyCommandPool(_device, _frames[i].command_pool, nullptr));
+        ENQUEUE_DELETE(_frames[i].command_pool);
     }
 
     // create upload command pool
@@ -347,128 +473,68 @@ void Engine::init_commands() {
                                  &upload_command_pool_info,
                                  nullptr,
                                  &_upload_context.command_pool));
-    ENQUEUE_DELETE(
-        vkDestroyCommandPool(_device, _upload_context.command_pool, nullptr));
+    ENQUEUE_DELETE(_upload_context.command_pool);
     auto upload_command_info =
         vkinit::command_buffer_allocate_info(_upload_context.command_pool, 1);
     VK_CHECK(vkAllocateCommandBuffers(
         _device, &upload_command_info, &_upload_context.cmd));
+
+    // one command buffer per upload(), freed when it's done
+    VK_CHECK(vkCreateCommandPool(_device,
+                                 &upload_command_pool_info,
+                                 nullptr,
+                                 &_async_upload_pool));
+    ENQUEUE_DELETE(_async_upload_pool);
 }
 
-void Engine::init_default_renderpass() {
-    VkAttachmentDescription color_attachment = {
-        // format needed by swapchain
+void Engine::init_render_graph() {
+    RGImageDesc color_desc = {
         .format = _swapchain_format,
-        // no MSAA
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        // clear when attachment is loaded
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        // keep attachment stored when render pass ends
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-        // don't care about stencil
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        // don't care about stencil
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        // don't care
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        // want to present at end
-        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-    };
-
-    VkAttachmentReference color_attachment_ref = {
-        .attachment = 0,
-        .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .extent = _window_extent,
     };
-
-    // depth buffer
-    VkAttachmentDescription depth_attachment = {
+    _rg_swapchain = _graph.import_image("swapchain",
+                                        color_desc,
+                                        _swapchain_imgs,
+                                        _swapchain_views,
+                                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    _graph.set_output(_rg_swapchain);
+
+    RGImageDesc depth_desc = {
         .format = _depth_format,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
-    };
-
-    VkAttachmentReference depth_attachment_ref = {
-        .attachment = 1,
-        .layout = depth_attachment.finalLayout,
-    };
-
-    VkAttachmentDescription attachments[2] = {color_attachment,
-                                              depth_attachment};
-
-    VkSubpassDescription subpass = {
-        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-        .colorAttachmentCount = 1,
-        .pColorAttachments = &color_attachment_ref,
-        // hook depth attachment
-        .pDepthStencilAttachment = &depth_attachment_ref,
+        .extent = _window_extent,
+        .aspect = VK_IMAGE_ASPECT_DEPTH_BIT,
     };
+    _rg_depth = _graph.create_image("depth", depth_desc);
 
-    VkSubpassDependency dep = {
-        .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .dstSubpass = 0,
-        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .srcAccessMask = 0,
-        .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-    };
-    VkSubpassDependency depth_dep = {
-        .srcSubpass = VK_SUBPASS_EXTERNAL,
-        .dstSubpass = 0,
-        .srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
-                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-        .dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
-                        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-        .srcAccessMask = 0,
-        .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-    };
-    VkSubpassDependency deps[2] = {dep, depth_dep};
-
-    VkRenderPassCreateInfo render_pass_info = {
-        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-        .attachmentCount = 2,
-        .pAttachments = &attachments[0],
-        .subpassCount = 1,
-        .pSubpasses = &subpass,
-        .dependencyCount = 2,
-        .pDependencies = &deps[0],
-    };
+    declare_passes(_graph);
 
-    VK_CHECK(
-        vkCreateRenderPass(_device, &render_pass_info, nullptr, &_render_pass));
+    _graph.compile(_device, _allocator, &_mem_stats);
+    _graph.print();
+    ENQUEUE_DELETE(&_graph);
 
-    ENQUEUE_DELETE(vkDestroyRenderPass(_device, _render_pass, nullptr));
+    // pipelines are built against the main pass
+    _render_pass = _graph.get_render_pass("forward");
 }
 
-void Engine::init_framebuffers() {
-    VkFramebufferCreateInfo fb_info = {
-        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-        .pNext = nullptr,
-        .renderPass = _render_pass,
-        .attachmentCount = 1,
-        .width = _window_extent.width,
-        .height = _window_extent.height,
-        .layers = 1,
+void Engine::declare_passes(RenderGraph& graph) {
+    VkClearValue clear = {
+        .color = {1.0f, 1.0f, 1.0f, 1.0f},
     };
+    VkClearValue depth_clear;
+    depth_clear.depthStencil.depth = 1.f;
 
-    const uint32_t swapchain_image_count = _swapchain_imgs.size();
-    _framebuffers = std::vector<VkFramebuffer>(swapchain_image_count);
-
-    for (int i = 0; i < swapchain_image_count; ++i) {
-        VkImageView attachments[2] = {_swapchain_views[i], _depth_view};
-        fb_info.attachmentCount = 2;
-        fb_info.pAttachments = &attachments[0];
-        VK_CHECK(
-            vkCreateFramebuffer(_device, &fb_info, nullptr, &_framebuffers[i]));
+    graph.add_graphics_pass("forward")
+        .write_color(_rg_swapchain, clear)
+        .write_depth(_rg_depth, depth_clear)
+        .execute([this](VkCommandBuffer cmd) { render_pass(cmd); });
+}
 
-        ENQUEUE_DELETE({
-            vkDestroyFramebuffer(_device, _framebuffers[i], nullptr);
-            vkDestroyImageView(_device, _swapchain_views[i], nullptr);
-        });
+void Engine::init_descriptor_allocators() {
+    _layout_cache.init(_device);
+    ENQUEUE_DELETE(&_layout_cache);
+    for (auto& frame : _frames) {
+        frame.descriptors.init(_device);
+        ENQUEUE_DELETE(&frame.descriptors);
     }
 }
 
@@ -477,28 +543,24 @@ void Engine::init_sync_structures() {
     auto fence_info = vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
     auto sema_info = vkinit::semaphore_create_info();
 
-    for (int i = 0; i < FRAME_OVERLAP; ++i) {
+    for (size_t i = 0; i < _frames.size(); ++i) {
         VK_CHECK(vkCreateFence(
             _device, &fence_info, nullptr, &_frames[i].render_fence));
-        ENQUEUE_DELETE(
-            vkDestroyFence(_device, _frames[i].render_fence, nullptr));
+        ENQUEUE_DELETE(_frames[i].render_fence);
 
         VK_CHECK(vkCreateSemaphore(
             _device, &sema_info, nullptr, &_frames[i].present_semaphore));
         VK_CHECK(vkCreateSemaphore(
             _device, &sema_info, nullptr, &_frames[i].render_semaphore));
-        ENQUEUE_DELETE(
-            vkDestroySemaphore(_device, _frames[i].present_semaphore, nullptr));
-        ENQUEUE_DELETE(
-            vkDestroySemaphore(_device, _frames[i].render_semaphore, nullptr));
+        ENQUEUE_DELETE(_frames[i].present_semaphore);
+        ENQUEUE_DELETE(_frames[i].render_semaphore);
     }
 
     // upload fence
     VkFenceCreateInfo upload_fence_info = vkinit::fence_create_info();
     VK_CHECK(vkCreateFence(
         _device, &upload_fence_info, nullptr, &_upload_context.upload_fence));
-    ENQUEUE_DELETE(
-        vkDestroyFence(_device, _upload_context.upload_fence, nullptr));
+    ENQUEUE_DELETE(_upload_context.upload_fence);
 }
 
 bool Engine::try_load_shader_module(const char* file_path,
@@ -536,12 +598,35 @@ bool Engine::try_load_shader_module(const char* file_path,
 }
 
 FrameData& Engine::get_current_frame() {
-    return _frames[_frame_number % FRAME_OVERLAP];
+    return _frames[get_current_frame_index()];
+}
+
+uint32_t Engine::get_current_frame_index() const {
+    return _frame_number % _frames.size();
+}
+
+FrameTimings Engine::average_frame_timings() const {
+    // only average over frames that have actually been drawn
+    size_t n = std::min(_frame_timings.size(), (size_t)_frame_number);
+    FrameTimings avg{0.f, 0.f, 0.f};
+    for (size_t i = 0; i < n; ++i) {
+        avg.fence_wait_ms += _frame_timings[i].fence_wait_ms;
+        avg.acquire_ms += _frame_timings[i].acquire_ms;
+        avg.record_ms += _frame_timings[i].record_ms;
+    }
+    if (n > 0) {
+        avg.fence_wait_ms /= n;
+        avg.acquire_ms /= n;
+        avg.record_ms /= n;
+    }
+    return avg;
 }
 
 AllocatedBuffer Engine::create_buffer(size_t size,
                                       VkBufferUsageFlags usage,
-                                      VmaMemoryUsage memory_usage) {
+                                      VmaMemoryUsage memory_usage,
+                                      MemCategory category,
+                                      char const* name) {
     VkBufferCreateInfo info = {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .pNext = nullptr,
@@ -557,6 +642,7 @@ AllocatedBuffer Engine::create_buffer(size_t size,
 
     VK_CHECK(vmaCreateBuffer(
         _allocator, &info, &alloc_info, &buf.buf, &buf.alloc, nullptr));
+    _mem_stats.track(_allocator, buf.alloc, category, name);
     return buf;
 }
 
@@ -598,6 +684,110 @@ void Engine::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& fun) {
     vkResetCommandPool(_device, _upload_context.command_pool, 0);
 }
 
+void Engine::MainThreadAwaiter::await_suspend(std::coroutine_handle<> h) {
+    std::lock_guard lock{engine->_main_mutex};
+    if (!record) {
+        engine->_main_queue.push_back([h] { h.resume(); });
+        return;
+    }
+    engine->_main_queue.push_back([e = engine, record = std::move(record), h] {
+        VkCommandBuffer cmd;
+        auto cmd_info =
+            vkinit::command_buffer_allocate_info(e->_async_upload_pool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(e->_device, &cmd_info, &cmd));
+        auto begin_info = vkinit::command_buffer_begin_info(
+            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+        record(cmd);
+        VK_CHECK(vkEndCommandBuffer(cmd));
+
+        VkFence fence;
+        auto fence_info = vkinit::fence_create_info();
+        VK_CHECK(vkCreateFence(e->_device, &fence_info, nullptr, &fence));
+        auto submit = vkinit::submit_info(&cmd);
+        VK_CHECK(vkQueueSubmit(e->_gfx_queue, 1, &submit, fence));
+        e->_async_uploads.push_back({fence, cmd, h});
+    });
+}
+
+void Engine::spawn(Task<> task) {
+    ++_async_pending;
+    auto tracked = [](Engine* e, Task<> task) -> Task<> {
+        co_await task;
+        --e->_async_pending;
+    };
+    tracked(this, std::move(task)).detach();
+}
+
+void Engine::pump_async() {
+    std::vector<std::function<void()>> queue;
+    {
+        std::lock_guard lock{_main_mutex};
+        queue.swap(_main_queue);
+    }
+    for (auto& fn : queue) {
+        fn();
+    }
+
+    for (size_t i = 0; i < _async_uploads.size();) {
+        auto up = _async_uploads[i];
+        if (vkGetFenceStatus(_device, up.fence) != VK_SUCCESS) {
+            ++i;
+            continue;
+        }
+        _async_uploads[i] = _async_uploads.back();
+        _async_uploads.pop_back();
+        vkDestroyFence(_device, up.fence, nullptr);
+        vkFreeCommandBuffers(_device, _async_upload_pool, 1, &up.cmd);
+        up.waiter.resume();
+    }
+}
+
+void Engine::wait_async() {
+    while (_async_pending > 0) {
+        pump_async();
+        std::this_thread::yield();
+    }
+}
+
+void Engine::update_memory_budget() {
+    // lets VMA refresh its budget numbers from the driver
+    vmaSetCurrentFrameIndex(_allocator, _frame_number);
+
+    VkPhysicalDeviceMemoryProperties const* props;
+    vmaGetMemoryProperties(_allocator, &props);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(_allocator, budgets);
+
+    _mem_budget = {0, 0};
+    for (uint32_t i = 0; i < props->memoryHeapCount; ++i) {
+        if (props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            _mem_budget.usage += budgets[i].usage;
+            _mem_budget.budget += budgets[i].budget;
+        }
+    }
+}
+
+bool Engine::over_memory_budget() const {
+    return _mem_budget.usage > _mem_budget.budget * _mem_budget_fraction;
+}
+
+void Engine::on_key(int key) {
+    if (key == GLFW_KEY_M) {
+        dump_memory_stats();
+    }
+}
+
+void Engine::dump_memory_stats() {
+    _mem_stats.print(_allocator, std::cout);
+    auto path = "vma_stats_" + std::to_string(_frame_number) + ".json";
+    if (MemoryStats::dump_json(_allocator, path)) {
+        std::cout << "Wrote " << path << "\n";
+    } else {
+        std::cerr << "Couldn't write " << path << "\n";
+    }
+}
+
 VkViewport Engine::get_viewport() const {
     VkViewport viewport = {
         .x = 0.f,
@@ -7,16 +7,25 @@
 #include <vk_mem_alloc.h>
 #include <vulkan/vk_enum_string_helper.h>
 #include <vulkan/vulkan.h>
-#include <deque>
+#include <atomic>
 #include <functional>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <mutex>
+#include "bindless.h"
+#include "deletion_queue.h"
+#include "job_system.h"
+#include "memory_stats.h"
+#include "render_graph.h"
+#include "task.h"
 #include "vk_mesh.h"
 #include "vk_types.h"
 
+// default number of frames in flight, see Engine::_frame_overlap
 #ifndef FRAME_OVERLAP
 #define FRAME_OVERLAP 2
 #endif  // FRAME_OVERLAP
+#define MAX_FRAME_OVERLAP 8
 
 #define SHADER_DIRECTORY "../shaders/"
 
@@ -29,36 +38,29 @@
             throw std::runtime_error("Vulkan error.");                    \
         }                                                                 \
     } while (0)
-#define ENQUEUE_DELETE(x) _del_queue.push([=]() { x; })
-
-struct DeletionQueue {
-    std::deque<std::function<void()>> deletors;
-
-    void push(std::function<void()>&& f) { deletors.push_back(f); }
-
-    void flush() {
-        std::cout << "Deleting " << deletors.size() << " things...\n";
-        while (!deletors.empty()) {
-            (*deletors.rbegin())();
-            deletors.pop_back();
-        }
-    }
-};
+#define ENQUEUE_DELETE(x) _del_queue.push(x)
 
 struct Material {
     VkPipeline pipeline;
     VkPipelineLayout pipeline_layout;
+    uint32_t texture{BINDLESS_NONE};  // bindless slot
 };
 
 struct RenderObject {
     Mesh* mesh;
     Material* mat;
-    glm::mat4 transform;
+    uint32_t node;  // in the scene's transform tree
 };
 
-struct MeshPushConstants {
-    glm::vec4 data;
-    glm::mat4 render_matrix;
+/**
+ * Pushed once per frame.  Slots in the bindless set for this frame's
+ * buffers, which every pipeline finds at the same push constant offset.
+ */
+struct FramePushConstants {
+    uint32_t camera_buf;
+    uint32_t scene_buf;
+    uint32_t object_buf;
+    uint32_t frame_idx;  // into the scene buffer
 };
 
 struct GPUCameraData {
@@ -75,31 +77,100 @@ struct FrameData {
     VkCommandPool command_pool;
     VkCommandBuffer cmd;
 
+    // slots in the bindless set
     AllocatedBuffer cam_buf;
-    VkDescriptorSet global_descriptor;
+    uint32_t cam_buf_id;
 
     AllocatedBuffer obj_buf;
-    VkDescriptorSet obj_descriptor;
+    uint32_t obj_buf_id;
+
+    AllocatedBuffer info_buf;  // rewritten only when the objects change
+    uint32_t info_buf_id;
+
+    // transient descriptor sets, reset once render_fence has passed
+    DescriptorAllocator descriptors;
+
+    // retired once render_fence has passed
+    DeletionQueue del_queue;
+};
+
+/**
+ * Where the CPU spent its time during one draw() call.
+ */
+struct FrameTimings {
+    float fence_wait_ms;  // blocked on render_fence (GPU is behind)
+    float acquire_ms;     // blocked on vkAcquireNextImageKHR (present)
+    float record_ms;      // from vkBeginCommandBuffer() to submitting
+};
+
+/**
+ * Device-local memory across all heaps, from VK_EXT_memory_budget if
+ * available.  Refreshed once per frame.
+ */
+struct MemoryBudget {
+    VkDeviceSize usage;   // bytes currently in use (by any process)
+    VkDeviceSize budget;  // bytes we can allocate without trouble
 };
 
 struct GPUObjectData {
-    glm::mat4 model_mat;
+    // the model transform, expanded in the shaders: scale, rotate, then
+    // translate.  Uniform scale only, see TransformTree.
+    glm::vec4 position_scale;  // xyz: translation, w: scale
+    glm::vec4 rotation;        // unit quaternion, x y z w
 };
 
+/** The rest of an object, what culling needs.  Changes rarely. */
+struct GPUObjectInfo {
+    // x: texture slot or BINDLESS_NONE, y: vertex count, z: OBJECT_* flags,
+    // w: first vertex (of the LOD drawn)
+    glm::uvec4 ids;
+    glm::vec4 bounds;  // bounding sphere in model space: center, radius
+};
+
+// GPUObjectInfo::ids.z, must match cull.comp
+#define OBJECT_CULLED 1  // drawn indirectly, after occlusion culling
+
 struct UploadContext {
     VkFence upload_fence;
     VkCommandPool command_pool;
     VkCommandBuffer cmd;
 };
 
+/** A copy submitted by Engine::upload(), and who waits for it. */
+struct AsyncUpload {
+    VkFence fence;
+    VkCommandBuffer cmd;
+    std::coroutine_handle<> waiter;
+};
+
 class Engine {
    public:
     VkPhysicalDeviceProperties _gpu_properties;
     VkPhysicalDeviceFeatures _gpu_features;
+    bool _has_int64_atomics{false};  // 64-bit atomics on storage buffers
+    bool _has_multi_draw_indirect{false};  // with firstInstance
 
     bool _is_initialized{false};
     int _frame_number{0};
     std::vector<float> _draw_times;
+    std::vector<FrameTimings> _frame_timings;  // ring buffer, last N frames
+
+    // Frames in flight.  Set before init(), clamped to [1, MAX_FRAME_OVERLAP].
+    uint32_t _frame_overlap{FRAME_OVERLAP};
+
+    // Shared by everything that splits work across cores.  The thread that
+    // calls init() is worker 0.  Set the count before init(), 0 is one per
+    // core.
+    JobSystem _jobs;
+    uint32_t _worker_count{0};
+
+    // Simulation runs on its own thread while frames are drawn, see
+    // update().  Set the rate before run().
+    uint32_t _tick_rate{60};  // updates per second
+    std::thread _update_thread;
+    std::atomic<bool> _updating{false};
+    std::mutex _update_mutex;  // guards _update_queue
+    std::vector<std::function<void()>> _update_queue;  // see post_update()
 
     int _selected_shader{0};  // NOTE:  Not implemented for glfw
 
@@ -107,9 +178,16 @@ class Engine {
     GLFWwindow* _window{nullptr};
 
     VmaAllocator _allocator;
+    bool _has_memory_budget{false};
+    MemoryBudget _mem_budget{0, 0};
+    float _mem_budget_fraction{0.9f};  // start evicting above this
+    MemoryStats _mem_stats;
 
     DeletionQueue _del_queue;
 
+    // Set layouts, shared by all; sets come from FrameData::descriptors
+    DescriptorLayoutCache _layout_cache;
+
     // Vulkan Init
     VkInstance _instance;
     VkDebugUtilsMessengerEXT _debug_messenger;
@@ -124,8 +202,6 @@ class Engine {
     std::vector<VkImageView> _swapchain_views;
 
     // Depth bufer
-    VkImageView _depth_view;
-    AllocatedImage _depth_img;
     VkFormat _depth_format;
 
     // Command setup
@@ -133,21 +209,33 @@ class Engine {
     uint32_t _gfx_queue_family;
 
     // Renderpass
-    VkRenderPass _render_pass;
-    std::vector<VkFramebuffer> _framebuffers;
+    RenderGraph _graph;
+    RGResource _rg_swapchain;
+    RGResource _rg_depth;
+    VkRenderPass _render_pass;  // the "forward" pass
 
-    // Sync
-    FrameData _frames[FRAME_OVERLAP];
+    // Sync, one entry per frame in flight
+    std::vector<FrameData> _frames;
 
     // Uploading to GPU
     UploadContext _upload_context;
 
+    // Async loading, see spawn()
+    std::mutex _main_mutex;  // guards _main_queue
+    std::vector<std::function<void()>> _main_queue;  // run by pump_async()
+    VkCommandPool _async_upload_pool;
+    std::vector<AsyncUpload> _async_uploads;  // in flight
+    std::atomic<uint32_t> _async_pending{0};  // spawned, not done
+
     // Methods
     void init();
     void cleanup();
     void draw();
     void run();
 
+    /** Average timings over the last `_frame_timings.size()` frames. */
+    FrameTimings average_frame_timings() const;
+
    protected:
     /**
      * Initialization functions.
@@ -158,32 +246,89 @@ class Engine {
     void init_vulkan();
     void init_swapchain();
     void init_commands();
-    void init_default_renderpass();
-    void init_framebuffers();
+    void init_render_graph();
     void init_sync_structures();
+    void init_descriptor_allocators();
     virtual void init_descriptors() = 0;
     virtual void init_pipelines() = 0;
     virtual void init_materials() = 0;
     virtual void init_scene(){};
 
+    /**
+     * Declare the frame's passes on `graph`.  `_rg_swapchain` and
+     * `_rg_depth` are already set up.  There has to be a graphics pass
+     * named "forward"; the default is just that, calling render_pass().
+     */
+    virtual void declare_passes(RenderGraph& graph);
+
     /** Load a compiled shader from `file_path` into VkShaderModule `out`. */
     bool try_load_shader_module(const char* file_path, VkShaderModule* out);
 
+    /**
+     * Called before init_pipelines().  Whatever is still loading when the
+     * first frame is drawn should be spawn()ed, with a placeholder in its
+     * place until then.
+     */
     virtual void load_meshes() = 0;
 
+    /**
+     * Called on the update thread, _tick_rate times a second, while run()
+     * draws frames on the main thread.  Advance the simulation and publish
+     * a snapshot of it for prepare_frame(), e.g. through a TripleBuffer.
+     * Tick 0 is run on the main thread, before the first frame.  Don't
+     * touch Vulkan or anything the frames use here.
+     */
+    virtual void update(uint64_t){};
+
+    /** Run `fn` on the update thread, before its next update(). */
+    void post_update(std::function<void()> fn);
+
+    /**
+     * Called once per frame, after the frame's fence, before recording.
+     * Upload per-frame data and decide what to draw here.
+     */
+    virtual void prepare_frame(){};
+
+    /**
+     * Called on cleanup, before the deletion queues are flushed.  Hand
+     * runtime-owned resources to destroy_later() here.
+     */
+    virtual void unload_meshes(){};
+
     /**
      * Called during the render pass.  Place draw commands etc. here.
      */
     virtual void render_pass(VkCommandBuffer cmd) = 0;
 
+    /**
+     * Called on key press, with a GLFW_KEY_* code.  The default handles
+     * M, which prints memory statistics and dumps VMA's JSON.
+     */
+    virtual void on_key(int key);
+
+    /** Print memory counters and write `vma_stats_<frame>.json`. */
+    void dump_memory_stats();
+
     /**
      * Get the current frame, out of the frames in flight.
      */
     FrameData& get_current_frame();
+    uint32_t get_current_frame_index() const;
+
+    /**
+     * Destroy `handle` once the GPU is done with everything submitted so
+     * far, i.e. the next time the current frame slot comes around.
+     */
+    template <typename T>
+    void destroy_later(T handle) {
+        get_current_frame().del_queue.push(handle);
+    }
 
     AllocatedBuffer create_buffer(size_t size,
                                   VkBufferUsageFlags usage,
-                                  VmaMemoryUsage memory_usage);
+                                  VmaMemoryUsage memory_usage,
+                                  MemCategory category,
+                                  char const* name);
 
     /**
      * Pad `original_size` in accordance with minUniformBufferOffsetAlignment.
@@ -191,6 +336,58 @@ class Engine {
     size_t pad_uniform_buf_size(size_t original_size) const;
     void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& fun);
 
+    /** Continues a coroutine on the main thread, see on_main(). */
+    struct MainThreadAwaiter {
+        Engine* engine;
+        std::function<void(VkCommandBuffer)> record;  // for upload()
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h);
+        void await_resume() const noexcept {}
+    };
+
+    /**
+     * Run `task` alongside the frames.  The window keeps drawing while it
+     * hops between the main thread and the workers, e.g. to load an asset:
+     *
+     *   co_await background();  // decode on a worker
+     *   co_await on_main();     // create buffers
+     *   co_await upload(...);   // copy, back on the main thread when done
+     *
+     * cleanup() waits for all spawned tasks.
+     */
+    void spawn(Task<> task);
+
+    /**
+     * co_await to continue on the main thread, right before the next
+     * prepare_frame().  The one place to touch engine state from a task.
+     */
+    MainThreadAwaiter on_main() { return {this, {}}; }
+
+    /** co_await to continue on a worker, for long CPU work. */
+    ResumeInBackground background() { return {_jobs}; }
+
+    /**
+     * co_await to record `record` on the main thread and submit it, without
+     * blocking like immediate_submit().  Continues on the main thread once
+     * the GPU has run it.
+     */
+    MainThreadAwaiter upload(std::function<void(VkCommandBuffer)> record) {
+        return {this, std::move(record)};
+    }
+
+    /** Run what tasks queued for the main thread, finish uploads. */
+    void pump_async();
+
+    /** pump_async() until all spawned tasks are done. */
+    void wait_async();
+
+    void update_loop();
+    void run_posted_updates();
+
+    void update_memory_budget();
+    bool over_memory_budget() const;
+
     // Helpers for pipeline init
     VkViewport get_viewport() const;
     VkRect2D get_scissor() const;
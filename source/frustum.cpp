@@ -0,0 +1,55 @@
+#include "frustum.h"
+#include <glm/gtc/matrix_access.hpp>
+
+Frustum::Frustum(glm::mat4 const& viewproj) {
+    // Gribb/Hartmann
+    glm::vec4 r0 = glm::row(viewproj, 0);
+    glm::vec4 r1 = glm::row(viewproj, 1);
+    glm::vec4 r2 = glm::row(viewproj, 2);
+    glm::vec4 r3 = glm::row(viewproj, 3);
+    planes[0] = r3 + r0;
+    planes[1] = r3 - r0;
+    planes[2] = r3 + r1;
+    planes[3] = r3 - r1;
+    planes[4] = r2;
+    planes[5] = r3 - r2;
+}
+
+bool Frustum::intersects_cube(glm::vec3 min, float size) const {
+    for (auto& plane : planes) {
+        // corner furthest along the plane normal
+        glm::vec3 corner = min;
+        corner.x += plane.x > 0 ? size : 0;
+        corner.y += plane.y > 0 ? size : 0;
+        corner.z += plane.z > 0 ? size : 0;
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersects_box(glm::vec3 min, glm::vec3 max) const {
+    for (auto& plane : planes) {
+        glm::vec3 corner{
+            plane.x > 0 ? max.x : min.x,
+            plane.y > 0 ? max.y : min.y,
+            plane.z > 0 ? max.z : min.z,
+        };
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersects_sphere(glm::vec3 center, float radius) const {
+    for (auto& plane : planes) {
+        // the planes aren't normalized
+        float dist = glm::dot(glm::vec3(plane), center) + plane.w;
+        if (dist < -radius * glm::length(glm::vec3(plane))) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,23 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+/** View frustum planes, for culling on the CPU. */
+struct Frustum {
+    glm::vec4 planes[6];  // xyz: inward normal, w: distance
+
+    /** Planes of `viewproj`, with clip space z in [0, w] as in Vulkan. */
+    explicit Frustum(glm::mat4 const& viewproj);
+
+    /** Whether an axis-aligned cube is at least partially inside. */
+    bool intersects_cube(glm::vec3 min, float size) const;
+
+    /** Whether an axis-aligned box is at least partially inside. */
+    bool intersects_box(glm::vec3 min, glm::vec3 max) const;
+
+    /** Whether a sphere is at least partially inside. */
+    bool intersects_sphere(glm::vec3 center, float radius) const;
+};
+
+#endif  // FRUSTUM_H
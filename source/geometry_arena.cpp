@@ -0,0 +1,103 @@
+#include "geometry_arena.h"
+
+void GeometryArena::init(uint32_t capacity) {
+    _capacity = capacity;
+    _used = 0;
+    _free.clear();
+    _by_size.clear();
+    _retired.clear();
+    if (capacity > 0) {
+        _free[0] = capacity;
+        _by_size.insert({capacity, 0});
+    }
+}
+
+std::optional<uint32_t> GeometryArena::allocate(uint32_t count) {
+    if (count == 0) {
+        return std::nullopt;
+    }
+    // smallest range that fits, leaving the large ones whole
+    auto fit = _by_size.lower_bound({count, 0});
+    if (fit == _by_size.end()) {
+        return std::nullopt;
+    }
+    uint32_t first = fit->second;
+    take(_free.find(first), count);
+    return first;
+}
+
+std::optional<uint32_t> GeometryArena::allocate_below(uint32_t limit,
+                                                      uint32_t count) {
+    if (count == 0) {
+        return std::nullopt;
+    }
+    // anything free that starts below an allocation also ends below it
+    for (auto it = _free.begin(); it != _free.end() && it->first < limit;
+         ++it) {
+        if (it->second >= count) {
+            uint32_t first = it->first;
+            take(it, count);
+            return first;
+        }
+    }
+    return std::nullopt;
+}
+
+void GeometryArena::take(std::map<uint32_t, uint32_t>::iterator it,
+                         uint32_t count) {
+    auto [first, size] = *it;
+    _by_size.erase({size, first});
+    _free.erase(it);
+    if (size > count) {
+        _free[first + count] = size - count;
+        _by_size.insert({size - count, first + count});
+    }
+    _used += count;
+}
+
+void GeometryArena::free(uint32_t first, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+    _used -= count;
+
+    // merge with the free neighbors, if any
+    auto next = _free.lower_bound(first);
+    if (next != _free.end() && first + count == next->first) {
+        _by_size.erase({next->second, next->first});
+        count += next->second;
+        next = _free.erase(next);
+    }
+    if (next != _free.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == first) {
+            _by_size.erase({prev->second, prev->first});
+            first = prev->first;
+            count += prev->second;
+            _free.erase(prev);
+        }
+    }
+    _free[first] = count;
+    _by_size.insert({count, first});
+}
+
+void GeometryArena::free_after(uint32_t first,
+                               uint32_t count,
+                               uint64_t frame) {
+    _retired.push_back({first, count, frame});
+}
+
+void GeometryArena::reclaim(uint64_t idle_before) {
+    while (!_retired.empty() && _retired.front().frame < idle_before) {
+        free(_retired.front().first, _retired.front().count);
+        _retired.pop_front();
+    }
+}
+
+uint32_t GeometryArena::high_water() const {
+    if (_free.empty()) {
+        return _capacity;
+    }
+    auto& [first, count] = *_free.rbegin();
+    return first + count == _capacity ? first : _capacity;
+}
@@ -0,0 +1,71 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <optional>
+#include <set>
+#include <utility>
+
+/**
+ * Suballocates vertex ranges from one large buffer, so that all meshes
+ * share a single vertex buffer binding and draw with firstVertex.  Pure
+ * bookkeeping in units of vertices, the engine owns the buffer and does
+ * the copying.
+ *
+ * Free ranges are kept sorted by offset, to merge them with their
+ * neighbors, and by size, for best-fit allocation.  Ranges the GPU may
+ * still read are retired with free_after() and only reused after
+ * reclaim().  allocate_below() finds a lower place to move an allocation
+ * to, for compacting the arena.
+ */
+class GeometryArena {
+   public:
+    void init(uint32_t capacity);
+
+    /** First vertex of `count` free ones, or nothing if none fit. */
+    std::optional<uint32_t> allocate(uint32_t count);
+
+    /**
+     * Like allocate(), but the lowest free range that ends at or before
+     * `limit`.  Meant for moving the allocation at `limit` down.
+     */
+    std::optional<uint32_t> allocate_below(uint32_t limit, uint32_t count);
+
+    /** Free a range right away, e.g. one no frame in flight uses. */
+    void free(uint32_t first, uint32_t count);
+
+    /** Free a range once reclaim() is past `frame`. */
+    void free_after(uint32_t first, uint32_t count, uint64_t frame);
+
+    /**
+     * Free ranges retired before `idle_before`, the oldest frame the GPU
+     * may still be working on.
+     */
+    void reclaim(uint64_t idle_before);
+
+    uint32_t capacity() const { return _capacity; }
+    uint32_t used() const { return _used; }  // including retired ranges
+    uint32_t free_ranges() const { return _free.size(); }
+
+    /** End of the highest allocation; compacting lowers it. */
+    uint32_t high_water() const;
+
+   private:
+    struct Retired {
+        uint32_t first;
+        uint32_t count;
+        uint64_t frame;
+    };
+
+    void take(std::map<uint32_t, uint32_t>::iterator it, uint32_t count);
+
+    uint32_t _capacity{0};
+    uint32_t _used{0};
+    std::map<uint32_t, uint32_t> _free;               // first -> count
+    std::set<std::pair<uint32_t, uint32_t>> _by_size;  // count, first
+    std::deque<Retired> _retired;                      // oldest first
+};
+
+#endif  // GEOMETRY_ARENA_H
@@ -1,163 +1,137 @@
 #define VMA_IMPLEMENTATION
 
 #include "hello_engine.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <unordered_set>
 #include <glm/ext/matrix_clip_space.hpp>
 #include <glm/ext/matrix_transform.hpp>
+#include "frustum.h"
 #include "pipeline_builder.h"
+#include "point_sort.h"
 #include "vk_init.h"
 #include "vk_types.h"
 
 void HelloEngine::init_descriptors() {
-    // Layout
-    auto cam_buf_binding = vkinit::descriptorset_layout_binding(
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
-    auto scene_buf_binding = vkinit::descriptorset_layout_binding(
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-        1);
-    VkDescriptorSetLayoutBinding bindings[] = {cam_buf_binding,
-                                               scene_buf_binding};
-
-    // descriptor set for global set
-    VkDescriptorSetLayoutCreateInfo set_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-        .bindingCount = 2,
-        .pBindings = bindings,
-    };
-    VK_CHECK(vkCreateDescriptorSetLayout(
-        _device, &set_info, nullptr, &_global_set_layout));
-    ENQUEUE_DELETE(
-        vkDestroyDescriptorSetLayout(_device, _global_set_layout, nullptr));
-
-    // descriptor set for object storage buffer
-    auto obj_buf_bind = vkinit::descriptorset_layout_binding(
-        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0);
-    VkDescriptorSetLayoutCreateInfo obj_set_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-        .bindingCount = 1,
-        .pBindings = &obj_buf_bind,
-    };
-    VK_CHECK(vkCreateDescriptorSetLayout(
-        _device, &obj_set_info, nullptr, &_obj_set_layout));
-    ENQUEUE_DELETE(
-        vkDestroyDescriptorSetLayout(_device, _obj_set_layout, nullptr));
-
-    // Uniform buffer for scene data
-    // need one for each overlapping frame
-    const size_t scene_data_buf_size =
-        FRAME_OVERLAP * pad_uniform_buf_size(sizeof(GPUSceneData));
-    _scene_data_buf = create_buffer(scene_data_buf_size,
-                                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                    VMA_MEMORY_USAGE_CPU_TO_GPU);
-    ENQUEUE_DELETE(vmaDestroyBuffer(
-        _allocator, _scene_data_buf.buf, _scene_data_buf.alloc));
-
-    // Pool holds 10 uniform buffers, 10 dynamic buffers, 10 storage buffers
-    std::vector<VkDescriptorPoolSize> sizes = {
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10},
-        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10},
-        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10},
-    };
-    VkDescriptorPoolCreateInfo pool_info = {
-        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .pNext = nullptr,
-        .flags = 0,
-        .maxSets = 10,
-        .poolSizeCount = (uint32_t)sizes.size(),
-        .pPoolSizes = sizes.data(),
+    _bindless.init(
+        _device, _layout_cache, MAX_BINDLESS_BUFFERS, MAX_BINDLESS_TEXTURES);
+    ENQUEUE_DELETE(_bindless.pool());
+
+    // Every pipeline uses this layout: the bindless set plus the slots of
+    // this frame's buffers as push constants
+    VkPushConstantRange push_constant = {
+        .stageFlags = VK_SHADER_STAGE_ALL,
+        .offset = 0,
+        .size = sizeof(FramePushConstants),
     };
-    VK_CHECK(vkCreateDescriptorPool(
-        _device, &pool_info, nullptr, &_descriptor_pool));
-    ENQUEUE_DELETE(vkDestroyDescriptorPool(_device, _descriptor_pool, nullptr));
+    VkDescriptorSetLayout set_layout = _bindless.layout();
+    auto layout_info = vkinit::pipeline_layout_create_info();
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_constant;
+    VK_CHECK(vkCreatePipelineLayout(
+        _device, &layout_info, nullptr, &_pipeline_layout));
+    ENQUEUE_DELETE(_pipeline_layout);
+
+    // Scene data, one entry for each overlapping frame
+    _scene_data_buf = create_buffer(_frames.size() * sizeof(GPUSceneData),
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                    VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                    MemCategory::Uniform,
+                                    "scene data");
+    ENQUEUE_DELETE(_scene_data_buf);
+    _scene_data_buf_id = _bindless.add_buffer(_scene_data_buf.buf);
 
     // per-frame stuff
-    for (int i = 0; i < FRAME_OVERLAP; ++i) {
-        // Buffers
+    for (size_t i = 0; i < _frames.size(); ++i) {
         _frames[i].cam_buf = create_buffer(sizeof(GPUCameraData),
-                                           VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                                           VMA_MEMORY_USAGE_CPU_TO_GPU);
-        ENQUEUE_DELETE(vmaDestroyBuffer(
-            _allocator, _frames[i].cam_buf.buf, _frames[i].cam_buf.alloc));
+                                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                           VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                           MemCategory::Uniform,
+                                           "camera");
+        ENQUEUE_DELETE(_frames[i].cam_buf);
+        _frames[i].cam_buf_id = _bindless.add_buffer(_frames[i].cam_buf.buf);
 
-        const int MAX_OBJECTS = 10000;
         _frames[i].obj_buf = create_buffer(sizeof(GPUObjectData) * MAX_OBJECTS,
                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                                           VMA_MEMORY_USAGE_CPU_TO_GPU);
-        ENQUEUE_DELETE(vmaDestroyBuffer(
-            _allocator, _frames[i].obj_buf.buf, _frames[i].obj_buf.alloc));
+                                           VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                           MemCategory::Uniform,
+                                           "objects");
+        ENQUEUE_DELETE(_frames[i].obj_buf);
+        _frames[i].obj_buf_id = _bindless.add_buffer(_frames[i].obj_buf.buf);
+
+        _frames[i].info_buf = create_buffer(sizeof(GPUObjectInfo) * MAX_OBJECTS,
+                                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                            VMA_MEMORY_USAGE_CPU_TO_GPU,
+                                            MemCategory::Uniform,
+                                            "object info");
+        ENQUEUE_DELETE(_frames[i].info_buf);
+        _frames[i].info_buf_id =
+            _bindless.add_buffer(_frames[i].info_buf.buf);
+    }
+    _object_info_keys.resize(_frames.size());
+
+    // Software point rasterizer: the raster buffer is bindless, the points
+    // come in through a per-frame set
+    _point_raster_buf_id = _bindless.add_buffer(_point_raster_buf.buf);
+    auto points_binding = vkinit::descriptorset_layout_binding(
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+    VkDescriptorSetLayoutCreateInfo points_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0,
+        .bindingCount = 1,
+        .pBindings = &points_binding,
+    };
+    _point_set_layout = _layout_cache.create_layout(points_info);
 
-        // Allocate Descriptor sets
-        VkDescriptorSetAllocateInfo alloc_info = {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-            .pNext = nullptr,
-            .descriptorPool = _descriptor_pool,
-            .descriptorSetCount = 1,
-            .pSetLayouts = &_global_set_layout,
-        };
-        VK_CHECK(vkAllocateDescriptorSets(
-            _device, &alloc_info, &_frames[i].global_descriptor));
-
-        // point descriptor set 0 to camera data buffer
-        VkDescriptorBufferInfo cam_buf_info = {
-            .buffer = _frames[i].cam_buf.buf,
-            .offset = 0,
-            .range = sizeof(GPUCameraData),
-        };
-        auto cam_set_write =
-            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                                            _frames[i].global_descriptor,
-                                            &cam_buf_info,
-                                            0);
-        // descriptor set 1 is scene data buffer
-        VkDescriptorBufferInfo scene_buf_info = {
-            .buffer = _scene_data_buf.buf,
-            .offset = 0,
-            .range = sizeof(GPUSceneData),
-        };
-        auto scene_set_write = vkinit::write_descriptor_buffer(
-            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-            _frames[i].global_descriptor,
-            &scene_buf_info,
-            1);
-
-        // object buffer
-        VkDescriptorSetAllocateInfo obj_set_alloc = {
-            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
-            .pNext = nullptr,
-            .descriptorPool = _descriptor_pool,
-            .descriptorSetCount = 1,
-            .pSetLayouts = &_obj_set_layout,
-        };
-        VK_CHECK(vkAllocateDescriptorSets(
-            _device, &obj_set_alloc, &_frames[i].obj_descriptor));
+    VkPushConstantRange raster_constants = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(PointRasterConstants),
+    };
+    VkDescriptorSetLayout raster_sets[] = {set_layout, _point_set_layout};
+    auto raster_layout_info = vkinit::pipeline_layout_create_info();
+    raster_layout_info.setLayoutCount = 2;
+    raster_layout_info.pSetLayouts = raster_sets;
+    raster_layout_info.pushConstantRangeCount = 1;
+    raster_layout_info.pPushConstantRanges = &raster_constants;
+    VK_CHECK(vkCreatePipelineLayout(
+        _device, &raster_layout_info, nullptr, &_point_raster_layout));
+    ENQUEUE_DELETE(_point_raster_layout);
+
+    // Occlusion culling: draw commands, visibility, the depth pyramid and
+    // the depth buffer it is built from are all bindless
+    _draws_buf_id = _bindless.add_buffer(_draws_buf.buf);
+    _visibility_buf_id = _bindless.add_buffer(_visibility_buf.buf);
+    _pyramid_buf_id = _bindless.add_buffer(_pyramid_buf.buf);
+    auto sampler_info = vkinit::sampler_create_info(
+        VK_FILTER_NEAREST, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE);
+    VK_CHECK(vkCreateSampler(_device, &sampler_info, nullptr, &_depth_sampler));
+    ENQUEUE_DELETE(_depth_sampler);
+    _depth_tex_id = _bindless.add_texture(_graph.get_image_view(_rg_depth),
+                                          _depth_sampler);
+
+    // nothing was visible before the first frame, the late pass draws it
+    immediate_submit([&](VkCommandBuffer cmd) {
+        vkCmdFillBuffer(cmd, _visibility_buf.buf, 0, VK_WHOLE_SIZE, 0);
+    });
 
-        VkDescriptorBufferInfo obj_buf_info = {
-            .buffer = _frames[i].obj_buf.buf,
-            .offset = 0,
-            .range = sizeof(GPUObjectData) * MAX_OBJECTS,
-        };
-        auto obj_set_write =
-            vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                                            _frames[i].obj_descriptor,
-                                            &obj_buf_info,
-                                            0);
-
-        // Finally, update descriptor sets
-        VkWriteDescriptorSet write_descriptors[] = {
-            cam_set_write,
-            scene_set_write,
-            obj_set_write,
-        };
-        vkUpdateDescriptorSets(_device,
-                               3,  // descriptor write count
-                               write_descriptors,
-                               0,  // descriptor copy count
-                               nullptr);
-    }
+    VkPushConstantRange cull_constants = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = std::max(sizeof(CullConstants), sizeof(PyramidConstants)),
+    };
+    auto cull_layout_info = vkinit::pipeline_layout_create_info();
+    cull_layout_info.setLayoutCount = 1;
+    cull_layout_info.pSetLayouts = &set_layout;
+    cull_layout_info.pushConstantRangeCount = 1;
+    cull_layout_info.pPushConstantRanges = &cull_constants;
+    VK_CHECK(vkCreatePipelineLayout(
+        _device, &cull_layout_info, nullptr, &_cull_layout));
+    ENQUEUE_DELETE(_cull_layout);
 }
 
 void HelloEngine::init_pipelines() {
@@ -181,34 +155,9 @@ void HelloEngine::init_pipelines() {
     auto vert_mesh = vkinit::pipeline_shader_stage_create_info(
         VK_SHADER_STAGE_VERTEX_BIT, _tri_mesh_vert);
 
-    VkDescriptorSetLayout descriptor_set_layouts[] = {
-        _global_set_layout,
-        _obj_set_layout,
-    };
-    // Layout (Tri)
-    VkPipelineLayoutCreateInfo layout_info =
-        vkinit::pipeline_layout_create_info();
-    layout_info.setLayoutCount = 2;  // default_lit.frag uses sceneData,
-                                     // so we need to add the set layout for
-                                     // this pipeline too
-    layout_info.pSetLayouts = descriptor_set_layouts;
-    VK_CHECK(vkCreatePipelineLayout(
-        _device, &layout_info, nullptr, &_tri_pipeline_layout));
-
-    // Layout (Mesh)
-    VkPipelineLayoutCreateInfo layout_info_mesh =
-        vkinit::pipeline_layout_create_info();
-    VkPushConstantRange push_constant = {
-        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-        .offset = 0,
-        .size = sizeof(MeshPushConstants),
-    };
-    layout_info_mesh.pPushConstantRanges = &push_constant;
-    layout_info_mesh.pushConstantRangeCount = 1;
-    layout_info_mesh.setLayoutCount = 2;
-    layout_info_mesh.pSetLayouts = descriptor_set_layouts;
-    VK_CHECK(vkCreatePipelineLayout(
-        _device, &layout_info_mesh, nullptr, &_mesh_pipeline_layout));
+    Specialization<LitSpecConstants> lit_spec{_lit_spec};
+    lit_spec.map(0, &LitSpecConstants::fog)
+        .map(1, &LitSpecConstants::lighting_model);
 
     // Pipeline
     PipelineBuilder builder;
@@ -230,7 +179,7 @@ void HelloEngine::init_pipelines() {
 
     builder._color_blend_att = vkinit::color_blend_attachment_state();
 
-    builder._layout = _tri_pipeline_layout;
+    builder._layout = _pipeline_layout;
 
     _tri_pipeline = builder.build_pipeline(_device, _render_pass);
 
@@ -246,8 +195,8 @@ void HelloEngine::init_pipelines() {
     builder._stages.clear();
     builder._stages.push_back(vert_mesh);
     builder._stages.push_back(frag_rgb);
+    builder.set_specialization(VK_SHADER_STAGE_FRAGMENT_BIT, lit_spec.info());
 
-    builder._layout = _mesh_pipeline_layout;
     _mesh_pipeline = builder.build_pipeline(_device, _render_pass);
 
     // pipelines created, so we can delete the shader modules
@@ -257,69 +206,242 @@ void HelloEngine::init_pipelines() {
     vkDestroyShaderModule(_device, _tri_rgb_vert, nullptr);
     vkDestroyShaderModule(_device, _tri_mesh_vert, nullptr);
 
-    ENQUEUE_DELETE(vkDestroyPipeline(_device, _tri_pipeline, nullptr));
-    ENQUEUE_DELETE(vkDestroyPipeline(_device, _tri_rgb_pipeline, nullptr));
-    ENQUEUE_DELETE(vkDestroyPipeline(_device, _mesh_pipeline, nullptr));
-    ENQUEUE_DELETE(
-        vkDestroyPipelineLayout(_device, _tri_pipeline_layout, nullptr));
-    ENQUEUE_DELETE(
-        vkDestroyPipelineLayout(_device, _mesh_pipeline_layout, nullptr));
+    ENQUEUE_DELETE(_tri_pipeline);
+    ENQUEUE_DELETE(_tri_rgb_pipeline);
+    ENQUEUE_DELETE(_mesh_pipeline);
 
     // Also init pipeline for point clouds
     init_pointcloud_pipeline();
+    init_point_raster_pipelines();
+    init_cull_pipelines();
 }
 
 void HelloEngine::init_materials() {
-    create_mat(_mesh_pipeline, _mesh_pipeline_layout, "mesh");
+    create_mat(_mesh_pipeline, _pipeline_layout, "mesh");
     create_mat(
         _point_pipeline.pipeline, _point_pipeline.pipeline_layout, "points");
 }
 
 void HelloEngine::load_meshes() {
-    auto tri_mesh = Mesh::make_simple_triangle();
-    upload_mesh(tri_mesh);
-    _meshes["tri"] = tri_mesh;
-    auto monkey_mesh = Mesh::make_point_cloud(1e6);
-    upload_mesh(monkey_mesh);  // ~12ms/83.5fps
-    _meshes["monkey"] = monkey_mesh;
-    std::cout << "'Monkey' mesh has " << monkey_mesh.verts.size() / 1e6
-              << "M verts, buffer is "
-              << monkey_mesh.buf->alloc->GetSize() / 1e6 << "MB).\n";
+    init_geometry();
+
+    // upload in place, the residency manager keeps pointers to map entries
+    _meshes["tri"] = Mesh::make_simple_triangle();
+    upload_mesh(_meshes["tri"]);
+    if (_dynamic_points) {
+        // regenerated every frame anyway, see update_meshes()
+        auto& monkey_mesh = _meshes["monkey"];
+        monkey_mesh = Mesh::make_point_cloud(_point_count, _jobs);
+        monkey_mesh.dynamic = true;
+        upload_mesh(monkey_mesh);  // ~12ms/83.5fps
+    } else {
+        // a handful of points until the real cloud is in
+        _meshes["monkey"] = Mesh::make_point_cloud(4096, _jobs);
+        upload_mesh(_meshes["monkey"]);
+        spawn(load_point_cloud());
+    }
+    if (_grid_scene) {
+        _meshes["grid"] = Mesh::make_simple_triangle();
+        upload_mesh(_meshes["grid"]);
+        spawn(load_grid_mesh());
+    }
+}
+
+Task<> HelloEngine::load_point_cloud() {
+    Mesh mesh;
+    if (!_import_path.empty()) {
+        if (co_await import_point_cloud(_import_path, mesh)) {
+            auto& slot = install_mesh("monkey", std::move(mesh));
+            std::vector<uint32_t> objects;
+            for (uint32_t i = 0; i < _scene.size(); ++i) {
+                if (_scene[i].mesh == &slot) {
+                    objects.push_back(i);
+                }
+            }
+            post_update([this, objects, t = _point_cloud_transform] {
+                for (auto i : objects) {
+                    _sim_tree.set_local(_scene[i].node, t);
+                }
+            });
+            _mem_stats.print(_allocator, std::cout);
+            co_return;
+        }
+        std::cerr << "Showing a generated point cloud instead.\n";
+    }
+
+    co_await background();
+    mesh = Mesh::make_point_cloud(_point_count, _jobs);
+    downsample_points(mesh.verts);
+    mesh.octree = std::make_shared<PointOctree>();
+    mesh.octree->build(mesh.verts, _jobs);
+    std::cout << "Point octree: " << mesh.octree->nodes().size()
+              << " nodes, depth " << mesh.octree->depth() << ".\n";
+    if (!co_await upload_mesh_async(mesh)) {
+        co_return;  // keep the placeholder
+    }
+    std::cout << "'Monkey' mesh has " << mesh.verts.size() / 1e6
+              << "M verts.\n";
+    install_mesh("monkey", std::move(mesh));
+    _mem_stats.print(_allocator, std::cout);
+}
+
+void HelloEngine::downsample_points(std::vector<Vert>& points) {
+    if (_voxel_size <= 0.f || points.empty()) {
+        return;
+    }
+    std::vector<Vert> kept(points.size());
+    kept.resize(downsample_points(points.data(), points.size(), kept.data()));
+    points.assign(kept.begin(), kept.end());  // without the spare capacity
+    points.shrink_to_fit();
+}
+
+size_t HelloEngine::downsample_points(Vert const* src,
+                                      size_t count,
+                                      Vert* dst) {
+    auto start = std::chrono::steady_clock::now();
+    size_t kept = voxel_downsample(
+        src, count, dst, _voxel_size, _voxel_mode, _jobs);
+    auto ms = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+    std::cout << "Voxel grid kept " << kept / 1e6 << "M of " << count / 1e6
+              << "M points (" << ms << " ms).\n";
+    return kept;
+}
+
+Task<> HelloEngine::load_grid_mesh() {
+    co_await background();
+    Mesh mesh = Mesh::load_from_obj(_grid_mesh_path.c_str());
+    if (mesh.verts.empty()) {
+        co_return;  // said why already, keep the placeholder
+    }
+    std::cout << "Grid mesh '" << _grid_mesh_path << "' LODs:";
+    for (auto& lod : mesh.lods) {
+        std::cout << " " << lod.count / 3;
+    }
+    std::cout << " triangles.\n";
+    if (co_await upload_mesh_async(mesh)) {
+        install_mesh("grid", std::move(mesh));
+    }
+}
+
+Mesh& HelloEngine::install_mesh(std::string const& name, Mesh&& mesh) {
+    // same map entry, so objects and the residency manager can keep
+    // pointing at it
+    auto& slot = _meshes[name];
+    destroy_mesh(slot);
+    slot = std::move(mesh);
+    if (!slot.dynamic && !slot.verts.empty()) {
+        track_residency(slot);
+    }
+    return slot;
 }
 
 void HelloEngine::update_meshes() {
-    auto new_verts =
-        Mesh::make_point_cloud(_meshes["monkey"].verts.size()).verts;
-    _meshes["monkey"].verts = new_verts;
-    upload_mesh(_meshes["monkey"], false);  // ~12ms/83.5fps
+    _dirty_copies.clear();  // unless there's something to upload
+    if (!_dynamic_points) {
+        return;
+    }
+    auto& monkey = _meshes["monkey"];
+    uint32_t n = monkey.verts.size();
+    if (n == 0) {
+        return;
+    }
+    // a window sweeping through the cloud, like a scanner refreshing part
+    // of it every frame; wraps around into a second range
+    uint32_t span = std::clamp<uint32_t>(n * _dynamic_fraction, 1, n);
+    uint32_t first = (uint64_t)_frame_number * span % n;
+    uint32_t seed = _frame_number;
+    monkey.regenerate_points(first, span, _jobs, seed);
+    if (first + span > n) {
+        monkey.regenerate_points(0, first + span - n, _jobs, seed + 1);
+    }
+    upload_dirty(monkey);
+}
+
+void HelloEngine::upload_dirty(Mesh& mesh) {
+    auto& copies = _dirty_copies;
+    if (mesh.dirty.empty() || mesh.buf == VK_NULL_HANDLE) {
+        return;
+    }
+    // merged, so overlapping ranges aren't copied twice
+    std::sort(mesh.dirty.begin(), mesh.dirty.end(), [](auto a, auto b) {
+        return a.first < b.first;
+    });
+    uint32_t first = 0;
+    uint32_t end = 0;
+    for (auto& r : mesh.dirty) {
+        if (!copies.empty() && r.first <= end) {
+            end = std::max(end, r.first + r.count);
+            copies.back().size = (end - first) * sizeof(Vert);
+            continue;
+        }
+        first = r.first;
+        end = r.first + r.count;
+        copies.push_back({
+            .srcOffset = r.first * sizeof(Vert),
+            .dstOffset = (mesh.first_vert + r.first) * sizeof(Vert),
+            .size = r.count * sizeof(Vert),
+        });
+    }
+    mesh.dirty.clear();
+
+    // Packed into this frame's staging buffer, which no frame in flight
+    // reads from anymore.  Grown as needed, the old one is freed once the
+    // frame that used it is done.
+    VkDeviceSize bytes = 0;
+    for (auto& copy : copies) {
+        bytes += copy.size;
+    }
+    auto& staging = _dirty_staging[get_current_frame_index()];
+    if (staging.bytes < bytes) {
+        if (staging.buf.buf != VK_NULL_HANDLE) {
+            destroy_later(staging.buf);
+        }
+        staging.buf = create_buffer(bytes,
+                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                    VMA_MEMORY_USAGE_CPU_ONLY,
+                                    MemCategory::Staging,
+                                    "dynamic points staging");
+        staging.bytes = bytes;
+    }
+    char* data;
+    VK_CHECK(vmaMapMemory(_allocator, staging.buf.alloc, (void**)&data));
+    VkDeviceSize at = 0;
+    for (auto& copy : copies) {
+        memcpy(data + at,
+               (char const*)mesh.verts.data() + copy.srcOffset,
+               copy.size);
+        copy.srcOffset = at;
+        at += copy.size;
+    }
+    vmaUnmapMemory(_allocator, staging.buf.alloc);
+    _dirty_dst = mesh.buf;
+    _dynamic_bytes_uploaded = bytes;
 }
 
 void HelloEngine::init_pointcloud_pipeline() {
+    // Specialization
+    Specialization<PointSpecConstants> point_spec{_point_spec};
+    point_spec.map(0, &PointSpecConstants::size_mode)
+        .map(1, &PointSpecConstants::size);
+    Specialization<LitSpecConstants> lit_spec{_lit_spec};
+    lit_spec.map(0, &LitSpecConstants::fog)
+        .map(1, &LitSpecConstants::lighting_model);
+
     // Shaders
     VkShaderModule vert;
     try_load_shader_module(SHADER_DIRECTORY "point.vert.spv", &vert);
     auto vert_info = vkinit::pipeline_shader_stage_create_info(
-        VK_SHADER_STAGE_VERTEX_BIT, vert);
+        VK_SHADER_STAGE_VERTEX_BIT, vert, point_spec.info());
 
     VkShaderModule frag;
     try_load_shader_module(SHADER_DIRECTORY "point.frag.spv", &frag);
     auto frag_info = vkinit::pipeline_shader_stage_create_info(
-        VK_SHADER_STAGE_FRAGMENT_BIT, frag);
-
-    // Descriptor sets
-    VkDescriptorSetLayout descriptor_set_layouts[] = {
-        _global_set_layout,
-        _obj_set_layout,
-    };
+        VK_SHADER_STAGE_FRAGMENT_BIT, frag, lit_spec.info());
 
-    // Layout
-    auto layout_info = vkinit::pipeline_layout_create_info();
-    layout_info.setLayoutCount = 2;
-    layout_info.pSetLayouts = descriptor_set_layouts;
-    VK_CHECK(vkCreatePipelineLayout(
-        _device, &layout_info, nullptr, &_point_pipeline.pipeline_layout));
-    ENQUEUE_DELETE(vkDestroyPipelineLayout(
-        _device, _point_pipeline.pipeline_layout, nullptr));
+    // Layout, shared with all other pipelines
+    _point_pipeline.pipeline_layout = _pipeline_layout;
 
     // build pipeline itself
     auto vert_desc = Vert::get_desc();
@@ -339,122 +461,916 @@ void HelloEngine::init_pointcloud_pipeline() {
             true, true, VK_COMPARE_OP_LESS_OR_EQUAL),
     };
     _point_pipeline.pipeline = builder.build_pipeline(_device, _render_pass);
-    ENQUEUE_DELETE(
-        vkDestroyPipeline(_device, _point_pipeline.pipeline, nullptr));
+    ENQUEUE_DELETE(_point_pipeline.pipeline);
 
     // shader modules can be destroted immedeately
     vkDestroyShaderModule(_device, frag, nullptr);
     vkDestroyShaderModule(_device, vert, nullptr);
 }
 
-void HelloEngine::upload_mesh(Mesh& mesh, bool create_bufs) {
-    // Create staging buffer
-    const size_t buf_size = mesh.verts.size() * sizeof(Vert);
+void HelloEngine::init_point_raster_pipelines() {
+    if (!_has_int64_atomics) {
+        if (_point_renderer == PointRenderer::Compute) {
+            std::cerr << "No 64-bit atomics, drawing points as POINT_LIST.\n";
+            _point_renderer = PointRenderer::Fixed;
+        }
+        return;
+    }
+
+    // Rasterize
+    VkShaderModule comp;
+    try_load_shader_module(SHADER_DIRECTORY "point_raster.comp.spv", &comp);
+    VkComputePipelineCreateInfo comp_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .stage = vkinit::pipeline_shader_stage_create_info(
+            VK_SHADER_STAGE_COMPUTE_BIT, comp),
+        .layout = _point_raster_layout,
+    };
+    VK_CHECK(vkCreateComputePipelines(_device,
+                                      VK_NULL_HANDLE,  // pipeline cache
+                                      1,
+                                      &comp_info,
+                                      nullptr,
+                                      &_point_raster_pipeline));
+    ENQUEUE_DELETE(_point_raster_pipeline);
+    vkDestroyShaderModule(_device, comp, nullptr);
+
+    // Resolve, a fullscreen triangle in the forward pass
+    PointResolveSpecConstants resolve_consts = {
+        .fog = _lit_spec.fog,
+        .lighting_model = _lit_spec.lighting_model,
+        .raster_buf = _point_raster_buf_id,
+        .width = _window_extent.width,
+    };
+    Specialization<PointResolveSpecConstants> resolve_spec{resolve_consts};
+    resolve_spec.map(0, &PointResolveSpecConstants::fog)
+        .map(1, &PointResolveSpecConstants::lighting_model)
+        .map(2, &PointResolveSpecConstants::raster_buf)
+        .map(3, &PointResolveSpecConstants::width);
+
+    VkShaderModule vert;
+    try_load_shader_module(SHADER_DIRECTORY "fullscreen.vert.spv", &vert);
+    VkShaderModule frag;
+    try_load_shader_module(SHADER_DIRECTORY "point_resolve.frag.spv", &frag);
+    PipelineBuilder builder = {
+        ._stages =
+            {
+                vkinit::pipeline_shader_stage_create_info(
+                    VK_SHADER_STAGE_VERTEX_BIT, vert),
+                vkinit::pipeline_shader_stage_create_info(
+                    VK_SHADER_STAGE_FRAGMENT_BIT, frag, resolve_spec.info()),
+            },
+        ._vert_input_info = vkinit::vertex_input_state_create_info(),
+        ._input_assembly = vkinit::vertex_input_assembly_create_info(
+            VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST),
+        ._viewport = get_viewport(),
+        ._scissor = get_scissor(),
+        ._rasterizer =
+            vkinit::rasterization_state_create_info(VK_POLYGON_MODE_FILL),
+        ._color_blend_att = vkinit::color_blend_attachment_state(),
+        ._multisampling = vkinit::multisampling_state_create_info(),
+        ._layout = _pipeline_layout,
+        // the shader writes the points' depth
+        ._depth_stencil = vkinit::depth_stencil_create_info(
+            true, true, VK_COMPARE_OP_LESS_OR_EQUAL),
+    };
+    _point_resolve_pipeline = builder.build_pipeline(_device, _render_pass);
+    ENQUEUE_DELETE(_point_resolve_pipeline);
+    vkDestroyShaderModule(_device, frag, nullptr);
+    vkDestroyShaderModule(_device, vert, nullptr);
+}
+
+void HelloEngine::init_cull_pipelines() {
+    if (!_has_multi_draw_indirect) {
+        if (_occlusion_culling) {
+            std::cerr << "No indirect multi-draws, occlusion culling is off.\n";
+            _occlusion_culling = false;
+        }
+        return;
+    }
 
-    if (create_bufs) {
-        VkBufferCreateInfo staging_buf_info = {
-            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+    CullSpecConstants cull_consts = {.max_objects = MAX_OBJECTS};
+    Specialization<CullSpecConstants> cull_spec{cull_consts};
+    cull_spec.map(0, &CullSpecConstants::max_objects);
+
+    VkShaderModule cull;
+    try_load_shader_module(SHADER_DIRECTORY "cull.comp.spv", &cull);
+    VkShaderModule pyramid;
+    try_load_shader_module(SHADER_DIRECTORY "depth_pyramid.comp.spv",
+                           &pyramid);
+    VkComputePipelineCreateInfo infos[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
             .pNext = nullptr,
-            .size = buf_size,
-            .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        };
+            .stage = vkinit::pipeline_shader_stage_create_info(
+                VK_SHADER_STAGE_COMPUTE_BIT, cull, cull_spec.info()),
+            .layout = _cull_layout,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .pNext = nullptr,
+            .stage = vkinit::pipeline_shader_stage_create_info(
+                VK_SHADER_STAGE_COMPUTE_BIT, pyramid),
+            .layout = _cull_layout,
+        },
+    };
+    VkPipeline pipelines[2];
+    VK_CHECK(vkCreateComputePipelines(
+        _device, VK_NULL_HANDLE, 2, infos, nullptr, pipelines));
+    _cull_pipeline = pipelines[0];
+    _pyramid_pipeline = pipelines[1];
+    ENQUEUE_DELETE(_cull_pipeline);
+    ENQUEUE_DELETE(_pyramid_pipeline);
+    vkDestroyShaderModule(_device, pyramid, nullptr);
+    vkDestroyShaderModule(_device, cull, nullptr);
+}
 
-        VmaAllocationCreateInfo staging_alloc_info = {
-            .usage = VMA_MEMORY_USAGE_CPU_ONLY,
-        };
+void HelloEngine::declare_passes(RenderGraph& graph) {
+    // first, their copies feed both point renderers
+    init_live(graph);
+    init_dynamic(graph);
+
+    // one 64-bit word per pixel, depth << 32 | color
+    _point_raster_buf = create_buffer(
+        _window_extent.width * _window_extent.height * sizeof(uint64_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        MemCategory::Attachment,
+        "point raster");
+    ENQUEUE_DELETE(_point_raster_buf);
+    _rg_point_raster =
+        graph.import_buffer("point raster", _point_raster_buf.buf);
+
+    // culled unless _point_renderer is Compute
+    auto& raster =
+        graph.add_compute_pass("point raster")
+            .write_storage(_rg_point_raster,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT |
+                               VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+            .enable_if([this] {
+                return _point_renderer == PointRenderer::Compute;
+            })
+            .execute([this](VkCommandBuffer cmd) { rasterize_points(cmd); });
+    if (_live) {
+        raster.read_storage(_rg_live, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
+    if (_dynamic_points) {
+        raster.read_storage(_rg_dynamic, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    }
 
-        mesh.buf = std::make_shared<AllocatedBuffer>();
-        mesh.staging_buf = std::make_shared<AllocatedBuffer>();
-
-        VK_CHECK(vmaCreateBuffer(_allocator,
-                                 &staging_buf_info,
-                                 &staging_alloc_info,
-                                 &mesh.staging_buf->buf,
-                                 &mesh.staging_buf->alloc,
-                                 nullptr));
-
-        // create and allocate vertex buffer on gpu
-        VkBufferCreateInfo vertex_buf_info{staging_buf_info};
-        vertex_buf_info.usage =
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-        VmaAllocationCreateInfo vertex_alloc_info = {
-            .usage = VMA_MEMORY_USAGE_GPU_ONLY,
-        };
-        VK_CHECK(vmaCreateBuffer(_allocator,
-                                 &vertex_buf_info,
-                                 &vertex_alloc_info,
-                                 &mesh.buf->buf,
-                                 &mesh.buf->alloc,
-                                 nullptr));
+    // Occlusion culling: early and late draw commands for every object
+    _draws_buf = create_buffer(2 * MAX_OBJECTS * sizeof(VkDrawIndirectCommand),
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                               VMA_MEMORY_USAGE_GPU_ONLY,
+                               MemCategory::Uniform,
+                               "draw commands");
+    ENQUEUE_DELETE(_draws_buf);
+    _rg_draws = graph.import_buffer("draw commands", _draws_buf.buf);
+
+    // read by the next frame, so it outlives the graph's frame
+    _visibility_buf = create_buffer(
+        MAX_OBJECTS * sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY,
+        MemCategory::Uniform,
+        "visibility");
+    ENQUEUE_DELETE(_visibility_buf);
+    _rg_visibility = graph.import_buffer("visibility", _visibility_buf.buf);
+
+    // level 0 is half the depth buffer, one float per texel
+    _pyramid_levels.clear();
+    VkExtent2D level = _window_extent;
+    size_t pyramid_texels = 0;
+    do {
+        level = {std::max(1u, level.width / 2), std::max(1u, level.height / 2)};
+        _pyramid_levels.push_back(level);
+        pyramid_texels += level.width * level.height;
+    } while (level.width > 1 || level.height > 1);
+    _pyramid_buf = create_buffer(pyramid_texels * sizeof(float),
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                 VMA_MEMORY_USAGE_GPU_ONLY,
+                                 MemCategory::Attachment,
+                                 "depth pyramid");
+    ENQUEUE_DELETE(_pyramid_buf);
+    _rg_pyramid = graph.import_buffer("depth pyramid", _pyramid_buf.buf);
+
+    // The culling passes are culled from the graph unless
+    // _occlusion_culling is set, so the depth buffer isn't stored for
+    // nothing.  What was visible last frame is drawn first, the depth
+    // pyramid is built from that, and whatever it doesn't hide is drawn
+    // late.
+    auto culling = [this] { return _occlusion_culling; };
+    graph.add_compute_pass("cull early")
+        .read_storage(_rg_visibility, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+        .write_storage(_rg_draws, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+        .enable_if(culling)
+        .execute(
+            [this](VkCommandBuffer cmd) { cull_objects(cmd, false); });
+
+    VkClearValue clear = {
+        .color = {1.0f, 1.0f, 1.0f, 1.0f},
+    };
+    VkClearValue depth_clear;
+    depth_clear.depthStencil.depth = 1.f;
+    auto& forward =
+        graph.add_graphics_pass("forward")
+            .write_color(_rg_swapchain, clear)
+            .write_depth(_rg_depth, depth_clear)
+            .read_storage(_rg_point_raster,
+                          VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+            .read_indirect(_rg_draws)
+            .record_secondary()
+            .execute(
+                [this](VkCommandBuffer cmd) { record_forward(cmd, false); });
+    if (_live) {
+        forward.read_vertices(_rg_live);
+    }
+    if (_dynamic_points) {
+        forward.read_vertices(_rg_dynamic);
+    }
+
+    graph.add_compute_pass("depth pyramid")
+        .read_sampled(_rg_depth, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+        .write_storage(_rg_pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+        .enable_if(culling)
+        .execute([this](VkCommandBuffer cmd) { build_depth_pyramid(cmd); });
+
+    graph.add_compute_pass("cull late")
+        .read_storage(_rg_pyramid, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+        .write_storage(_rg_visibility, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+        .write_storage(_rg_draws, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT)
+        .enable_if(culling)
+        .execute([this](VkCommandBuffer cmd) { cull_objects(cmd, true); });
+
+    // same attachments as "forward", so its pipelines work here too
+    graph.add_graphics_pass("forward late")
+        .write_color(_rg_swapchain)
+        .write_depth(_rg_depth)
+        .read_indirect(_rg_draws)
+        .record_secondary()
+        .enable_if(culling)
+        .execute([this](VkCommandBuffer cmd) { record_forward(cmd, true); });
+
+    // secondary command buffers for both, see record_forward()
+    _slot_cmds.resize(_frames.size());
+    for (size_t i = 0; i < _frames.size(); ++i) {
+        VkCommandBuffer cmds[4];
+        auto cmd_info = vkinit::command_buffer_allocate_info(
+            _frames[i].command_pool, 4, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        VK_CHECK(vkAllocateCommandBuffers(_device, &cmd_info, cmds));
+        for (int b = 0; b < 3; ++b) {
+            _slot_cmds[i].batches[b].cmd = cmds[b];
+        }
+        _slot_cmds[i].dynamic = cmds[3];
+    }
+}
+
+void HelloEngine::begin_secondary(VkCommandBuffer cmd,
+                                  char const* pass,
+                                  VkCommandBufferUsageFlags flags) {
+    VkCommandBufferInheritanceInfo inheritance = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = nullptr,
+        .renderPass = _graph.get_render_pass(pass),
+        .subpass = 0,
+        // any framebuffer, so one recording serves all swapchain images
+        .framebuffer = VK_NULL_HANDLE,
+    };
+    auto begin_info = vkinit::command_buffer_begin_info(
+        flags | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+    begin_info.pInheritanceInfo = &inheritance;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+}
+
+void HelloEngine::record_forward(VkCommandBuffer cmd, bool late) {
+    auto& slot = _slot_cmds[get_current_frame_index()];
+    char const* pass = late ? "forward late" : "forward";
+    VkCommandBuffer cmds[2];
+    uint32_t count = 0;
+
+    // Culled draws read their counts from _draws_buf, meshes without LODs
+    // are drawn the same every frame, and both push this slot's buffer
+    // slots.  So they only change with the batches or mesh buffers, or when
+    // the graph's render passes are redone.  The slot's last submission is
+    // done, see Engine::draw().
+    if (_occlusion_culling || !late) {
+        auto& cached = slot.batches[_occlusion_culling ? late : 2];
+        if (!_reuse_commands || cached.version != _scene_version ||
+            cached.generation != _graph.generation() ||
+            cached.batches != _batches) {
+            begin_secondary(cached.cmd, pass, 0);
+            bind_frame(cached.cmd);
+            if (_occlusion_culling) {
+                draw_batches(cached.cmd, late);
+            } else {
+                VkBuffer bound = _geometry_buf.buf;
+                draw_meshes(cached.cmd, false, bound);
+            }
+            VK_CHECK(vkEndCommandBuffer(cached.cmd));
+            cached.version = _scene_version;
+            cached.generation = _graph.generation();
+            cached.batches = _batches;
+        }
+        cmds[count++] = cached.cmd;
+    }
+
+    // mesh LODs and points change every frame
+    if (!late) {
+        begin_secondary(
+            slot.dynamic, pass, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        render_pass(slot.dynamic);
+        VK_CHECK(vkEndCommandBuffer(slot.dynamic));
+        cmds[count++] = slot.dynamic;
+    }
+
+    if (count > 0) {
+        vkCmdExecuteCommands(cmd, count, cmds);
+    }
+}
+
+void HelloEngine::on_key(int key) {
+    if (key == GLFW_KEY_R) {
+        set_point_renderer(_point_renderer == PointRenderer::Fixed
+                               ? PointRenderer::Compute
+                               : PointRenderer::Fixed);
+        return;
+    }
+    if (key == GLFW_KEY_O) {
+        set_occlusion_culling(!_occlusion_culling);
+        return;
+    }
+    if (key == GLFW_KEY_M) {
+        print_geometry_stats();  // and the default's memory statistics
     }
+    if (key == GLFW_KEY_G) {
+        post_update([this] { _spin_grid = !_spin_grid; });
+        return;
+    }
+    if (key == GLFW_KEY_C) {
+        _reuse_commands = !_reuse_commands;
+        std::cout << (_reuse_commands ? "Reusing" : "Re-recording")
+                  << " mesh draw commands.\n";
+        return;
+    }
+    Engine::on_key(key);
+}
+
+void HelloEngine::set_point_renderer(PointRenderer renderer) {
+    if (renderer == PointRenderer::Compute && !_has_int64_atomics) {
+        std::cerr << "The compute point renderer needs 64-bit atomics.\n";
+        return;
+    }
+    _point_renderer = renderer;
+    std::cout << "Drawing points "
+              << (renderer == PointRenderer::Compute ? "in a compute shader"
+                                                     : "as POINT_LIST")
+              << ".\n";
+}
+
+void HelloEngine::set_occlusion_culling(bool enabled) {
+    if (enabled && !_has_multi_draw_indirect) {
+        std::cerr << "Occlusion culling needs indirect multi-draws.\n";
+        return;
+    }
+    _occlusion_culling = enabled;
+    std::cout << "Occlusion culling " << (enabled ? "on" : "off") << ".\n";
+}
+
+bool HelloEngine::upload_mesh(Mesh& mesh) {
+    if (!create_mesh_bufs(mesh)) {
+        return false;
+    }
+    copy_to_staging(mesh);
+    // by reference, so the vertices aren't copied too
+    immediate_submit([&](auto cmd) { record_mesh_copy(cmd, mesh); });
+
+    // immediate_submit() waited for the copy, so the staging buffer can
+    // go right away.  Dynamic meshes are re-uploaded by upload_dirty().
+    destroy_buffer(_allocator, *mesh.staging_buf);
+    mesh.staging_buf.reset();
+    if (!mesh.dynamic) {
+        track_residency(mesh);
+    }
+    return true;
+}
+
+Task<bool> HelloEngine::upload_mesh_async(Mesh& mesh) {
+    co_await on_main();  // allocations are tracked on the main thread
+    if (!create_mesh_bufs(mesh)) {
+        co_return false;
+    }
+    co_await background();
+    copy_to_staging(mesh);
+    co_await upload([&](VkCommandBuffer cmd) { record_mesh_copy(cmd, mesh); });
+    destroy_buffer(_allocator, *mesh.staging_buf);
+    mesh.staging_buf.reset();
+    co_return true;
+}
+
+void HelloEngine::track_residency(Mesh& mesh) {
+    if (_drop_cpu_copies) {
+        // can't be re-uploaded anymore, so it stays resident
+        mesh.verts = {};
+    } else {
+        _residency.track(&mesh, _frame_number);
+    }
+}
+
+bool HelloEngine::create_mesh_bufs(Mesh& mesh) {
+    const size_t buf_size = mesh.verts.size() * sizeof(Vert);
+    mesh.compute_bounds();
+    ++_scene_version;  // recorded draws may have it elsewhere
+
+    // staging buffer, until the upload is done
+    VkBufferCreateInfo staging_buf_info = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .size = buf_size,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    };
 
-    // copy vertex data to staging buffer
+    VmaAllocationCreateInfo staging_alloc_info = {
+        .usage = VMA_MEMORY_USAGE_CPU_ONLY,
+    };
+
+    mesh.staging_buf = std::make_shared<AllocatedBuffer>();
+
+    VK_CHECK(vmaCreateBuffer(_allocator,
+                             &staging_buf_info,
+                             &staging_alloc_info,
+                             &mesh.staging_buf->buf,
+                             &mesh.staging_buf->alloc,
+                             nullptr));
+    _mem_stats.track(_allocator,
+                     mesh.staging_buf->alloc,
+                     MemCategory::Staging,
+                     "mesh staging");
+
+    // Most meshes go into the arena, evicting others if it's full.  A
+    // few large ones would crowd out everything else, so they get their
+    // own buffer.
+    uint32_t count = mesh.verts.size();
+    if (buf_size <= _geometry_bytes / 4) {
+        std::optional<uint32_t> first;
+        while (!(first = _geometry.allocate(count)) && evict_lru_mesh(true)) {
+        }
+        if (!first) {
+            std::cerr << "Can't upload mesh (" << buf_size / 1e6
+                      << "MB): geometry arena full\n";
+            destroy_buffer(_allocator, *mesh.staging_buf);
+            mesh.staging_buf.reset();
+            return false;
+        }
+        mesh.buf = _geometry_buf.buf;
+        mesh.first_vert = *first;
+        mesh.vert_count = count;
+        return true;
+    }
+
+    // create and allocate vertex buffer on gpu
+    VkBufferCreateInfo vertex_buf_info{staging_buf_info};
+    // storage too, for the compute point rasterizer
+    vertex_buf_info.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                            VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    VmaAllocationCreateInfo vertex_alloc_info = {
+        // fail instead of oversubscribing, so we can evict and retry
+        .flags = VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT,
+        .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+    };
+    auto own_buf = std::make_shared<AllocatedBuffer>();
+    VkResult res;
+    do {
+        res = vmaCreateBuffer(_allocator,
+                              &vertex_buf_info,
+                              &vertex_alloc_info,
+                              &own_buf->buf,
+                              &own_buf->alloc,
+                              nullptr);
+    } while (res == VK_ERROR_OUT_OF_DEVICE_MEMORY && evict_lru_mesh(false));
+
+    if (res != VK_SUCCESS) {
+        std::cerr << "Can't upload mesh (" << buf_size / 1e6
+                  << "MB): " << string_VkResult(res) << "\n";
+        destroy_buffer(_allocator, *mesh.staging_buf);
+        mesh.staging_buf.reset();
+        return false;
+    }
+    _mem_stats.track(
+        _allocator, own_buf->alloc, MemCategory::Vertex, "mesh vertices");
+    mesh.own_buf = own_buf;
+    mesh.buf = own_buf->buf;
+    mesh.first_vert = 0;
+    mesh.vert_count = count;
+    return true;
+}
+
+void HelloEngine::copy_to_staging(Mesh& mesh) {
     void* data;
     vmaMapMemory(_allocator, mesh.staging_buf->alloc, &data);
     memcpy(data, mesh.verts.data(), mesh.verts.size() * sizeof(Vert));
     vmaUnmapMemory(_allocator, mesh.staging_buf->alloc);
+}
+
+void HelloEngine::record_mesh_copy(VkCommandBuffer cmd, Mesh& mesh) {
+    VkBufferCopy copy = {
+        .srcOffset = 0,
+        .dstOffset = mesh.first_vert * sizeof(Vert),
+        .size = mesh.verts.size() * sizeof(Vert),
+    };
+
+    assert(nullptr != mesh.staging_buf->buf);
+    assert(nullptr != mesh.buf);
+
+    vkCmdCopyBuffer(cmd,
+                    mesh.staging_buf->buf,  // src
+                    mesh.buf,               // dst
+                    1,                      // region count
+                    &copy);
+}
+
+Task<bool> HelloEngine::import_point_cloud(std::string path, Mesh& mesh) {
+    auto start = std::chrono::steady_clock::now();
+    co_await background();
+    PointFile file{_jobs};
+    if (!file.open(path) || file.count() == 0) {
+        co_await on_main();
+        co_return false;
+    }
 
-    // copy to GPU
-    immediate_submit([=](auto cmd) {
+    // Converted into one staging buffer, then thinned out into the other
+    // and sorted back, or just sorted into the other.  No copy on the heap,
+    // and the CPU reads both, so they're host cached.
+    co_await on_main();
+    VkDeviceSize capacity = file.count() * sizeof(Vert);
+    AllocatedBuffer staging[2];
+    for (auto& s : staging) {
+        s = create_buffer(capacity,
+                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                          VMA_MEMORY_USAGE_GPU_TO_CPU,
+                          MemCategory::Staging,
+                          "import staging");
+    }
+    co_await background();
+    Vert* data[2];
+    for (int i = 0; i < 2; ++i) {
+        VK_CHECK(vmaMapMemory(_allocator, staging[i].alloc, (void**)&data[i]));
+    }
+    auto result = file.convert(data[0]);
+    file.close();
+    uint32_t count = result.count;
+    if (count == 0) {
+        // no line parsed
+        for (auto& s : staging) {
+            vmaUnmapMemory(_allocator, s.alloc);
+        }
+        co_await on_main();
+        for (auto& s : staging) {
+            destroy_buffer(_allocator, s);
+        }
+        co_return false;
+    }
+    auto converted = std::chrono::steady_clock::now();
+    int from = 0;
+    if (_voxel_size > 0.f) {
+        count = downsample_points(data[0], count, data[1]);
+        from = 1;
+    }
+    auto filtered = std::chrono::steady_clock::now();
+    auto chunks = sort_points_morton(data[from], data[1 - from], count, _jobs);
+    int sorted_to = 1 - from;
+    for (auto& s : staging) {
+        vmaUnmapMemory(_allocator, s.alloc);
+    }
+    auto sorted = std::chrono::steady_clock::now();
+    co_await on_main();
+    destroy_buffer(_allocator, staging[from]);  // the scratch one
+
+    VkDeviceSize bytes = count * sizeof(Vert);
+    auto buf = create_buffer(bytes,
+                             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VMA_MEMORY_USAGE_GPU_ONLY,
+                             MemCategory::Vertex,
+                             "imported points");
+    co_await upload([&](VkCommandBuffer cmd) {
         VkBufferCopy copy = {
             .srcOffset = 0,
             .dstOffset = 0,
-            .size = buf_size,
+            .size = bytes,
         };
+        vkCmdCopyBuffer(cmd, staging[sorted_to].buf, buf.buf, 1, &copy);
+    });
+    destroy_buffer(_allocator, staging[sorted_to]);
+
+    // its own buffer, imports can be larger than the whole arena
+    mesh = Mesh{};
+    mesh.own_buf = std::make_shared<AllocatedBuffer>(buf);
+    mesh.buf = buf.buf;
+    mesh.vert_count = count;
+    mesh.chunks = std::move(chunks);
+
+    // scale into the camera's view, centered where it looks
+    glm::vec3 center = (result.min + result.max) / 2.f;
+    glm::vec3 extent = result.max - result.min;
+    float size = std::max({extent.x, extent.y, extent.z, 1e-6f});
+    mesh.bounds = glm::vec4(center, glm::length(extent) / 2.f);
+    _point_cloud_transform = {
+        .translation = glm::vec3{0, 4, 0} - center * (8.f / size),
+        .scale = glm::vec3{8.f / size},
+    };
 
-        assert(nullptr != mesh.staging_buf->buf);
-        assert(nullptr != mesh.buf->buf);
+    auto ms = [](auto d) {
+        return std::chrono::duration<double, std::milli>(d).count();
+    };
+    auto done = std::chrono::steady_clock::now();
+    std::cout << "Imported " << count / 1e6 << "M points from '" << path
+              << "' in " << ms(done - start) << " ms ("
+              << ms(converted - start) << " ms converting, "
+              << ms(filtered - converted) << " ms filtering, "
+              << ms(sorted - filtered) << " ms sorting).\n";
+    co_return true;
+}
 
-        vkCmdCopyBuffer(cmd,
-                        mesh.staging_buf->buf,  // src
-                        mesh.buf->buf,          // dst
-                        1,                      // region count
-                        &copy);
+bool HelloEngine::make_resident(Mesh& mesh) {
+    if (mesh.buf) {
+        return true;
+    }
+    if (mesh.verts.empty()) {
+        return false;  // evicted without a CPU copy, shouldn't happen
+    }
+    return upload_mesh(mesh);
+}
+
+uint64_t HelloEngine::idle_frames_before() const {
+    // frames up to _frame_number - _frames.size() are done on the GPU,
+    // see Engine::draw()
+    if ((size_t)_frame_number + 1 > _frames.size()) {
+        return _frame_number + 1 - _frames.size();
+    }
+    return 0;
+}
+
+bool HelloEngine::evict_lru_mesh(bool in_arena) {
+    Mesh* mesh = _residency.eviction_candidate(
+        idle_frames_before(),
+        [&](Mesh const& m) { return (m.own_buf == nullptr) == in_arena; });
+    if (mesh == nullptr) {
+        return false;
+    }
+    _residency.untrack(mesh);
+    ++_scene_version;  // recorded draws may use it
+
+    // not in use by any frame in flight, so free it right away
+    if (mesh->own_buf) {
+        destroy_buffer(_allocator, *mesh->own_buf);
+        mesh->own_buf.reset();
+    } else {
+        _geometry.free(mesh->first_vert, mesh->vert_count);
+    }
+    mesh->buf = VK_NULL_HANDLE;
+    return true;
+}
+
+void HelloEngine::destroy_mesh(Mesh& mesh) {
+    _residency.untrack(&mesh);
+    ++_scene_version;  // recorded draws may use it
+    if (mesh.own_buf) {
+        destroy_later(*mesh.own_buf);
+        mesh.own_buf.reset();
+    } else if (mesh.buf) {
+        _geometry.free_after(mesh.first_vert, mesh.vert_count, _frame_number);
+    }
+    mesh.buf = VK_NULL_HANDLE;
+    if (mesh.staging_buf) {
+        destroy_later(*mesh.staging_buf);
+        mesh.staging_buf.reset();
+    }
+}
+
+void HelloEngine::unload_meshes() {
+    for (auto& [name, mesh] : _meshes) {
+        destroy_mesh(mesh);
+    }
+    for (auto& [c, chunk] : _stream_resident) {
+        destroy_later(chunk.buf);
+    }
+    _stream_resident.clear();
+    for (auto& staging : _dirty_staging) {
+        if (staging.buf.buf != VK_NULL_HANDLE) {
+            destroy_later(staging.buf);
+        }
+    }
+    _stream.close();  // the GPU is idle, see Engine::cleanup()
+    _ingest.close();
+}
+
+void HelloEngine::init_geometry() {
+    _geometry_buf = create_buffer(_geometry_bytes,
+                                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                      VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                      VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VMA_MEMORY_USAGE_GPU_ONLY,
+                                  MemCategory::Vertex,
+                                  "geometry arena");
+    ENQUEUE_DELETE(_geometry_buf);
+    _geometry.init(_geometry_bytes / sizeof(Vert));
+    std::cout << "Geometry arena: " << _geometry_bytes / 1e6 << " MB, "
+              << _geometry.capacity() / 1e6 << "M vertices.\n";
+}
+
+void HelloEngine::compact_geometry() {
+    // Move the highest meshes down into free ranges, so the used part of
+    // the arena shrinks and its free space stays in one piece.  Ranges
+    // only become free once no frame in flight uses them, so nothing the
+    // GPU is reading gets overwritten.
+    std::vector<Mesh*> in_arena;
+    for (auto& [name, mesh] : _meshes) {
+        if (mesh.buf && !mesh.own_buf) {
+            in_arena.push_back(&mesh);
+        }
+    }
+    std::sort(in_arena.begin(), in_arena.end(), [](Mesh* a, Mesh* b) {
+        return a->first_vert > b->first_vert;
     });
 
-    if (create_bufs) {
-        // cleanup: staging buffer can be destroyed immedeately
-        ENQUEUE_DELETE(vmaDestroyBuffer(
-            _allocator, mesh.staging_buf->buf, mesh.staging_buf->alloc));
-        ENQUEUE_DELETE(
-            vmaDestroyBuffer(_allocator, mesh.buf->buf, mesh.buf->alloc));
+    std::vector<VkBufferCopy> copies;
+    std::vector<std::pair<Mesh*, uint32_t>> moves;
+    VkDeviceSize budget = _defrag_bytes_per_frame;
+    for (auto* mesh : in_arena) {
+        VkDeviceSize bytes = mesh->vert_count * sizeof(Vert);
+        if (bytes > budget) {
+            continue;
+        }
+        auto to = _geometry.allocate_below(mesh->first_vert, mesh->vert_count);
+        if (!to) {
+            continue;
+        }
+        copies.push_back({
+            .srcOffset = mesh->first_vert * sizeof(Vert),
+            .dstOffset = *to * sizeof(Vert),
+            .size = bytes,
+        });
+        moves.push_back({mesh, *to});
+        budget -= bytes;
+    }
+    if (copies.empty()) {
+        return;
+    }
+
+    // free ranges and the meshes' current ones never overlap
+    immediate_submit([&](VkCommandBuffer cmd) {
+        vkCmdCopyBuffer(cmd,
+                        _geometry_buf.buf,
+                        _geometry_buf.buf,
+                        copies.size(),
+                        copies.data());
+    });
+    for (auto [mesh, to] : moves) {
+        _geometry.free_after(mesh->first_vert, mesh->vert_count, _frame_number);
+        mesh->first_vert = to;
     }
+    ++_scene_version;  // recorded draws have the old first vertices
 }
 
-void HelloEngine::upload_mesh_old(Mesh& mesh) {
-    auto buf_info = vkinit::buffer_create_info(
-        mesh.verts.size() * sizeof(Vert), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+void HelloEngine::print_geometry_stats() const {
+    std::cout << "Geometry arena: " << _geometry.used() / 1e6 << "M of "
+              << _geometry.capacity() / 1e6 << "M vertices used, "
+              << _geometry.free_ranges() << " free range(s), high water "
+              << _geometry.high_water() / 1e6 << "M.\n";
+    if (_dynamic_points) {
+        std::cout << "Dynamic points: " << _dynamic_bytes_uploaded / 1e6
+                  << " MB uploaded last frame.\n";
+    }
+    if (_live) {
+        auto stats = _ingest.stats();
+        std::cout << "Live points: " << stats.packets << " packets, "
+                  << stats.points / 1e6 << "M points received, "
+                  << stats.dropped / 1e6 << "M dropped, "
+                  << (_live_head - _live_tail) / 1e6 << "M shown.\n";
+    }
+}
 
-    VmaAllocationCreateInfo alloc_info = {
-        .usage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+FramePushConstants HelloEngine::frame_constants() {
+    return {
+        .camera_buf = get_current_frame().cam_buf_id,
+        .scene_buf = _scene_data_buf_id,
+        .object_buf = get_current_frame().obj_buf_id,
+        .frame_idx = get_current_frame_index(),
     };
+}
 
-    // allocate
-    VK_CHECK(vmaCreateBuffer(_allocator,
-                             &buf_info,
-                             &alloc_info,
-                             &mesh.buf->buf,
-                             &mesh.buf->alloc,
-                             nullptr));
-    ENQUEUE_DELETE(
-        vmaDestroyBuffer(_allocator, mesh.buf->buf, mesh.buf->alloc));
+void HelloEngine::bind_frame(VkCommandBuffer cmd) {
+    // Bound once per pass, all pipelines share the layout
+    FramePushConstants frame_ids = frame_constants();
+    VkDescriptorSet set = _bindless.set();
+    vkCmdBindDescriptorSets(cmd,
+                            VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            _pipeline_layout,
+                            0,  // first set
+                            1,  // descriptor set count
+                            &set,
+                            0,  // dynamic offsets
+                            nullptr);
+    vkCmdPushConstants(cmd,
+                       _pipeline_layout,
+                       VK_SHADER_STAGE_ALL,
+                       0,
+                       sizeof(FramePushConstants),
+                       &frame_ids);
+
+    // every mesh in the arena, drawn by firstVertex
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(cmd, 0, 1, &_geometry_buf.buf, &offset);
+}
 
-    // upload vertex data
-    void* data;
-    vmaMapMemory(_allocator, mesh.buf->alloc, &data);
-    memcpy(data, mesh.verts.data(), mesh.verts.size() * sizeof(Vert));
-    vmaUnmapMemory(_allocator, mesh.buf->alloc);  // write finished, so unmap
+bool HelloEngine::is_point_cloud(RenderObject const& obj) const {
+    return obj.mat->pipeline == _point_pipeline.pipeline;
 }
 
-void HelloEngine::render_pass(VkCommandBuffer cmd) {
-    update_meshes();
+MeshLod HelloEngine::select_mesh_lod(uint32_t i,
+                                     Trs const& world,
+                                     glm::vec3 cam_pos,
+                                     float px_per_unit) {
+    auto& obj = _scene[i];
+    auto& lods = obj.mesh->lods;
+    if (lods.size() < 2) {
+        return obj.mesh->lod(0);
+    }
+
+    // pixels per unit of error, at the nearest point of the bounds
+    glm::vec3 center = world.apply(glm::vec3(obj.mesh->bounds));
+    float scale = world.max_scale();
+    float dist = glm::length(center - cam_pos) - obj.mesh->bounds.w * scale;
+    float px_per_error = scale * px_per_unit / std::max(dist, 1e-3f);
+    auto error_px = [&](uint32_t l) { return lods[l].error * px_per_error; };
+
+    uint32_t l = std::min<uint32_t>(_object_lods[i], lods.size() - 1);
+    while (l > 0 && error_px(l) > _mesh_lod_error_px) {
+        --l;
+    }
+    float coarser_px = _mesh_lod_error_px * _mesh_lod_hysteresis;
+    while (l + 1 < lods.size() && error_px(l + 1) < coarser_px) {
+        ++l;
+    }
+    _object_lods[i] = l;
+    return lods[l];
+}
+
+void HelloEngine::update(uint64_t tick) {
+    auto& snap = _snapshots.back();
+    snap.tick = tick;
 
     // camera
-    glm::vec3 cam_pos = {
-        0.f, 6.f * (0.95f + cos(_frame_number / 200.0f)), -10.f};
-    auto view = glm::lookAt(cam_pos, glm::vec3{0, 4.f, 0}, glm::vec3{0, 1, 0});
+    snap.cam_pos = {0.f, 6.f * (0.95f + cos(tick / 200.0f)), -10.f};
+    snap.cam_target = {0, 4.f, 0};
+    if (_live) {
+        // circle the scanner, looking down on it
+        float angle = tick / 400.0f;
+        snap.cam_pos = {24.f * cos(angle), 14.f, 24.f * sin(angle)};
+        snap.cam_target = {0.f, 1.f, 0.f};
+    }
+    if (_streaming) {
+        // fly through the streamed cloud along z, over and over
+        auto& h = _stream.header();
+        glm::vec3 center = (h.min + h.max) / 2.f;
+        float length = h.max.z - h.min.z;
+        snap.cam_pos = {center.x,
+                        glm::mix(h.min.y, h.max.y, 0.25f),
+                        h.min.z + fmod(tick * _stream_fly_speed, length)};
+        snap.cam_target = snap.cam_pos + glm::vec3{0, 0, 1};
+    }
+
+    // objects' world matrices, recomputed only where they moved
+    if (_spin_grid && _grid_root != TransformTree::NONE) {
+        _sim_tree.set_local(_grid_root, {
+            .rotation = glm::angleAxis(tick / 800.f, glm::vec3{0, 1, 0}),
+        });
+    }
+    _sim_tree.update(_jobs);
+    snap.transforms.resize(_scene.size());  // keeps its capacity
+    for (size_t i = 0; i < _scene.size(); ++i) {
+        snap.transforms[i] = _sim_tree.world(_scene[i].node);
+    }
+    _snapshots.publish();
+}
+
+void HelloEngine::prepare_frame() {
+    _geometry.reclaim(idle_frames_before());
+    compact_geometry();
+    update_meshes();
+
+    // the latest state of the simulation, see update()
+    auto& snap = _snapshots.acquire();
+    glm::vec3 cam_pos = snap.cam_pos;
+    auto view = glm::lookAt(cam_pos, snap.cam_target, glm::vec3{0, 1, 0});
     float aspect = (float)_window_extent.width / (float)_window_extent.height;
-    glm::mat4 proj = glm::perspective(glm::radians(70.f), aspect, 0.1f, 200.f);
+    float fov = glm::radians(70.f);
+    glm::mat4 proj = glm::perspective(fov, aspect, 0.1f, 200.f);
     proj[1][1] *= -1;
     GPUCameraData cam_data = {
         .view = view,
@@ -476,103 +1392,773 @@ void HelloEngine::render_pass(VkCommandBuffer cmd) {
     // copy scene metadata
     char* p_scene_data;
     vmaMapMemory(_allocator, _scene_data_buf.alloc, (void**)&p_scene_data);
-    p_scene_data += pad_uniform_buf_size(sizeof(GPUSceneData)) *
-                    (_frame_number % FRAME_OVERLAP);
+    p_scene_data += sizeof(GPUSceneData) * get_current_frame_index();
     memcpy(p_scene_data, &_scene_data, sizeof(GPUSceneData));
     vmaUnmapMemory(_allocator, _scene_data_buf.alloc);
 
-    // object data
+    // under memory pressure, free meshes nobody has drawn in a while.  Only
+    // those with their own buffer, the arena's memory stays allocated.
+    while (over_memory_budget() && evict_lru_mesh(false)) {
+        update_memory_budget();
+    }
+    // Only meshes with an object in view are uploaded and count as drawn.
+    // The others are left out of the draws below, so once idle they can be
+    // evicted.  Before the object data, which has the meshes' place in the
+    // arena.
+    Frustum view_frustum{cam_data.viewproj};
+    std::unordered_set<Mesh*> drawn;
+    for (uint32_t i = 0; i < _scene.size(); ++i) {
+        auto& obj = _scene[i];
+        if (drawn.count(obj.mesh)) {
+            continue;
+        }
+        auto& world = snap.transforms[i];
+        glm::vec3 center = world.apply(glm::vec3(obj.mesh->bounds));
+        float radius = obj.mesh->bounds.w * world.max_scale();
+        if (!view_frustum.intersects_sphere(center, radius)) {
+            continue;
+        }
+        if (make_resident(*obj.mesh)) {
+            _residency.touch(obj.mesh, _frame_number);
+            drawn.insert(obj.mesh);
+        }
+    }
+
+    // object transforms, with the LOD each mesh is drawn at
+    float px_per_unit = _window_extent.height / (2.f * tan(fov / 2.f));
+    _object_lods.resize(_scene.size(), 0);
+    std::atomic<uint64_t> mesh_verts{0};
+    std::atomic<bool> lods_changed{false};
     void* p_obj_data;
     vmaMapMemory(_allocator, get_current_frame().obj_buf.alloc, &p_obj_data);
     GPUObjectData* objectSSBO = (GPUObjectData*)p_obj_data;
-    for (int i = 0; i < _scene.size(); ++i) {
-        auto obj = _scene[i];
-        objectSSBO[i].model_mat = obj.transform;
+    _jobs.parallel_for(_scene.size(), 256, [&](size_t begin, size_t end) {
+        uint64_t verts = 0;
+        bool changed = false;
+        for (size_t i = begin; i < end; ++i) {
+            auto& obj = _scene[i];
+            auto& world = snap.transforms[i];
+            uint32_t was = _object_lods[i];
+            MeshLod lod = select_mesh_lod(i, world, cam_pos, px_per_unit);
+            changed |= _object_lods[i] != was;
+            if (!is_point_cloud(obj) && drawn.count(obj.mesh)) {
+                verts += lod.count;
+            }
+            glm::quat q = world.rotation;
+            objectSSBO[i] = {
+                .position_scale = glm::vec4(world.translation,
+                                            world.max_scale()),
+                .rotation = {q.x, q.y, q.z, q.w},
+            };
+        }
+        mesh_verts += verts;
+        if (changed) {
+            lods_changed = true;
+        }
+    });
+    _mesh_verts_drawn = mesh_verts;
+    if (lods_changed) {
+        ++_lod_version;
     }
+    // streamed chunks are in world space
+    objectSSBO[_scene.size()] = {
+        .position_scale = {0.f, 0.f, 0.f, 1.f},
+        .rotation = {0.f, 0.f, 0.f, 1.f},
+    };
     vmaUnmapMemory(_allocator, get_current_frame().obj_buf.alloc);
 
-    Mesh* last_mesh = nullptr;
-    Material* last_mat = nullptr;
-    int i = 0;
-    for (auto obj : _scene) {
-        if (obj.mat != last_mat) {
-            last_mat = obj.mat;
-            uint32_t scene_buf_offset =
-                pad_uniform_buf_size(sizeof(GPUSceneData)) *
-                (_frame_number % FRAME_OVERLAP);
+    // The rest of the object data only changes with the meshes, their LODs
+    // or culling, so this frame slot's copy is mostly still good
+    ObjectInfoKey info_key = {
+        .scene = _scene_version,
+        .lods = _lod_version,
+        .culling = _occlusion_culling,
+    };
+    auto& written = _object_info_keys[get_current_frame_index()];
+    if (written != info_key) {
+        void* p_info;
+        vmaMapMemory(_allocator, get_current_frame().info_buf.alloc, &p_info);
+        GPUObjectInfo* info = (GPUObjectInfo*)p_info;
+        for (uint32_t i = 0; i < _scene.size(); ++i) {
+            auto& obj = _scene[i];
+            MeshLod lod = obj.mesh->lod(_object_lods[i]);
+            uint32_t flags = 0;
+            if (_occlusion_culling && !is_point_cloud(obj)) {
+                flags |= OBJECT_CULLED;
+            }
+            info[i] = {
+                .ids = {obj.mat->texture,
+                        lod.count,
+                        flags,
+                        obj.mesh->first_vert + lod.first},
+                .bounds = obj.mesh->bounds,
+            };
+        }
+        info[_scene.size()] = {.ids = {BINDLESS_NONE, 0, 0, 0}};
+        vmaUnmapMemory(_allocator, get_current_frame().info_buf.alloc);
+        written = info_key;
+    }
+
+    // Point ranges to draw, the same for either renderer.  For point cloud
+    // LOD, see PointOctree::select().
+    _lod_points_drawn = 0;
+    _point_draws.clear();
+    _batches.clear();
+    for (uint32_t i = 0; i < _scene.size(); ++i) {
+        auto& obj = _scene[i];
+        if (!drawn.count(obj.mesh)) {
+            continue;  // out of view, or no memory for it
+        }
+        if (!is_point_cloud(obj)) {
+            // one indirect multi-draw per run of objects, see draw_batches().
+            // Meshes in the same buffer share one, the commands have their
+            // first vertex.
+            auto* batch = _batches.empty() ? nullptr : &_batches.back();
+            if (batch && batch->mat == obj.mat &&
+                batch->mesh->buf == obj.mesh->buf &&
+                batch->first + batch->count == i) {
+                ++batch->count;
+            } else {
+                _batches.push_back({obj.mat, obj.mesh, i, 1});
+            }
+            continue;
+        }
+        if (!obj.mesh->octree && obj.mesh->chunks.empty()) {
+            _point_draws.push_back({
+                .buf = obj.mesh->buf,
+                .range = {obj.mesh->first_vert,
+                          (uint32_t)obj.mesh->vert_count},
+                .object = i,
+            });
+            continue;
+        }
+        if (!obj.mesh->octree) {
+            // Morton sorted, so chunks in view are few runs of vertices
+            Frustum frustum{cam_data.viewproj * snap.transforms[i].matrix()};
+            for (auto& chunk : obj.mesh->chunks) {
+                if (!frustum.intersects_box(chunk.min, chunk.max)) {
+                    continue;
+                }
+                uint32_t first = obj.mesh->first_vert + chunk.first;
+                auto* last = _point_draws.empty() ? nullptr
+                                                  : &_point_draws.back();
+                if (last && last->object == i &&
+                    last->range.first + last->range.count == first) {
+                    last->range.count += chunk.count;
+                } else {
+                    _point_draws.push_back({
+                        .buf = obj.mesh->buf,
+                        .range = {first, chunk.count},
+                        .object = i,
+                    });
+                }
+            }
+            continue;
+        }
+        // select in model space, the budget is shared by all objects
+        glm::mat4 model = snap.transforms[i].matrix();
+        glm::vec3 local_cam = glm::inverse(model) * glm::vec4(cam_pos, 1.f);
+        _lod_ranges.clear();
+        _lod_points_drawn +=
+            obj.mesh->octree->select(cam_data.viewproj * model,
+                                     local_cam,
+                                     px_per_unit,
+                                     _lod_max_spacing_px,
+                                     _point_budget - _lod_points_drawn,
+                                     _lod_ranges);
+        for (auto& range : _lod_ranges) {
+            _point_draws.push_back({
+                .buf = obj.mesh->buf,
+                .range = {obj.mesh->first_vert + range.first, range.count},
+                .object = i,
+            });
+        }
+    }
 
+    if (_streaming) {
+        update_stream(cam_data.viewproj, cam_pos);
+        for (auto c : _stream_wanted) {
+            auto it = _stream_resident.find(c);
+            if (it == _stream_resident.end()) {
+                continue;  // not loaded yet
+            }
+            _point_draws.push_back({
+                .buf = it->second.buf.buf,
+                .range = {0, it->second.count},
+                .object = (uint32_t)_scene.size(),
+            });
+        }
+    }
+    if (_live) {
+        update_live();
+    }
+}
+
+void HelloEngine::draw_meshes(VkCommandBuffer cmd,
+                              bool lod_chains,
+                              VkBuffer& bound) {
+    // the same objects as culling would draw, resident meshes in view
+    for (auto& batch : _batches) {
+        bool bound_batch = false;
+        for (uint32_t i = batch.first; i < batch.first + batch.count; ++i) {
+            auto& obj = _scene[i];
+            if ((obj.mesh->lods.size() > 1) != lod_chains) {
+                continue;
+            }
+            if (!bound_batch) {
+                bound_batch = true;
+                vkCmdBindPipeline(
+                    cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.mat->pipeline);
+                if (batch.mesh->buf != bound) {
+                    bound = batch.mesh->buf;
+                    VkDeviceSize offset = 0;
+                    vkCmdBindVertexBuffers(cmd,
+                                           0,  // first binding
+                                           1,  // binding count
+                                           &bound,
+                                           &offset);
+                }
+            }
+            auto lod = obj.mesh->lod(_object_lods[i]);
+            vkCmdDraw(cmd, lod.count, 1, obj.mesh->first_vert + lod.first, i);
+        }
+    }
+}
+
+void HelloEngine::render_pass(VkCommandBuffer cmd) {
+    bind_frame(cmd);
+    VkBuffer bound = _geometry_buf.buf;
+
+    // culled meshes, and those without LODs, are drawn from their own,
+    // reused command buffers, see record_forward()
+    if (!_occlusion_culling) {
+        draw_meshes(cmd, true, bound);
+    }
+
+    if (_point_renderer == PointRenderer::Compute) {
+        // rasterized already, see rasterize_points()
+        vkCmdBindPipeline(
+            cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _point_resolve_pipeline);
+        vkCmdDraw(cmd, 3, 1, 0, 0);  // fullscreen triangle
+        return;
+    }
+
+    vkCmdBindPipeline(
+        cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, _point_pipeline.pipeline);
+    for (auto& draw : _point_draws) {
+        if (draw.buf != bound) {
+            bound = draw.buf;
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(cmd, 0, 1, &draw.buf, &offset);
+        }
+        vkCmdDraw(cmd, draw.range.count, 1, draw.range.first, draw.object);
+    }
+}
+
+void HelloEngine::draw_batches(VkCommandBuffer cmd, bool late) {
+    VkDeviceSize base = late ? MAX_OBJECTS * sizeof(VkDrawIndirectCommand) : 0;
+    VkBuffer bound = _geometry_buf.buf;  // see bind_frame()
+    Material* last_mat = nullptr;
+    for (auto& batch : _batches) {
+        if (batch.mat != last_mat) {
+            last_mat = batch.mat;
             vkCmdBindPipeline(
-                cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, obj.mat->pipeline);
-            vkCmdBindDescriptorSets(cmd,
-                                    VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    obj.mat->pipeline_layout,
-                                    0,  // first set
-                                    1,  // descriptor set count
-                                    &get_current_frame().global_descriptor,
-                                    1,  // dynamic offsets
-                                    &scene_buf_offset);
+                cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, batch.mat->pipeline);
+        }
+        if (batch.mesh->buf != bound) {
+            bound = batch.mesh->buf;
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(cmd, 0, 1, &bound, &offset);
+        }
+        // one command per object, culled ones have no instances
+        vkCmdDrawIndirect(cmd,
+                          _draws_buf.buf,
+                          base + batch.first * sizeof(VkDrawIndirectCommand),
+                          batch.count,
+                          sizeof(VkDrawIndirectCommand));
+    }
+}
+
+void HelloEngine::cull_objects(VkCommandBuffer cmd, bool late) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cull_pipeline);
+    VkDescriptorSet set = _bindless.set();
+    vkCmdBindDescriptorSets(cmd,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            _cull_layout,
+                            0,
+                            1,
+                            &set,
+                            0,
+                            nullptr);
+    CullConstants consts = {
+        .frame = frame_constants(),
+        .draws_buf = _draws_buf_id,
+        .visibility_buf = _visibility_buf_id,
+        .pyramid_buf = _pyramid_buf_id,
+        .info_buf = get_current_frame().info_buf_id,
+        .object_count = (uint32_t)_scene.size(),
+        .late = late,
+        .width = _window_extent.width,
+        .height = _window_extent.height,
+        .levels = (uint32_t)_pyramid_levels.size(),
+    };
+    vkCmdPushConstants(cmd,
+                       _cull_layout,
+                       VK_SHADER_STAGE_COMPUTE_BIT,
+                       0,
+                       sizeof(CullConstants),
+                       &consts);
+    const uint32_t group_size = 64;  // local_size_x in cull.comp
+    uint32_t groups = (consts.object_count + group_size - 1) / group_size;
+    vkCmdDispatch(cmd, groups, 1, 1);
+}
+
+void HelloEngine::build_depth_pyramid(VkCommandBuffer cmd) {
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _pyramid_pipeline);
+    VkDescriptorSet set = _bindless.set();
+    vkCmdBindDescriptorSets(cmd,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            _cull_layout,
+                            0,
+                            1,
+                            &set,
+                            0,
+                            nullptr);
+
+    // every level reads the one before, the first reads the depth buffer
+    PyramidConstants consts = {
+        .pyramid_buf = _pyramid_buf_id,
+        .depth_tex = _depth_tex_id,
+        .from_depth = 1,
+        .src_offset = 0,
+        .dst_offset = 0,
+        .src_width = _window_extent.width,
+        .src_height = _window_extent.height,
+    };
+    VkMemoryBarrier level_done = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+    };
+    const uint32_t group_size = 8;  // local_size_x/y in depth_pyramid.comp
+    for (size_t l = 0; l < _pyramid_levels.size(); ++l) {
+        auto level = _pyramid_levels[l];
+        if (l > 0) {
+            vkCmdPipelineBarrier(cmd,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0,
+                                 1,
+                                 &level_done,
+                                 0,
+                                 nullptr,
+                                 0,
+                                 nullptr);
+        }
+        consts.dst_width = level.width;
+        consts.dst_height = level.height;
+        vkCmdPushConstants(cmd,
+                           _cull_layout,
+                           VK_SHADER_STAGE_COMPUTE_BIT,
+                           0,
+                           sizeof(PyramidConstants),
+                           &consts);
+        vkCmdDispatch(cmd,
+                      (level.width + group_size - 1) / group_size,
+                      (level.height + group_size - 1) / group_size,
+                      1);
+
+        consts.from_depth = 0;
+        consts.src_offset = consts.dst_offset;
+        consts.dst_offset += level.width * level.height;
+        consts.src_width = level.width;
+        consts.src_height = level.height;
+    }
+}
+
+void HelloEngine::rasterize_points(VkCommandBuffer cmd) {
+    // all ones is "no point here", farther than any depth
+    vkCmdFillBuffer(cmd, _point_raster_buf.buf, 0, VK_WHOLE_SIZE, ~0u);
+    VkMemoryBarrier cleared = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask =
+            VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(cmd,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0,
+                         1,
+                         &cleared,
+                         0,
+                         nullptr,
+                         0,
+                         nullptr);
+
+    vkCmdBindPipeline(
+        cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _point_raster_pipeline);
+    VkDescriptorSet set = _bindless.set();
+    vkCmdBindDescriptorSets(cmd,
+                            VK_PIPELINE_BIND_POINT_COMPUTE,
+                            _point_raster_layout,
+                            0,
+                            1,
+                            &set,
+                            0,
+                            nullptr);
+
+    PointRasterConstants consts = {
+        .frame = frame_constants(),
+        .raster_buf = _point_raster_buf_id,
+        .width = _window_extent.width,
+        .height = _window_extent.height,
+    };
+    // dispatches are limited to 65535 groups
+    const uint32_t group_size = 256;  // local_size_x in point_raster.comp
+    const uint32_t max_dispatch = 65535 * group_size;
+    VkBuffer bound = VK_NULL_HANDLE;
+    for (auto& draw : _point_draws) {
+        if (draw.buf != bound) {
+            // the vertices, from this frame's descriptor allocator
+            bound = draw.buf;
+            VkDescriptorSet points =
+                get_current_frame().descriptors.allocate(_point_set_layout);
+            VkDescriptorBufferInfo buf_info = {
+                .buffer = draw.buf,
+                .offset = 0,
+                .range = VK_WHOLE_SIZE,
+            };
+            auto write = vkinit::write_descriptor_buffer(
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, points, &buf_info, 0);
+            vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
             vkCmdBindDescriptorSets(cmd,
-                                    VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    obj.mat->pipeline_layout,
-                                    1,  // second set
-                                    1,  // descriptor set count
-                                    &get_current_frame().obj_descriptor,
-                                    0,  // dynamic offsets
+                                    VK_PIPELINE_BIND_POINT_COMPUTE,
+                                    _point_raster_layout,
+                                    1,
+                                    1,
+                                    &points,
+                                    0,
                                     nullptr);
         }
+        consts.object = draw.object;
+        for (uint32_t done = 0; done < draw.range.count;
+             done += max_dispatch) {
+            consts.first = draw.range.first + done;
+            consts.count = std::min(draw.range.count - done, max_dispatch);
+            vkCmdPushConstants(cmd,
+                               _point_raster_layout,
+                               VK_SHADER_STAGE_COMPUTE_BIT,
+                               0,
+                               sizeof(PointRasterConstants),
+                               &consts);
+            uint32_t groups = (consts.count + group_size - 1) / group_size;
+            vkCmdDispatch(cmd, groups, 1, 1);
+        }
+    }
+}
+
+void HelloEngine::open_stream(std::string const& path) {
+    _streaming = _stream.open(path, _allocator, &_mem_stats);
+}
 
-        MeshPushConstants push_constants = {
-            .render_matrix = obj.transform,
+void HelloEngine::update_stream(glm::mat4 const& viewproj, glm::vec3 cam_pos) {
+    auto& chunks = _stream.chunks();
+
+    // visible chunks, nearest first, as many as fit the device budget
+    Frustum frustum{viewproj};
+    std::vector<std::pair<float, uint32_t>> visible;
+    for (uint32_t c = 0; c < chunks.size(); ++c) {
+        auto& chunk = chunks[c];
+        if (chunk.count > 0 && frustum.intersects_cube(chunk.min, chunk.size)) {
+            glm::vec3 center = chunk.min + chunk.size / 2;
+            visible.push_back({glm::length(center - cam_pos), c});
+        }
+    }
+    std::sort(visible.begin(), visible.end());
+    _stream_wanted.clear();
+    std::vector<uint32_t> missing;
+    VkDeviceSize wanted_bytes = 0;
+    for (auto [dist, c] : visible) {
+        VkDeviceSize bytes = chunks[c].count * sizeof(Vert);
+        if (wanted_bytes + bytes > _stream_budget_bytes) {
+            break;
+        }
+        wanted_bytes += bytes;
+        _stream_wanted.push_back(c);
+        auto it = _stream_resident.find(c);
+        if (it == _stream_resident.end()) {
+            missing.push_back(c);
+        } else {
+            it->second.last_used = _frame_number;
+        }
+    }
+    _stream.request(missing);
+
+    // upload what has been paged in, in one submission
+    _stream_ready.clear();
+    _stream.take_ready(_stream_ready);
+    std::vector<std::pair<PointStream::Ready, AllocatedBuffer>> uploads;
+    for (auto& ready : _stream_ready) {
+        bool wanted = std::find(missing.begin(), missing.end(), ready.chunk) !=
+                      missing.end();
+        if (!wanted || uploads.size() == _stream_uploads_per_frame) {
+            _stream.release(ready.slot);  // stays cached on the host
+            continue;
+        }
+        // make room, least recently drawn first
+        while (_stream_resident_bytes + ready.bytes > _stream_budget_bytes &&
+               evict_stream_chunk()) {
+        }
+        if (_stream_resident_bytes + ready.bytes > _stream_budget_bytes) {
+            _stream.release(ready.slot);  // try again once there's room
+            continue;
+        }
+        auto buf = create_buffer(ready.bytes,
+                                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                     VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                 VMA_MEMORY_USAGE_GPU_ONLY,
+                                 MemCategory::Vertex,
+                                 "streamed chunk");
+        uploads.push_back({ready, buf});
+    }
+    if (uploads.empty()) {
+        return;
+    }
+    immediate_submit([&](VkCommandBuffer cmd) {
+        for (auto& [ready, buf] : uploads) {
+            VkBufferCopy copy = {
+                .srcOffset = 0,
+                .dstOffset = 0,
+                .size = ready.bytes,
+            };
+            vkCmdCopyBuffer(cmd, ready.staging.buf, buf.buf, 1, &copy);
+        }
+    });
+    for (auto& [ready, buf] : uploads) {
+        _stream.release(ready.slot);
+        _stream_resident[ready.chunk] = {
+            .buf = buf,
+            .count = chunks[ready.chunk].count,
+            .last_used = (uint64_t)_frame_number,
         };
+        _stream_resident_bytes += ready.bytes;
+    }
+}
 
-        vkCmdPushConstants(cmd,
-                           _mesh_pipeline_layout,
-                           VK_SHADER_STAGE_VERTEX_BIT,
-                           0,
-                           sizeof(MeshPushConstants),
-                           &push_constants);
+bool HelloEngine::evict_stream_chunk() {
+    auto victim = _stream_resident.end();
+    for (auto it = _stream_resident.begin(); it != _stream_resident.end();
+         ++it) {
+        if (it->second.last_used < (uint64_t)_frame_number &&
+            (victim == _stream_resident.end() ||
+             it->second.last_used < victim->second.last_used)) {
+            victim = it;
+        }
+    }
+    if (victim == _stream_resident.end()) {
+        return false;  // everything is in use this frame
+    }
+    destroy_later(victim->second.buf);
+    _stream_resident_bytes -= victim->second.count * sizeof(Vert);
+    _stream_resident.erase(victim);
+    return true;
+}
 
-        if (obj.mesh != last_mesh) {
-            last_mesh = obj.mesh;
-            VkDeviceSize offset = 0;
-            vkCmdBindVertexBuffers(cmd,
-                                   0,  // first binding
-                                   1,  // binding count
-                                   &(obj.mesh->buf->buf),
-                                   &offset);
+void HelloEngine::init_dynamic(RenderGraph& graph) {
+    if (!_import_path.empty()) {
+        _dynamic_points = false;  // nothing to regenerate
+    }
+    if (!_dynamic_points) {
+        return;
+    }
+    _dirty_staging.resize(_frames.size());
+    // The arena or the mesh's own buffer, which isn't known until it's
+    // loaded.  Buffers only get memory barriers, so that's all the same.
+    _rg_dynamic = graph.import_buffer("dynamic points", VK_NULL_HANDLE);
+
+    // recorded into the frame, so re-uploads don't wait for the GPU
+    graph.add_compute_pass("dynamic points")
+        .write_transfer(_rg_dynamic)
+        .execute([this](VkCommandBuffer cmd) {
+            if (!_dirty_copies.empty()) {
+                auto& staging = _dirty_staging[get_current_frame_index()];
+                vkCmdCopyBuffer(cmd,
+                                staging.buf.buf,
+                                _dirty_dst,
+                                _dirty_copies.size(),
+                                _dirty_copies.data());
+            }
+        });
+}
+
+void HelloEngine::init_live(RenderGraph& graph) {
+    // a few frames' worth queued on the host
+    if (_live_path.empty() || !_ingest.open(_live_path, _live_per_frame * 4)) {
+        return;
+    }
+    _live = true;
+    _live_buf = create_buffer(_live_capacity * sizeof(Vert),
+                              VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VMA_MEMORY_USAGE_GPU_ONLY,
+                              MemCategory::Vertex,
+                              "live points");
+    ENQUEUE_DELETE(_live_buf);
+    _live_staging.resize(_frames.size());
+    for (auto& staging : _live_staging) {
+        staging = create_buffer(_live_per_frame * sizeof(Vert),
+                                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                VMA_MEMORY_USAGE_CPU_ONLY,
+                                MemCategory::Staging,
+                                "live points staging");
+        ENQUEUE_DELETE(staging);
+    }
+    _rg_live = graph.import_buffer("live points", _live_buf.buf);
+
+    // this frame's points, recorded ahead of the frame rather than waited
+    // for with immediate_submit()
+    graph.add_compute_pass("live points")
+        .write_transfer(_rg_live)
+        .execute([this](VkCommandBuffer cmd) {
+            if (!_live_copies.empty()) {
+                vkCmdCopyBuffer(cmd,
+                                _live_staging[get_current_frame_index()].buf,
+                                _live_buf.buf,
+                                _live_copies.size(),
+                                _live_copies.data());
+            }
+        });
+}
+
+void HelloEngine::update_live() {
+    // whole batches expire by age
+    auto now = std::chrono::steady_clock::now();
+    auto max_age = std::chrono::duration<float>(_live_max_age);
+    while (!_live_batches.empty() &&
+           now - _live_batches.front().time > max_age) {
+        _live_tail = _live_batches.front().end;
+        _live_batches.pop_front();
+    }
+
+    // straight from the ingest ring into this frame's staging buffer, or
+    // one per voxel of what arrived since the last frame
+    auto& staging = _live_staging[get_current_frame_index()];
+    uint32_t max = std::min(_live_per_frame, _live_capacity);
+    Vert* data;
+    vmaMapMemory(_allocator, staging.alloc, (void**)&data);
+    uint32_t count;
+    if (_voxel_size > 0.f) {
+        _live_unfiltered.resize(max);
+        count = _ingest.take(_live_unfiltered.data(), max);
+        count = voxel_downsample(_live_unfiltered.data(),
+                                 count,
+                                 data,
+                                 _voxel_size,
+                                 _voxel_mode,
+                                 _jobs);
+    } else {
+        count = _ingest.take(data, max);
+    }
+    vmaUnmapMemory(_allocator, staging.alloc);
+
+    _live_copies.clear();
+    if (count > 0) {
+        // the newest overwrite the oldest
+        if (_live_head + count - _live_tail > _live_capacity) {
+            _live_tail = _live_head + count - _live_capacity;
+        }
+        while (!_live_batches.empty() &&
+               _live_batches.front().end <= _live_tail) {
+            _live_batches.pop_front();
         }
+        // copied by the "live points" pass, wrapping around the ring
+        uint32_t at = _live_head % _live_capacity;
+        uint32_t first = std::min(count, _live_capacity - at);
+        _live_copies.push_back({
+            .srcOffset = 0,
+            .dstOffset = at * sizeof(Vert),
+            .size = first * sizeof(Vert),
+        });
+        if (count > first) {
+            _live_copies.push_back({
+                .srcOffset = first * sizeof(Vert),
+                .dstOffset = 0,
+                .size = (count - first) * sizeof(Vert),
+            });
+        }
+        _live_head += count;
+        _live_batches.push_back({.end = _live_head, .time = now});
+    }
 
-        vkCmdDraw(cmd, obj.mesh->verts.size(), 1, 0, i++);
+    // what's left, in one piece or two; in world space like the stream
+    uint32_t begin = _live_tail % _live_capacity;
+    uint32_t live = _live_head - _live_tail;
+    uint32_t first = std::min(live, _live_capacity - begin);
+    PointRange ranges[] = {{begin, first}, {0, live - first}};
+    for (auto range : ranges) {
+        if (range.count > 0) {
+            _point_draws.push_back({
+                .buf = _live_buf.buf,
+                .range = range,
+                .object = (uint32_t)_scene.size(),
+            });
+        }
     }
 }
 
 void HelloEngine::init_scene() {
+    // the update thread takes over _sim_tree after this, see update()
     RenderObject monkey = {
         .mesh = get_mesh("monkey"),
         .mat = get_mat("points"),
-        .transform = glm::mat4{1.0f},
+        .node = _sim_tree.add(_point_cloud_transform),
     };
     _scene.push_back(monkey);
-    return;
 
-    int radius = 40;
-    for (int x = -radius; x <= radius; ++x) {
-        for (int y = -radius; y <= radius; ++y) {
-            if (sqrt(x * x + y * y) > radius) {
-                continue;
+    if (_grid_scene) {
+        // thousands of meshes hiding each other, see cull_objects()
+        _grid_root = _sim_tree.add({});
+        int radius = 40;
+        bool full = false;
+        for (int x = -radius; x <= radius && !full; ++x) {
+            for (int y = -radius; y <= radius; ++y) {
+                if (sqrt(x * x + y * y) > radius) {
+                    continue;
+                }
+                // obj_buf and the cull draw slots end at MAX_OBJECTS,
+                // including the world-space object after the scene, see
+                // prepare_frame()
+                if (_scene.size() + 1 >= MAX_OBJECTS) {
+                    std::cerr << "The grid is cut off at " << MAX_OBJECTS
+                              << " objects.\n";
+                    full = true;
+                    break;
+                }
+                // translate(pos) * scale(0.5) * lookAt(-pos, 0, up), as
+                // parts; the one in the middle has nothing to look along
+                glm::vec3 pos = {x, 0, y};
+                glm::quat look{1.f, 0.f, 0.f, 0.f};
+                if (x != 0 || y != 0) {
+                    look = glm::quat_cast(glm::mat3(glm::lookAt(
+                        -pos, glm::vec3(0.f), glm::vec3{0, 1, 0})));
+                }
+                Trs local = {
+                    .translation = pos + 0.5f * (look * pos),
+                    .rotation = look,
+                    .scale = glm::vec3{0.5f},
+                };
+                RenderObject tri = {
+                    .mesh = get_mesh("grid"),
+                    .mat = get_mat("mesh"),
+                    .node = _sim_tree.add(local, _grid_root),
+                };
+                _scene.push_back(tri);
             }
-            glm::vec3 pos = {x, 0, y};
-            auto translate = glm::translate(glm::mat4{1.0f}, pos);
-            auto scale =
-                glm::scale(glm::mat4{1.0f}, glm::vec3{0.5f, 0.5f, 0.5f});
-            auto transform = translate * scale;
-            auto look = glm::lookAt(-pos, glm::vec3(0.f), glm::vec3{0, 1, 0});
-            RenderObject tri = {
-                .mesh = get_mesh("monkey"),
-                .mat = get_mat("mesh"),
-                .transform = transform * look,
-            };
-            _scene.push_back(tri);
         }
     }
 }
@@ -1,7 +1,22 @@
 #ifndef HELLO_ENGINE_H
 #define HELLO_ENGINE_H
 
+#include <chrono>
+#include <deque>
 #include "engine.h"
+#include "geometry_arena.h"
+#include "mesh_residency.h"
+#include "point_import.h"
+#include "point_ingest.h"
+#include "point_octree.h"
+#include "point_stream.h"
+#include "transform_tree.h"
+#include "triple_buffer.h"
+#include "voxel_filter.h"
+
+#define MAX_BINDLESS_BUFFERS 1024
+#define MAX_BINDLESS_TEXTURES 1024
+#define MAX_OBJECTS 10000  // per frame, including one for streamed chunks
 
 // Rule of thumb:  Only vec4 and mat4
 struct GPUSceneData {
@@ -12,18 +27,110 @@ struct GPUSceneData {
     glm::vec4 sun_color;
 };
 
+// Specialization constants, must match the constant_ids in the shaders
+enum PointSizeMode : int32_t {
+    POINT_SIZE_FALLOFF = 0,  // size * (1 / depth)^2
+    POINT_SIZE_FIXED = 1,
+};
+
+// point.vert
+struct PointSpecConstants {
+    int32_t size_mode;  // constant_id = 0
+    float size;         // constant_id = 1
+};
+
+enum LightingModel : int32_t {
+    LIGHTING_AMBIENT = 0,
+    LIGHTING_UNLIT = 1,
+};
+
+// default_lit.frag, point.frag
+struct LitSpecConstants {
+    VkBool32 fog;            // constant_id = 0
+    int32_t lighting_model;  // constant_id = 1
+};
+
+// point_resolve.frag
+struct PointResolveSpecConstants {
+    VkBool32 fog;            // constant_id = 0
+    int32_t lighting_model;  // constant_id = 1
+    uint32_t raster_buf;     // constant_id = 2, bindless slot
+    uint32_t width;          // constant_id = 3, of the raster buffer
+};
+
+enum class PointRenderer {
+    Fixed,    // POINT_LIST through the rasterizer, see point.vert
+    Compute,  // 64-bit atomics in a compute shader, see point_raster.comp
+};
+
+// point_raster.comp, pushed for every dispatch
+struct PointRasterConstants {
+    FramePushConstants frame;
+    uint32_t raster_buf;  // bindless slot
+    uint32_t object;      // index into the object buffer
+    uint32_t first;       // vertex range
+    uint32_t count;
+    uint32_t width;  // of the raster buffer
+    uint32_t height;
+};
+
+// cull.comp
+struct CullSpecConstants {
+    uint32_t max_objects;  // constant_id = 0, start of the late commands
+};
+
+// cull.comp, pushed for the early and the late pass
+struct CullConstants {
+    FramePushConstants frame;
+    uint32_t draws_buf;  // bindless slots
+    uint32_t visibility_buf;
+    uint32_t pyramid_buf;
+    uint32_t info_buf;
+    uint32_t object_count;
+    uint32_t late;   // 0 for the early pass
+    uint32_t width;  // of the depth buffer
+    uint32_t height;
+    uint32_t levels;  // in the pyramid
+};
+
+// depth_pyramid.comp, pushed for every level
+struct PyramidConstants {
+    uint32_t pyramid_buf;  // bindless slots
+    uint32_t depth_tex;
+    uint32_t from_depth;  // level 0
+    uint32_t src_offset;  // in floats
+    uint32_t dst_offset;
+    uint32_t src_width;
+    uint32_t src_height;
+    uint32_t dst_width;
+    uint32_t dst_height;
+};
+
+/** What the update thread hands to the frames, see HelloEngine::update(). */
+struct SceneSnapshot {
+    uint64_t tick;
+    glm::vec3 cam_pos;
+    glm::vec3 cam_target;
+    std::vector<Trs> transforms;  // world, per object in _scene
+};
+
 class HelloEngine : public Engine {
    public:
     // Scene stuff
     GPUSceneData _scene_data;
-    AllocatedBuffer _scene_data_buf;
+    AllocatedBuffer _scene_data_buf;  // one entry per frame in flight
+    uint32_t _scene_data_buf_id;
 
-    // Descriptor layouts
-    VkDescriptorSetLayout _global_set_layout;
-    VkDescriptorSetLayout _obj_set_layout;
+    // Descriptors, see init_descriptors()
+    BindlessSet _bindless;
+    VkPipelineLayout _pipeline_layout;  // shared by all pipelines
 
     Material _point_pipeline;
 
+    // Shader variants, baked in at pipeline creation
+    PointSpecConstants _point_spec{POINT_SIZE_FALLOFF, 3.f};
+    LitSpecConstants _lit_spec{VK_TRUE, LIGHTING_AMBIENT};
+
     // Shader modules
     VkShaderModule _tri_frag;
     VkShaderModule _tri_vert;
@@ -32,12 +139,185 @@ class HelloEngine : public Engine {
     VkShaderModule _tri_mesh_vert;
 
     // Pipeline stuff
-    VkPipelineLayout _tri_pipeline_layout;
-    VkPipelineLayout _mesh_pipeline_layout;
     VkPipeline _tri_pipeline;
     VkPipeline _tri_rgb_pipeline;
     VkPipeline _mesh_pipeline;
 
+    // Point clouds
+    uint32_t _point_count{1'000'000};
+    // thin out generated, imported and live points to one per voxel of
+    // this size, see downsample_points(); 0 keeps them all
+    float _voxel_size{0.f};
+    VoxelMode _voxel_mode{VoxelMode::Average};
+    bool _dynamic_points{false};  // regenerated as it goes, no LOD
+    float _dynamic_fraction{1.f / 16};  // of the points, per frame
+    VkDeviceSize _dynamic_bytes_uploaded{0};  // last frame
+    // this frame's dirty ranges, see init_dynamic()
+    struct DirtyStaging {
+        AllocatedBuffer buf{};
+        VkDeviceSize bytes{0};
+    };
+    std::vector<DirtyStaging> _dirty_staging;  // one per frame in flight
+    RGResource _rg_dynamic;
+    VkBuffer _dirty_dst{VK_NULL_HANDLE};
+    std::vector<VkBufferCopy> _dirty_copies;
+    uint32_t _point_budget{2'000'000};  // per frame, across all objects
+    float _lod_max_spacing_px{2.f};     // refine until points are this close
+    uint32_t _lod_points_drawn{0};      // last frame
+    std::vector<PointRange> _lod_ranges;
+
+    /** Points drawn this frame, by either renderer. */
+    struct PointDraw {
+        VkBuffer buf;
+        PointRange range;
+        uint32_t object;  // index into the object buffer
+    };
+    std::vector<PointDraw> _point_draws;
+
+    // Software point rasterizer, see rasterize_points().  Toggled with R.
+    PointRenderer _point_renderer{PointRenderer::Fixed};
+    AllocatedBuffer _point_raster_buf;  // depth << 32 | color per pixel
+    uint32_t _point_raster_buf_id;
+    RGResource _rg_point_raster;
+    VkDescriptorSetLayout _point_set_layout;  // set 1: the points
+    VkPipelineLayout _point_raster_layout;
+    VkPipeline _point_raster_pipeline{VK_NULL_HANDLE};
+    VkPipeline _point_resolve_pipeline{VK_NULL_HANDLE};
+
+    // Occlusion culling of meshes against a depth pyramid, see
+    // cull_objects().  Toggled with O.
+    bool _occlusion_culling{true};
+    AllocatedBuffer _draws_buf;  // early, then late VkDrawIndirectCommands
+    AllocatedBuffer _visibility_buf;  // per object, as of last frame
+    AllocatedBuffer _pyramid_buf;     // farthest depth, all levels
+    uint32_t _draws_buf_id;
+    uint32_t _visibility_buf_id;
+    uint32_t _pyramid_buf_id;
+    uint32_t _depth_tex_id;
+    VkSampler _depth_sampler;
+    std::vector<VkExtent2D> _pyramid_levels;  // halving, down to 1x1
+    RGResource _rg_draws;
+    RGResource _rg_visibility;
+    RGResource _rg_pyramid;
+    VkPipelineLayout _cull_layout;  // also for the depth pyramid
+    VkPipeline _cull_pipeline{VK_NULL_HANDLE};
+    VkPipeline _pyramid_pipeline{VK_NULL_HANDLE};
+
+    /** Consecutive mesh objects sharing material and vertex buffer. */
+    struct DrawBatch {
+        Material* mat;
+        Mesh* mesh;  // the first object's
+        uint32_t first;  // object index, and draw command
+        uint32_t count;
+
+        bool operator==(DrawBatch const&) const = default;
+    };
+    std::vector<DrawBatch> _batches;
+
+    // The forward passes execute secondary command buffers, see
+    // record_forward().  Mesh draws are recorded once per frame slot and
+    // replayed until the batches or mesh buffers change, except for meshes
+    // with LODs while culling is off.  Toggled with C.
+    bool _reuse_commands{true};
+    uint64_t _scene_version{0};  // bumped whenever a mesh comes, goes or moves
+
+    struct RecordedBatches {
+        VkCommandBuffer cmd;
+        std::vector<DrawBatch> batches;  // as recorded
+        uint64_t version{UINT64_MAX};    // _scene_version, none yet
+        uint32_t generation{0};          // of the graph's render passes
+    };
+    struct SlotCommands {
+        RecordedBatches batches[3];  // early, late; without culling
+        VkCommandBuffer dynamic;     // everything else, every frame
+    };
+    std::vector<SlotCommands> _slot_cmds;  // per frame in flight
+
+    // Mesh LOD, see select_mesh_lod()
+    float _mesh_lod_error_px{1.f};  // coarsest LOD that moves less than this
+    float _mesh_lod_hysteresis{0.75f};  // and less than this much to switch
+    std::vector<uint32_t> _object_lods;  // per object, last frame's LOD
+    uint64_t _mesh_verts_drawn{0};       // this frame, before culling
+
+    // What each frame slot's info_buf was written for, see prepare_frame().
+    // It's only rewritten when one of these changed since.
+    struct ObjectInfoKey {
+        uint64_t scene{UINT64_MAX};  // _scene_version
+        uint64_t lods{0};            // _lod_version
+        bool culling{false};         // _occlusion_culling
+        bool operator==(ObjectInfoKey const&) const = default;
+    };
+    std::vector<ObjectInfoKey> _object_info_keys;  // per frame in flight
+    uint64_t _lod_version{0};  // bumped whenever an object switches LOD
+
+    // Many meshes instead of a point cloud, see init_scene()
+    bool _grid_scene{false};
+    std::string _grid_mesh_path{ASSETS_DIRECTORY "monkey.obj"};
+
+    // Point cloud file to show instead, see import_point_cloud()
+    std::string _import_path;
+    Trs _point_cloud_transform;
+
+    // Out-of-core point cloud, see open_stream()
+    bool _streaming{false};
+    PointStream _stream;
+    VkDeviceSize _stream_budget_bytes{512ull << 20};  // device memory
+    uint32_t _stream_uploads_per_frame{8};
+    float _stream_fly_speed{0.02f};  // units per tick
+
+    struct StreamedChunk {
+        AllocatedBuffer buf;
+        uint32_t count;
+        uint64_t last_used;  // frame
+    };
+    std::unordered_map<uint32_t, StreamedChunk> _stream_resident;
+    VkDeviceSize _stream_resident_bytes{0};
+    std::vector<uint32_t> _stream_wanted;  // this frame, nearest first
+    std::vector<PointStream::Ready> _stream_ready;
+
+    // Live points from a capture process, see init_live().  A ring on the
+    // device, the newest points overwriting the oldest, which also expire
+    // after _live_max_age.
+    std::string _live_path;  // socket, named pipe or "-"; none if empty
+    bool _live{false};
+    PointIngest _ingest;
+    uint32_t _live_capacity{1 << 22};   // points in the device ring
+    uint32_t _live_per_frame{1 << 18};  // most points taken per frame
+    float _live_max_age{2.f};           // seconds
+    AllocatedBuffer _live_buf;
+    std::vector<AllocatedBuffer> _live_staging;  // one per frame in flight
+    RGResource _rg_live;
+    std::vector<VkBufferCopy> _live_copies;  // this frame's, into the ring
+    uint64_t _live_head{0};  // points written to the ring, ever
+    uint64_t _live_tail{0};  // points expired or overwritten, ever
+
+    struct LiveBatch {
+        uint64_t end;  // _live_head after it
+        std::chrono::steady_clock::time_point time;
+    };
+    std::deque<LiveBatch> _live_batches;  // one per frame, oldest first
+    std::vector<Vert> _live_unfiltered;  // with _voxel_size set
+
+    // Device buffers of static meshes can be evicted and re-uploaded
+    MeshResidency _residency;
+    bool _drop_cpu_copies{false};  // after upload; pins the mesh
+
+    // All meshes' vertices, drawn with one binding, except for those too
+    // large to share it.  See create_mesh_bufs() and compact_geometry().
+    VkDeviceSize _geometry_bytes{256ull << 20};
+    VkDeviceSize _defrag_bytes_per_frame{16ull << 20};
+    AllocatedBuffer _geometry_buf;
+    GeometryArena _geometry;
+
+    // Simulation state, owned by the update thread, and its latest
+    // snapshot for the frames.  See update().  The grid's meshes hang off
+    // one root, spun with G.
+    TransformTree _sim_tree;
+    uint32_t _grid_root{TransformTree::NONE};
+    bool _spin_grid{false};
+    TripleBuffer<SceneSnapshot> _snapshots;
+
+    // nodes in _sim_tree as placed by init_scene()
     std::vector<RenderObject> _scene;
     std::unordered_map<std::string, Material> _materials;
     std::unordered_map<std::string, Mesh> _meshes;
@@ -46,6 +326,8 @@ class HelloEngine : public Engine {
     virtual void init_descriptors() override;
     virtual void init_pipelines() override;
     void init_pointcloud_pipeline();
+    void init_point_raster_pipelines();
+    void init_cull_pipelines();
     virtual void init_materials() override;
     virtual void init_scene() override;
 
@@ -59,19 +341,181 @@ class HelloEngine : public Engine {
     void update_meshes();
 
     /**
-     * Upload mesh using a staging buffer.
+     * Stage the mesh's dirty ranges for this frame's copy to its vertex
+     * buffer, merged into a single multi-region copy, then clear them.
+     * One mesh per frame, see init_dynamic().
+     */
+    void upload_dirty(Mesh& mesh);
+
+    /** Generate or import the point cloud, replacing the placeholder. */
+    Task<> load_point_cloud();
+
+    /**
+     * Keep one point per voxel of _voxel_size, if set.  Runs on the job
+     * system, call from the background.
+     */
+    void downsample_points(std::vector<Vert>& points);
+    /** The same from `src` to `dst`, returns how many were kept. */
+    size_t downsample_points(Vert const* src, size_t count, Vert* dst);
+
+    /** Load and simplify _grid_mesh_path, replacing the placeholder. */
+    Task<> load_grid_mesh();
+
+    /**
+     * Put a loaded mesh in place of _meshes[name], and release the old
+     * one's buffers once in-flight frames are done with them.
+     */
+    Mesh& install_mesh(std::string const& name, Mesh&& mesh);
+
+    /**
+     * Upload mesh using a staging buffer.  The staging buffer is only kept
+     * around for dynamic meshes.  Evicts idle meshes if the new one doesn't
+     * fit in the memory budget; returns false if it still doesn't.
+     */
+    bool upload_mesh(Mesh& mesh);
+
+    /**
+     * upload_mesh() for a static mesh, without waiting for the copy.
+     * Continues on the main thread.  The mesh isn't tracked for eviction
+     * until it's installed, see install_mesh().
+     */
+    Task<bool> upload_mesh_async(Mesh& mesh);
+
+    bool create_mesh_bufs(Mesh& mesh);
+    void copy_to_staging(Mesh& mesh);
+    void record_mesh_copy(VkCommandBuffer cmd, Mesh& mesh);
+
+    /** Let the residency manager evict it, or drop the CPU copy. */
+    void track_residency(Mesh& mesh);
+
+    /**
+     * Load a PLY or XYZ point cloud into `mesh`, converting, thinning out
+     * and sorting it in two staging buffers, with no copy on the heap.
+     * There is no CPU copy afterwards either, so the mesh stays resident.
+     * Sets _point_cloud_transform to fit it into view.
+     * Continues on the main thread.
+     */
+    Task<bool> import_point_cloud(std::string path, Mesh& mesh);
+
+    /** Re-upload an evicted mesh.  False if there is no memory for it. */
+    bool make_resident(Mesh& mesh);
+
+    /**
+     * Free the least recently drawn idle mesh, one in the geometry arena
+     * or one with its own buffer.  False if there is none.
      */
-    void upload_mesh(Mesh& mesh, bool create_bufs = true);
+    bool evict_lru_mesh(bool in_arena);
+
+    /** The oldest frame the GPU may still be working on. */
+    uint64_t idle_frames_before() const;
 
     /**
-     * Upload mesh using a HOST_VISIBLE and DEVICE_LOCAL buffer.
+     * Release the mesh's GPU buffers once in-flight frames are done with
+     * them.  Safe to call at runtime.
      */
-    void upload_mesh_old(Mesh& mesh);
+    void destroy_mesh(Mesh& mesh);
+    virtual void unload_meshes() override;
 
-    // Descriptor stuff
-    VkDescriptorPool _descriptor_pool;
+    /** Create _geometry_buf, see GeometryArena. */
+    void init_geometry();
 
+    /**
+     * Move meshes down the arena into free ranges, at most
+     * _defrag_bytes_per_frame a frame.  Blocks on the copy.
+     */
+    void compact_geometry();
+    void print_geometry_stats() const;
+
+    virtual void declare_passes(RenderGraph& graph) override;
+    virtual void update(uint64_t tick) override;
+    virtual void prepare_frame() override;
     virtual void render_pass(VkCommandBuffer cmd) override;
+    virtual void on_key(int key) override;
+
+    FramePushConstants frame_constants();
+
+    /**
+     * Pick the LOD of object `i` whose error is below _mesh_lod_error_px on
+     * screen.  It only switches to a coarser one once that is also below
+     * _mesh_lod_hysteresis of the threshold, so objects don't flicker back
+     * and forth at the boundary.
+     */
+    MeshLod select_mesh_lod(uint32_t i,
+                            Trs const& world,
+                            glm::vec3 cam_pos,
+                            float px_per_unit);
+    bool is_point_cloud(RenderObject const& obj) const;
+
+    /**
+     * Clear the raster buffer and splat this frame's _point_draws into it,
+     * keeping the nearest point per pixel.  The forward pass resolves it.
+     */
+    void rasterize_points(VkCommandBuffer cmd);
+
+    /**
+     * Fill the early or the late half of the draw buffer, see cull.comp.
+     * The late pass also records which objects are visible, for the next
+     * frame's early pass.
+     */
+    void cull_objects(VkCommandBuffer cmd, bool late);
+
+    /** Reduce this frame's depth buffer (so far) into _pyramid_buf. */
+    void build_depth_pyramid(VkCommandBuffer cmd);
+
+    /** Draw _batches from the early or the late draw commands. */
+    void draw_batches(VkCommandBuffer cmd, bool late);
+
+    /**
+     * Draw the objects in _batches without culling, those whose mesh has a
+     * LOD chain or the others.  `bound` is the bound vertex buffer.
+     */
+    void draw_meshes(VkCommandBuffer cmd, bool lod_chains, VkBuffer& bound);
+
+    /**
+     * Execute the forward or forward late pass's secondary command
+     * buffers, recording those that are out of date.
+     */
+    void record_forward(VkCommandBuffer cmd, bool late);
+
+    /** Begin `cmd` as a secondary command buffer inside `pass`. */
+    void begin_secondary(VkCommandBuffer cmd,
+                         char const* pass,
+                         VkCommandBufferUsageFlags flags);
+
+    /** Bind the bindless set and push this frame's buffer slots. */
+    void bind_frame(VkCommandBuffer cmd);
+
+   public:
+    /** Compute needs 64-bit atomics, it is refused without them. */
+    void set_point_renderer(PointRenderer renderer);
+
+    /** Needs indirect multi-draws, it is refused without them. */
+    void set_occlusion_culling(bool enabled);
+
+    /** Stream a .pcc point cloud, see PointStream.  Call after init(). */
+    void open_stream(std::string const& path);
+
+   protected:
+    /** Request, upload and evict chunks for this frame's camera. */
+    void update_stream(glm::mat4 const& viewproj, glm::vec3 cam_pos);
+
+    /** Free the least recently drawn chunk.  False if all are in use. */
+    bool evict_stream_chunk();
+
+    /**
+     * Declare the pass that copies dirty ranges of the dynamic point cloud
+     * to its vertex buffer, if _dynamic_points is set.
+     */
+    void init_dynamic(RenderGraph& graph);
+
+    /**
+     * Start receiving from _live_path, if set, and declare the pass that
+     * copies each frame's new points into the device ring.
+     */
+    void init_live(RenderGraph& graph);
+
+    /** Expire old points, stage new ones, and add the ring's draws. */
+    void update_live();
 };
 
 #endif  // HELLO_ENGINE_H
@@ -0,0 +1,252 @@
+#include "job_system.h"
+#include <algorithm>
+
+// which pool the current thread works for, and as which worker
+static thread_local JobSystem const* t_pool = nullptr;
+static thread_local uint32_t t_worker = 0;
+
+void* ScratchArena::alloc(size_t bytes, size_t align) {
+    while (true) {
+        if (_block < _blocks.size()) {
+            auto& block = _blocks[_block];
+            uintptr_t base = (uintptr_t)block.data.get();
+            uintptr_t p = (base + _offset + align - 1) / align * align;
+            if (p + bytes <= base + block.size) {
+                _offset = p + bytes - base;
+                return (void*)p;
+            }
+            if (_block + 1 < _blocks.size() || _offset > 0) {
+                ++_block;  // try the next one, or make one
+                _offset = 0;
+                continue;
+            }
+        }
+        // new block, large enough for this allocation
+        size_t size = std::max(_block_size, bytes + align);
+        if (_block < _blocks.size()) {
+            _blocks[_block] = {std::make_unique<std::byte[]>(size), size};
+        } else {
+            _blocks.push_back({std::make_unique<std::byte[]>(size), size});
+        }
+    }
+}
+
+void JobSystem::init(uint32_t workers, uint32_t external) {
+    if (workers == 0) {
+        workers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    _quit = false;
+    for (uint32_t i = 0; i < workers + external; ++i) {
+        _workers.push_back(std::make_unique<Worker>());
+    }
+    _external = external;
+    t_pool = this;
+    t_worker = 0;
+    for (uint32_t i = 1; i < workers; ++i) {
+        _workers[i]->thread = std::thread(&JobSystem::worker_loop, this, i);
+    }
+}
+
+void JobSystem::attach(uint32_t slot) {
+    t_pool = this;
+    t_worker = worker_count() + slot;
+}
+
+void JobSystem::shutdown() {
+    if (_workers.empty()) {
+        return;
+    }
+    // run what's left, then let the workers go
+    Task task;
+    while (try_take(0, task)) {
+        execute(0, task);
+    }
+    {
+        std::lock_guard lock{_sleep_mutex};
+        _quit = true;
+    }
+    _wake.notify_all();
+    for (auto& w : _workers) {
+        if (w->thread.joinable()) {
+            w->thread.join();
+        }
+    }
+    _workers.clear();
+    _external = 0;
+    if (t_pool == this) {
+        t_pool = nullptr;
+    }
+}
+
+uint32_t JobSystem::worker_index() const {
+    return t_pool == this ? t_worker : 0;
+}
+
+void JobSystem::push(Task&& task) {
+    {
+        // counted first, so it never drops below zero when the task is
+        // taken right away, and under the lock, so a worker about to
+        // sleep can't miss it
+        std::lock_guard lock{_sleep_mutex};
+        _queued.fetch_add(1, std::memory_order_release);
+    }
+    auto& w = *_workers[worker_index()];
+    {
+        std::lock_guard lock{w.mutex};
+        w.tasks.push_back(std::move(task));
+    }
+    _wake.notify_one();
+}
+
+void JobSystem::run(Job job, JobCounter* counter) {
+    if (counter) {
+        counter->_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    push({std::move(job), counter});
+}
+
+void JobSystem::run_after(JobCounter& dependency,
+                          Job job,
+                          JobCounter* counter) {
+    if (counter) {
+        counter->_pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        std::lock_guard lock{dependency._mutex};
+        if (!dependency.done()) {
+            // queued by finish() when the last dependency is done
+            dependency._waiting.push_back({std::move(job), counter});
+            return;
+        }
+    }
+    push({std::move(job), counter});
+}
+
+void JobSystem::run_background(Job job) {
+    if (worker_count() < 2) {
+        job();  // no thread to hand it to
+        return;
+    }
+    {
+        std::lock_guard lock{_sleep_mutex};
+        _background.push_back(std::move(job));
+    }
+    _wake.notify_one();
+}
+
+bool JobSystem::try_take(uint32_t self, Task& out) {
+    if (_queued.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+    // newest of our own first, it's likely still in cache
+    {
+        auto& w = *_workers[self];
+        std::lock_guard lock{w.mutex};
+        if (!w.tasks.empty()) {
+            out = std::move(w.tasks.back());
+            w.tasks.pop_back();
+            _queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    // then the oldest of someone else's, likely the biggest piece of work
+    for (uint32_t i = 1; i < _workers.size(); ++i) {
+        auto& w = *_workers[(self + i) % _workers.size()];
+        std::lock_guard lock{w.mutex};
+        if (!w.tasks.empty()) {
+            out = std::move(w.tasks.front());
+            w.tasks.pop_front();
+            _queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(uint32_t self, Task& task) {
+    auto& scratch = _workers[self]->scratch;
+    auto mark = scratch.mark();
+    task.fn();
+    scratch.release(mark);
+    if (task.counter) {
+        finish(*task.counter);
+    }
+    task = {};
+}
+
+void JobSystem::finish(JobCounter& counter) {
+    // the counter may be gone as soon as it's unlocked, see wait()
+    std::vector<std::pair<Job, JobCounter*>> waiting;
+    {
+        std::lock_guard lock{counter._mutex};
+        if (counter._pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        waiting.swap(counter._waiting);
+    }
+    for (auto& [job, next] : waiting) {
+        push({std::move(job), next});
+    }
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    uint32_t self = worker_index();
+    Task task;
+    while (!counter.done()) {
+        if (try_take(self, task)) {
+            execute(self, task);
+        } else {
+            std::this_thread::yield();  // the last jobs run elsewhere
+        }
+    }
+    // the last finish() may still be unlocking it, after this the caller
+    // is free to destroy the counter
+    std::lock_guard lock{counter._mutex};
+}
+
+void JobSystem::parallel_for(size_t count,
+                             size_t batch,
+                             std::function<void(size_t, size_t)> const& fn) {
+    batch = std::max<size_t>(batch, 1);
+    if (count <= batch) {
+        if (count > 0) {
+            fn(0, count);
+        }
+        return;
+    }
+    JobCounter done;
+    for (size_t begin = 0; begin < count; begin += batch) {
+        size_t end = std::min(count, begin + batch);
+        run([&fn, begin, end] { fn(begin, end); }, &done);
+    }
+    wait(done);
+}
+
+void JobSystem::worker_loop(uint32_t self) {
+    t_pool = this;
+    t_worker = self;
+    Task task;
+    while (true) {
+        if (try_take(self, task)) {
+            execute(self, task);
+            continue;
+        }
+        std::unique_lock lock{_sleep_mutex};
+        if (!_background.empty()) {
+            // nothing more urgent, so take a long one
+            task = {std::move(_background.front()), nullptr};
+            _background.pop_front();
+            lock.unlock();
+            execute(self, task);
+            continue;
+        }
+        _wake.wait(lock, [&] {
+            return _quit || _queued.load(std::memory_order_acquire) > 0 ||
+                   !_background.empty();
+        });
+        if (_quit && _queued.load(std::memory_order_acquire) == 0 &&
+            _background.empty()) {
+            return;
+        }
+    }
+}
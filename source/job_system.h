@@ -0,0 +1,180 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Bump allocator for temporary memory within a job.  Memory comes in
+ * blocks that are kept around, so after warming up nothing is allocated.
+ * There are no destructors, use it for plain data.
+ */
+class ScratchArena {
+   public:
+    struct Mark {
+        size_t block;
+        size_t offset;
+    };
+
+    explicit ScratchArena(size_t block_size = 1 << 20)
+        : _block_size{block_size} {}
+
+    void* alloc(size_t bytes, size_t align = alignof(std::max_align_t));
+
+    template <class T>
+    T* alloc(size_t count) {
+        return (T*)alloc(count * sizeof(T), alignof(T));
+    }
+
+    Mark mark() const { return {_block, _offset}; }
+
+    /** Free everything allocated since `m`. */
+    void release(Mark m) {
+        _block = m.block;
+        _offset = m.offset;
+    }
+
+   private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    size_t _block_size;
+    std::vector<Block> _blocks;
+    size_t _block{0};  // current one
+    size_t _offset{0};
+};
+
+/**
+ * Counts the jobs of a batch that haven't finished yet.  Wait on it with
+ * JobSystem::wait(), or hold other jobs back with JobSystem::run_after().
+ * Reuse it only once it has dropped to zero.
+ */
+class JobCounter {
+   public:
+    bool done() const { return _pending.load(std::memory_order_acquire) == 0; }
+
+   private:
+    friend class JobSystem;
+
+    std::atomic<uint32_t> _pending{0};
+    std::mutex _mutex;  // guards _waiting
+    std::vector<std::pair<std::function<void()>, JobCounter*>> _waiting;
+};
+
+/**
+ * Work-stealing thread pool.  Every worker has its own deque: it pushes
+ * and pops its jobs at the back, idle workers steal from the front of the
+ * others'.  The thread that calls init() is worker 0 and runs jobs while
+ * it waits, so N workers start N - 1 threads.
+ *
+ *   JobCounter done;
+ *   for (auto& item : items) {
+ *       jobs.run([&] { process(item); }, &done);
+ *   }
+ *   jobs.wait(done);  // join
+ *
+ * Jobs may start jobs and wait on them.  Only workers may call run(),
+ * wait() and scratch(), other threads would share worker 0's state.  A
+ * long-lived thread of its own can attach() to a slot reserved for it.
+ *
+ * Long jobs that nobody waits for, like loading assets, go through
+ * run_background() instead, so a frame waiting on its own jobs never
+ * picks one up.
+ */
+class JobSystem {
+   public:
+    using Job = std::function<void()>;
+
+    ~JobSystem() { shutdown(); }
+
+    /**
+     * Start `workers` workers (0 for one per core), including the caller,
+     * and reserve `external` slots for other threads, see attach().
+     */
+    void init(uint32_t workers = 0, uint32_t external = 0);
+
+    /**
+     * Make the calling thread the worker in reserved slot `slot`, so it
+     * may run() and wait() too.  It only runs jobs while it waits.
+     */
+    void attach(uint32_t slot);
+
+    /** Finish all queued jobs and stop the threads. */
+    void shutdown();
+
+    /** Queue `job`; `counter`, if given, drops when it has finished. */
+    void run(Job job, JobCounter* counter = nullptr);
+
+    /** Queue `job` once `dependency` has dropped to zero. */
+    void run_after(JobCounter& dependency,
+                   Job job,
+                   JobCounter* counter = nullptr);
+
+    /**
+     * Queue `job` for a worker thread that has nothing else to do.  It is
+     * never run by wait(), so it can take long.  With a single worker it
+     * runs right away.
+     */
+    void run_background(Job job);
+
+    /** Run jobs until `counter` has dropped to zero. */
+    void wait(JobCounter& counter);
+
+    /**
+     * fn(begin, end) for batches of at most `batch` out of [0, count),
+     * spread over the workers; returns when all are done.
+     */
+    void parallel_for(size_t count,
+                      size_t batch,
+                      std::function<void(size_t, size_t)> const& fn);
+
+    uint32_t worker_count() const { return _workers.size() - _external; }
+
+    /** The calling worker's index, 0 for the thread that called init(). */
+    uint32_t worker_index() const;
+
+    /** The calling worker's arena, rewound whenever a job returns. */
+    ScratchArena& scratch() { return _workers[worker_index()]->scratch; }
+
+   private:
+    struct Task {
+        Job fn;
+        JobCounter* counter;
+    };
+
+    // one cache line each, they are hammered by different threads
+    struct alignas(64) Worker {
+        std::mutex mutex;  // guards tasks
+        std::deque<Task> tasks;
+        ScratchArena scratch;
+        std::thread thread;  // not for worker 0
+    };
+
+    void push(Task&& task);
+
+    /** Pop one of ours, or steal one of someone else's. */
+    bool try_take(uint32_t self, Task& out);
+    void execute(uint32_t self, Task& task);
+    void finish(JobCounter& counter);
+    void worker_loop(uint32_t self);
+
+    std::vector<std::unique_ptr<Worker>> _workers;  // reserved ones last
+    uint32_t _external{0};
+    std::atomic<uint32_t> _queued{0};
+    std::mutex _sleep_mutex;  // also guards _background
+    std::deque<Job> _background;
+    std::condition_variable _wake;
+    bool _quit{false};
+};
+
+#endif  // JOB_SYSTEM_H
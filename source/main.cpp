@@ -1,9 +1,89 @@
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
 #include "hello_engine.h"
 
 int main(int argc, char* argv[]) {
     HelloEngine engine;
+    std::string stream_path;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            engine._frame_overlap = std::atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            engine._worker_count = std::atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+            engine._tick_rate = std::atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--points") == 0 && i + 1 < argc) {
+            engine._point_count = std::atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--voxel-size") == 0 && i + 1 < argc) {
+            engine._voxel_size = std::atof(argv[++i]);
+        } else if (strcmp(argv[i], "--voxel-mode") == 0 && i + 1 < argc) {
+            engine._voxel_mode = strcmp(argv[++i], "first") == 0
+                                     ? VoxelMode::First
+                                     : VoxelMode::Average;
+        } else if (strcmp(argv[i], "--point-budget") == 0 && i + 1 < argc) {
+            engine._point_budget = std::atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--point-renderer") == 0 && i + 1 < argc) {
+            engine._point_renderer = strcmp(argv[++i], "compute") == 0
+                                         ? PointRenderer::Compute
+                                         : PointRenderer::Fixed;
+        } else if (strcmp(argv[i], "--dynamic-points") == 0) {
+            engine._dynamic_points = true;
+        } else if (strcmp(argv[i], "--dynamic-fraction") == 0 &&
+                   i + 1 < argc) {
+            engine._dynamic_fraction = std::atof(argv[++i]);
+        } else if (strcmp(argv[i], "--grid") == 0) {
+            engine._grid_scene = true;
+        } else if (strcmp(argv[i], "--grid-mesh") == 0 && i + 1 < argc) {
+            engine._grid_scene = true;
+            engine._grid_mesh_path = argv[++i];
+        } else if (strcmp(argv[i], "--geometry-mb") == 0 && i + 1 < argc) {
+            engine._geometry_bytes = std::atoll(argv[++i]) << 20;
+        } else if (strcmp(argv[i], "--mesh-lod-error") == 0 && i + 1 < argc) {
+            engine._mesh_lod_error_px = std::atof(argv[++i]);
+        } else if (strcmp(argv[i], "--import") == 0 && i + 1 < argc) {
+            engine._import_path = argv[++i];
+        } else if (strcmp(argv[i], "--live") == 0 && i + 1 < argc) {
+            engine._live_path = argv[++i];
+        } else if (strcmp(argv[i], "--live-max-age") == 0 && i + 1 < argc) {
+            engine._live_max_age = std::atof(argv[++i]);
+        } else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) {
+            stream_path = argv[++i];
+        } else if (strcmp(argv[i], "--make-pcc") == 0 && i + 2 < argc) {
+            // 64Ki points (2.25 MiB) per chunk
+            char const* path = argv[++i];
+            int chunks_per_axis = std::atoi(argv[++i]);
+            return write_synthetic_pcc(path, chunks_per_axis, 1 << 16) ? 0 : 1;
+        } else if (strcmp(argv[i], "--ingest-producer") == 0 &&
+                   i + 2 < argc) {
+            char const* path = argv[++i];
+            return run_ingest_producer(path, std::atoi(argv[++i]));
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--frames N] [--workers N] [--tick-rate HZ]"
+                         " [--points N] [--point-budget N]"
+                         " [--voxel-size S] [--voxel-mode average|first]"
+                         " [--point-renderer fixed|compute]"
+                         " [--dynamic-points] [--dynamic-fraction F]"
+                         " [--grid] [--grid-mesh FILE.obj]"
+                         " [--geometry-mb MB] [--mesh-lod-error PX]"
+                         " [--import FILE.ply|FILE.xyz]"
+                         " [--stream FILE.pcc]"
+                         " [--live SOCKET|FIFO|-] [--live-max-age S]\n"
+                      << "       " << argv[0]
+                      << " --make-pcc FILE.pcc CHUNKS_PER_AXIS\n"
+                      << "       " << argv[0]
+                      << " --ingest-producer SOCKET|FIFO|- POINTS_PER_SEC\n";
+            return 1;
+        }
+    }
+
     engine.init();
+    if (!stream_path.empty()) {
+        engine.open_stream(stream_path);
+    }
     engine.run();
     std::cout << "Cleaning up...\n";
     engine.cleanup();
@@ -0,0 +1,103 @@
+#include "memory_stats.h"
+#include <algorithm>
+#include <fstream>
+
+char const* to_string(MemCategory category) {
+    switch (category) {
+        case MemCategory::Vertex:
+            return "vertex";
+        case MemCategory::Staging:
+            return "staging";
+        case MemCategory::Uniform:
+            return "uniform";
+        case MemCategory::Attachment:
+            return "attachment";
+        default:
+            return "unknown";
+    }
+}
+
+void MemoryStats::track(VmaAllocator allocator,
+                        VmaAllocation alloc,
+                        MemCategory category,
+                        char const* name) {
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, alloc, &info);
+
+    auto& stats = _categories[(size_t)category];
+    stats.count.fetch_add(1, std::memory_order_relaxed);
+    VkDeviceSize bytes =
+        stats.bytes.fetch_add(info.size, std::memory_order_relaxed) +
+        info.size;
+    VkDeviceSize peak = stats.peak_bytes.load(std::memory_order_relaxed);
+    while (peak < bytes && !stats.peak_bytes.compare_exchange_weak(
+                               peak, bytes, std::memory_order_relaxed)) {
+    }
+
+    vmaSetAllocationName(allocator, alloc, name);
+    vmaSetAllocationUserData(allocator, alloc, &stats);
+}
+
+void MemoryStats::untrack(VmaAllocator allocator, VmaAllocation alloc) {
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, alloc, &info);
+    auto stats = static_cast<MemCategoryStats*>(info.pUserData);
+    if (stats == nullptr) {
+        return;
+    }
+    stats->count.fetch_sub(1, std::memory_order_relaxed);
+    stats->bytes.fetch_sub(info.size, std::memory_order_relaxed);
+    vmaSetAllocationUserData(allocator, alloc, nullptr);
+}
+
+void MemoryStats::print(VmaAllocator allocator, std::ostream& out) const {
+    out << "GPU memory by category:\n";
+    for (size_t c = 0; c < _categories.size(); ++c) {
+        auto& stats = _categories[c];
+        out << "  " << to_string((MemCategory)c) << ": "
+            << stats.count.load() << " allocations, "
+            << stats.bytes.load() / 1e6 << " MB (peak "
+            << stats.peak_bytes.load() / 1e6 << " MB)\n";
+    }
+
+    VkPhysicalDeviceMemoryProperties const* props;
+    vmaGetMemoryProperties(allocator, &props);
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(allocator, budgets);
+
+    out << "GPU memory by heap:\n";
+    for (uint32_t i = 0; i < props->memoryHeapCount; ++i) {
+        auto& b = budgets[i];
+        bool device_local =
+            props->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+        out << "  heap " << i << (device_local ? " (device local)" : "")
+            << ": " << b.statistics.allocationCount << " allocations, "
+            << b.statistics.allocationBytes / 1e6 << " MB in "
+            << b.statistics.blockBytes / 1e6 << " MB of blocks, usage "
+            << b.usage / 1e6 << " / " << b.budget / 1e6 << " MB budget\n";
+    }
+}
+
+bool MemoryStats::dump_json(VmaAllocator allocator, std::string const& path) {
+    char* json = nullptr;
+    vmaBuildStatsString(allocator, &json, VK_TRUE);  // with detailed map
+    std::ofstream file(path);
+    file << json;
+    vmaFreeStatsString(allocator, json);
+    return file.good();
+}
+
+void destroy_buffer(VmaAllocator allocator, AllocatedBuffer const& buf) {
+    MemoryStats::untrack(allocator, buf.alloc);
+    vmaDestroyBuffer(allocator, buf.buf, buf.alloc);
+}
+
+void destroy_image(VmaAllocator allocator, AllocatedImage const& img) {
+    MemoryStats::untrack(allocator, img.alloc);
+    vmaDestroyImage(allocator, img.img, img.alloc);
+}
+
+void free_memory(VmaAllocator allocator, VmaAllocation alloc) {
+    MemoryStats::untrack(allocator, alloc);
+    vmaFreeMemory(allocator, alloc);
+}
@@ -0,0 +1,68 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "vk_types.h"
+
+/** What an allocation is used for, for accounting only. */
+enum class MemCategory : uint8_t {
+    Vertex,      // vertex and geometry buffers
+    Staging,     // host-visible upload buffers
+    Uniform,     // uniform and storage buffers for shader parameters
+    Attachment,  // render targets
+    Count,
+};
+
+char const* to_string(MemCategory category);
+
+/**
+ * Live allocations in one category.  Atomic, since buffers are created and
+ * freed on the main thread and from tasks on the workers alike.
+ */
+struct MemCategoryStats {
+    std::atomic<uint64_t> count{0};
+    std::atomic<VkDeviceSize> bytes{0};
+    std::atomic<VkDeviceSize> peak_bytes{0};
+};
+
+/**
+ * Per-category GPU memory counters.  track() names an allocation and points
+ * its pUserData at the category's counters, so whoever frees it can give
+ * the bytes back without knowing the category, see destroy_buffer() etc.
+ */
+class MemoryStats {
+   public:
+    void track(VmaAllocator allocator,
+               VmaAllocation alloc,
+               MemCategory category,
+               char const* name);
+
+    /** Undo track().  No-op for untracked allocations. */
+    static void untrack(VmaAllocator allocator, VmaAllocation alloc);
+
+    MemCategoryStats const& get(MemCategory category) const {
+        return _categories[(size_t)category];
+    }
+
+    /** Per-category counters, then per-heap usage and budget. */
+    void print(VmaAllocator allocator, std::ostream& out) const;
+
+    /** Write VMA's detailed JSON statistics to `path`. */
+    static bool dump_json(VmaAllocator allocator, std::string const& path);
+
+   private:
+    std::array<MemCategoryStats, (size_t)MemCategory::Count> _categories;
+};
+
+// Free and untrack in one go.  Use these instead of calling VMA directly.
+void destroy_buffer(VmaAllocator allocator, AllocatedBuffer const& buf);
+void destroy_image(VmaAllocator allocator, AllocatedImage const& img);
+void free_memory(VmaAllocator allocator, VmaAllocation alloc);
+
+#endif  // MEMORY_STATS_H
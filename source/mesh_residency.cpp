@@ -0,0 +1,36 @@
+#include "mesh_residency.h"
+
+void MeshResidency::track(Mesh* mesh, uint64_t frame) {
+    if (_entries.count(mesh)) {
+        touch(mesh, frame);
+        return;
+    }
+    _lru.push_back({mesh, frame});
+    _entries[mesh] = std::prev(_lru.end());
+}
+
+void MeshResidency::untrack(Mesh* mesh) {
+    auto it = _entries.find(mesh);
+    if (it == _entries.end()) {
+        return;
+    }
+    _lru.erase(it->second);
+    _entries.erase(it);
+}
+
+void MeshResidency::touch(Mesh* mesh, uint64_t frame) {
+    auto it = _entries.find(mesh);
+    if (it == _entries.end()) {
+        return;
+    }
+    it->second->last_drawn = frame;
+    // O(1) move to the back, no reallocation
+    _lru.splice(_lru.end(), _lru, it->second);
+}
+
+Mesh* MeshResidency::eviction_candidate(uint64_t idle_before) const {
+    if (_lru.empty() || _lru.front().last_drawn >= idle_before) {
+        return nullptr;
+    }
+    return _lru.front().mesh;
+}
@@ -0,0 +1,59 @@
+#ifndef MESH_RESIDENCY_H
+#define MESH_RESIDENCY_H
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "vk_mesh.h"
+
+/**
+ * Least-recently-drawn bookkeeping for meshes whose device buffer may be
+ * evicted and re-uploaded from their CPU copy.  Pure bookkeeping, the
+ * engine does the actual freeing and uploading.
+ */
+class MeshResidency {
+   public:
+    /** Start tracking a resident mesh, as if drawn in `frame`. */
+    void track(Mesh* mesh, uint64_t frame);
+
+    /** Forget about a mesh, e.g. after it has been evicted. */
+    void untrack(Mesh* mesh);
+
+    /** Mark a tracked mesh as drawn in `frame`. */
+    void touch(Mesh* mesh, uint64_t frame);
+
+    /**
+     * Least recently drawn mesh not drawn after `idle_before`, or nullptr.
+     * Those are safe to free right away if `idle_before` is the oldest
+     * frame the GPU may still be working on.
+     */
+    Mesh* eviction_candidate(uint64_t idle_before) const;
+
+    /** Like eviction_candidate(), among meshes for which `pred` holds. */
+    template <class Pred>
+    Mesh* eviction_candidate(uint64_t idle_before, Pred pred) const {
+        for (auto& e : _lru) {
+            if (e.last_drawn >= idle_before) {
+                break;  // and all after it
+            }
+            if (pred(*e.mesh)) {
+                return e.mesh;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t size() const { return _lru.size(); }
+
+   private:
+    struct Entry {
+        Mesh* mesh;
+        uint64_t last_drawn;
+    };
+
+    std::list<Entry> _lru;  // front: least recently drawn
+    std::unordered_map<Mesh*, std::list<Entry>::iterator> _entries;
+};
+
+#endif  // MESH_RESIDENCY_H
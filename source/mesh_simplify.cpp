@@ -0,0 +1,296 @@
+#include "mesh_simplify.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+/** Bit pattern of a position, for welding exact duplicates. */
+struct PosKey {
+    uint32_t bits[3];
+
+    bool operator==(PosKey const& k) const {
+        return memcmp(bits, k.bits, sizeof(bits)) == 0;
+    }
+};
+
+uint64_t edge_key(uint32_t a, uint32_t b) {
+    return (uint64_t)std::min(a, b) << 32 | std::max(a, b);
+}
+
+struct PosKeyHash {
+    size_t operator()(PosKey const& k) const {
+        return (k.bits[0] * 73856093u) ^ (k.bits[1] * 19349663u) ^
+               (k.bits[2] * 83492791u);
+    }
+};
+
+}  // namespace
+
+MeshSimplifier::Quadric MeshSimplifier::Quadric::plane(glm::dvec3 n,
+                                                       double d,
+                                                       double weight) {
+    Quadric q;
+    double p[4] = {n.x, n.y, n.z, d};
+    int k = 0;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = i; j < 4; ++j) {
+            q.a[k++] = weight * p[i] * p[j];
+        }
+    }
+    return q;
+}
+
+MeshSimplifier::Quadric& MeshSimplifier::Quadric::operator+=(
+    Quadric const& q) {
+    for (int i = 0; i < 10; ++i) {
+        a[i] += q.a[i];
+    }
+    return *this;
+}
+
+double MeshSimplifier::Quadric::error(glm::dvec3 p) const {
+    double x = p.x, y = p.y, z = p.z;
+    return a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x +
+           a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y + a[7] * z * z +
+           2 * a[8] * z + a[9];
+}
+
+MeshSimplifier::MeshSimplifier(std::vector<Vert> const& tris) {
+    // weld corners that share a position
+    std::unordered_map<PosKey, uint32_t, PosKeyHash> welded;
+    std::vector<uint32_t> corners(tris.size());
+    for (size_t i = 0; i < tris.size(); ++i) {
+        PosKey key;
+        memcpy(key.bits, &tris[i].pos, sizeof(key.bits));
+        auto [it, added] = welded.try_emplace(key, (uint32_t)_pos.size());
+        if (added) {
+            _pos.push_back(tris[i].pos);
+        }
+        corners[i] = it->second;
+    }
+    _quadrics.resize(_pos.size());
+    _version.resize(_pos.size(), 0);
+    _removed.resize(_pos.size(), false);
+    _vert_tris.resize(_pos.size());
+
+    // triangle planes, and how many triangles use each edge
+    std::unordered_map<uint64_t, uint32_t> edge_use;
+    for (size_t i = 0; i + 2 < corners.size(); i += 3) {
+        std::array<uint32_t, 3> t = {
+            corners[i], corners[i + 1], corners[i + 2]};
+        if (t[0] == t[1] || t[1] == t[2] || t[2] == t[0]) {
+            continue;
+        }
+        glm::dvec3 n =
+            glm::cross(_pos[t[1]] - _pos[t[0]], _pos[t[2]] - _pos[t[0]]);
+        if (glm::length(n) == 0.) {
+            continue;
+        }
+        n = glm::normalize(n);
+        auto q = Quadric::plane(n, -glm::dot(n, _pos[t[0]]));
+        uint32_t tri = _tris.size();
+        for (int c = 0; c < 3; ++c) {
+            _quadrics[t[c]] += q;
+            _vert_tris[t[c]].push_back(tri);
+            auto a = t[c], b = t[(c + 1) % 3];
+            ++edge_use[edge_key(a, b)];
+        }
+        _tris.push_back(t);
+    }
+    _dead.resize(_tris.size(), false);
+    _live_tris = _tris.size();
+
+    // borders: a plane through the edge, perpendicular to its triangle
+    const double border_weight = 10.;
+    for (auto& t : _tris) {
+        glm::dvec3 n = glm::normalize(
+            glm::cross(_pos[t[1]] - _pos[t[0]], _pos[t[2]] - _pos[t[0]]));
+        for (int c = 0; c < 3; ++c) {
+            auto a = t[c], b = t[(c + 1) % 3];
+            if (edge_use[edge_key(a, b)] != 1) {
+                continue;
+            }
+            glm::dvec3 edge = _pos[b] - _pos[a];
+            glm::dvec3 side = glm::cross(edge, n);
+            if (glm::length(side) == 0.) {
+                continue;
+            }
+            side = glm::normalize(side);
+            auto q = Quadric::plane(side, -glm::dot(side, _pos[a]),
+                                    border_weight);
+            _quadrics[a] += q;
+            _quadrics[b] += q;
+        }
+    }
+
+    for (auto& [edge, uses] : edge_use) {
+        push_collapse(edge >> 32, (uint32_t)edge);
+    }
+}
+
+void MeshSimplifier::push_collapse(uint32_t a, uint32_t b) {
+    Quadric q = _quadrics[a];
+    q += _quadrics[b];
+
+    // the better end or the midpoint, which needs no matrix inversion
+    glm::dvec3 candidates[] = {_pos[a], _pos[b], (_pos[a] + _pos[b]) / 2.};
+    Collapse best{.cost = -1.};
+    for (int i = 0; i < 3; ++i) {
+        double cost = std::max(q.error(candidates[i]), 0.);
+        if (best.cost < 0. || cost < best.cost) {
+            best.cost = cost;
+            best.target = candidates[i];
+        }
+    }
+    best.keep = a;
+    best.remove = b;
+    best.keep_version = _version[a];
+    best.remove_version = _version[b];
+    _heap.push(best);
+}
+
+bool MeshSimplifier::has_vertex(uint32_t tri, uint32_t v) const {
+    auto& t = _tris[tri];
+    return t[0] == v || t[1] == v || t[2] == v;
+}
+
+bool MeshSimplifier::flips(uint32_t v, uint32_t other, glm::dvec3 p) const {
+    for (auto tri : _vert_tris[v]) {
+        if (_dead[tri] || has_vertex(tri, other)) {
+            continue;  // gone, or collapses with the edge
+        }
+        auto& t = _tris[tri];
+        glm::dvec3 before[3], after[3];
+        for (int c = 0; c < 3; ++c) {
+            before[c] = _pos[t[c]];
+            after[c] = t[c] == v ? p : _pos[t[c]];
+        }
+        glm::dvec3 n0 =
+            glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::dvec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+        double len = glm::length(n0) * glm::length(n1);
+        if (len == 0. || glm::dot(n0, n1) < 0.2 * len) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void MeshSimplifier::simplify(uint32_t target) {
+    while (_live_tris > target && !_heap.empty()) {
+        Collapse c = _heap.top();
+        _heap.pop();
+        if (_removed[c.keep] || _removed[c.remove] ||
+            _version[c.keep] != c.keep_version ||
+            _version[c.remove] != c.remove_version) {
+            continue;  // stale, a newer entry was pushed
+        }
+        if (flips(c.keep, c.remove, c.target) ||
+            flips(c.remove, c.keep, c.target)) {
+            continue;  // pushed again if a neighbor collapses
+        }
+
+        // move `remove`'s triangles over to `keep`
+        uint32_t v = c.keep;
+        _pos[v] = c.target;
+        _quadrics[v] += _quadrics[c.remove];
+        _removed[c.remove] = true;
+        ++_version[v];
+        for (auto tri : _vert_tris[c.remove]) {
+            if (_dead[tri]) {
+                continue;
+            }
+            if (has_vertex(tri, v)) {
+                _dead[tri] = true;  // the collapsed edge was one of its sides
+                --_live_tris;
+                continue;
+            }
+            for (auto& corner : _tris[tri]) {
+                corner = corner == c.remove ? v : corner;
+            }
+            _vert_tris[v].push_back(tri);
+        }
+        _vert_tris[c.remove].clear();
+        _error = std::max(_error, (float)std::sqrt(c.cost));
+
+        // drop dead triangles, and re-evaluate the edges around `v`
+        auto& around = _vert_tris[v];
+        around.erase(std::remove_if(around.begin(),
+                                    around.end(),
+                                    [&](uint32_t tri) { return _dead[tri]; }),
+                     around.end());
+        std::vector<uint32_t> neighbors;
+        for (auto tri : around) {
+            for (auto corner : _tris[tri]) {
+                if (corner != v) {
+                    neighbors.push_back(corner);
+                }
+            }
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()),
+                        neighbors.end());
+        for (auto n : neighbors) {
+            push_collapse(v, n);
+        }
+    }
+}
+
+void MeshSimplifier::append_triangles(std::vector<Vert>& out) const {
+    // area weighted vertex normals
+    std::vector<glm::dvec3> normals(_pos.size(), glm::dvec3{0.});
+    for (size_t tri = 0; tri < _tris.size(); ++tri) {
+        if (_dead[tri]) {
+            continue;
+        }
+        auto& t = _tris[tri];
+        glm::dvec3 n =
+            glm::cross(_pos[t[1]] - _pos[t[0]], _pos[t[2]] - _pos[t[0]]);
+        for (auto corner : t) {
+            normals[corner] += n;
+        }
+    }
+    for (size_t tri = 0; tri < _tris.size(); ++tri) {
+        if (_dead[tri]) {
+            continue;
+        }
+        for (auto corner : _tris[tri]) {
+            glm::dvec3 n = normals[corner];
+            double len = glm::length(n);
+            Vert vert{
+                .pos = _pos[corner],
+                .normal = len > 0. ? n / len : n,
+            };
+            vert.color = vert.normal;  // like Vert::from_idx()
+            out.push_back(vert);
+        }
+    }
+}
+
+void build_lod_chain(Mesh& mesh, LodChainParams const& params) {
+    mesh.lods = {{0, (uint32_t)mesh.verts.size(), 0.f}};
+    MeshSimplifier simplifier{mesh.verts};
+    uint32_t tris = simplifier.triangle_count();
+    std::vector<Vert> lod_verts;
+    while (mesh.lods.size() < params.max_lods) {
+        uint32_t target = tris * params.ratio;
+        if (target < params.min_tris) {
+            break;
+        }
+        simplifier.simplify(target);
+        if (simplifier.triangle_count() > (tris + target) / 2) {
+            break;  // stuck, not worth another copy
+        }
+        tris = simplifier.triangle_count();
+        lod_verts.clear();
+        simplifier.append_triangles(lod_verts);
+        mesh.lods.push_back({
+            .first = (uint32_t)mesh.verts.size(),
+            .count = (uint32_t)lod_verts.size(),
+            .error = simplifier.error(),
+        });
+        mesh.verts.insert(mesh.verts.end(), lod_verts.begin(), lod_verts.end());
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <queue>
+#include <vector>
+#include "vk_mesh.h"
+
+/**
+ * Quadric error edge collapse (Garland & Heckbert) on a triangle list.
+ * Vertices are welded by position, every vertex accumulates the planes of
+ * its triangles, and the edge whose collapse moves the surface least goes
+ * first.  Open borders get extra planes so they don't shrink, and
+ * collapses that would flip a triangle are skipped.
+ *
+ * simplify() can be called with decreasing targets to produce a LOD chain
+ * in one go, see build_lod_chain().
+ */
+class MeshSimplifier {
+   public:
+    /** `tris` is a triangle list, as from Mesh::load_from_obj(). */
+    explicit MeshSimplifier(std::vector<Vert> const& tris);
+
+    /** Collapse edges until at most `target` triangles are left, or stuck. */
+    void simplify(uint32_t target);
+
+    uint32_t triangle_count() const { return _live_tris; }
+
+    /** Distance the surface moved so far, roughly, in model units. */
+    float error() const { return _error; }
+
+    /** Append the current triangles with smooth normals to `out`. */
+    void append_triangles(std::vector<Vert>& out) const;
+
+   private:
+    /** Symmetric 4x4 matrix, sum of squared distances to planes. */
+    struct Quadric {
+        double a[10]{};  // xx xy xz xw yy yz yw zz zw ww
+
+        static Quadric plane(glm::dvec3 n, double d, double weight = 1.);
+        Quadric& operator+=(Quadric const& q);
+        double error(glm::dvec3 p) const;
+    };
+
+    struct Collapse {
+        double cost;
+        uint32_t keep;
+        uint32_t remove;
+        uint32_t keep_version;  // stale if either vertex changed since
+        uint32_t remove_version;
+        glm::dvec3 target;
+
+        bool operator>(Collapse const& c) const { return cost > c.cost; }
+    };
+
+    void push_collapse(uint32_t a, uint32_t b);
+
+    /** Whether moving `v` to `p` flips one of its triangles not on `other`. */
+    bool flips(uint32_t v, uint32_t other, glm::dvec3 p) const;
+
+    bool has_vertex(uint32_t tri, uint32_t v) const;
+
+    std::vector<glm::dvec3> _pos;
+    std::vector<Quadric> _quadrics;
+    std::vector<uint32_t> _version;
+    std::vector<bool> _removed;
+    std::vector<std::vector<uint32_t>> _vert_tris;  // may hold dead ones
+
+    std::vector<std::array<uint32_t, 3>> _tris;
+    std::vector<bool> _dead;
+    uint32_t _live_tris{0};
+
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> _heap;
+    float _error{0.f};
+};
+
+struct LodChainParams {
+    float ratio = 0.5f;       // triangles of each LOD relative to the last
+    uint32_t min_tris = 32;   // don't go coarser than this
+    uint32_t max_lods = 8;    // including the original
+};
+
+/**
+ * Append simplified versions of `mesh` to its vertices, coarsest last, and
+ * list them all in mesh.lods.  LOD 0 is the mesh as it was.
+ */
+void build_lod_chain(Mesh& mesh, LodChainParams const& params);
+inline void build_lod_chain(Mesh& mesh) {
+    build_lod_chain(mesh, LodChainParams{});
+}
+
+#endif  // MESH_SIMPLIFY_H
@@ -2,6 +2,15 @@
 
 #include <iostream>
 
+void PipelineBuilder::set_specialization(VkShaderStageFlagBits stage,
+                                         VkSpecializationInfo const* info) {
+    for (auto& s : _stages) {
+        if (s.stage == stage) {
+            s.pSpecializationInfo = info;
+        }
+    }
+}
+
 VkPipeline PipelineBuilder::build_pipeline(VkDevice device, VkRenderPass pass) {
     // single viewport
     VkPipelineViewportStateCreateInfo viewport_state = {
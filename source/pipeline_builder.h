@@ -2,8 +2,59 @@
 #define PIPELINE_BUILDER_H
 
 #include <vulkan/vulkan.h>
+#include <cstddef>
+#include <type_traits>
 #include <vector>
 
+/**
+ * Maps the fields of a plain struct `T` to specialization constant IDs, e.g.
+ *
+ *   Specialization<PointSpecConstants> spec{consts};
+ *   spec.map(0, &PointSpecConstants::size_mode)
+ *       .map(1, &PointSpecConstants::size);
+ *
+ * The returned VkSpecializationInfo points into this object, so it has to
+ * outlive the pipeline creation.
+ */
+template <typename T>
+class Specialization {
+   public:
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "specialization data is copied byte-wise");
+
+    explicit Specialization(T const& data) : _data{data} {}
+
+    template <typename F>
+    Specialization& map(uint32_t constant_id, F T::*field) {
+        // SPIR-V scalars are 32 bit (bool is VkBool32) or 64 bit wide
+        static_assert(sizeof(F) == 4 || sizeof(F) == 8,
+                      "specialization constants must be 32 or 64 bit");
+        auto base = reinterpret_cast<char const*>(&_data);
+        auto member = reinterpret_cast<char const*>(&(_data.*field));
+        _entries.push_back({
+            .constantID = constant_id,
+            .offset = (uint32_t)(member - base),
+            .size = sizeof(F),
+        });
+        return *this;
+    }
+
+    VkSpecializationInfo const* info() {
+        _info = {
+            .mapEntryCount = (uint32_t)_entries.size(),
+            .pMapEntries = _entries.data(),
+            .dataSize = sizeof(T),
+            .pData = &_data,
+        };
+        return &_info;
+    }
+
+   private:
+    T _data;
+    std::vector<VkSpecializationMapEntry> _entries;
+    VkSpecializationInfo _info;
+};
+
 class PipelineBuilder {
    public:
     std::vector<VkPipelineShaderStageCreateInfo> _stages;
@@ -17,6 +68,13 @@ class PipelineBuilder {
     VkPipelineLayout _layout;
     VkPipelineDepthStencilStateCreateInfo _depth_stencil;
 
+    /**
+     * Attach specialization constants to all stages matching `stage`.
+     * Pass nullptr to build the unspecialized (default constant) variant.
+     */
+    void set_specialization(VkShaderStageFlagBits stage,
+                            VkSpecializationInfo const* info);
+
     VkPipeline build_pipeline(VkDevice device, VkRenderPass pass);
 };
 
@@ -0,0 +1,390 @@
+#include "point_import.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cfloat>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static_assert(sizeof(Vert) == 9 * sizeof(float), "Vert is written as floats");
+
+static PointFile::Converted empty_bounds() {
+    return {0, glm::vec3{FLT_MAX}, glm::vec3{-FLT_MAX}};
+}
+
+static void merge(PointFile::Converted& into,
+                  PointFile::Converted const& part) {
+    into.count += part.count;
+    into.min = glm::min(into.min, part.min);
+    into.max = glm::max(into.max, part.max);
+}
+
+bool PointFile::open(std::string const& path) {
+    _fd = ::open(path.c_str(), O_RDONLY);
+    if (_fd < 0) {
+        std::cerr << "Can't open point cloud '" << path << "'.\n";
+        return false;
+    }
+    struct stat st;
+    fstat(_fd, &st);
+    _map_size = st.st_size;
+    void* map = _map_size > 0
+                    ? mmap(nullptr, _map_size, PROT_READ, MAP_PRIVATE, _fd, 0)
+                    : MAP_FAILED;
+    if (map == MAP_FAILED) {
+        std::cerr << "Can't map point cloud '" << path << "'.\n";
+        close();
+        return false;
+    }
+    _map = (char const*)map;
+    // each thread reads its part front to back
+    madvise(map, _map_size, MADV_SEQUENTIAL);
+
+    std::string_view file{_map, _map_size};
+    if (file.substr(0, 4) == "ply\n" || file.substr(0, 5) == "ply\r\n") {
+        _format = Format::Ply;
+        if (!parse_ply_header()) {
+            std::cerr << "'" << path << "' is not a binary little endian "
+                      << "PLY point cloud.\n";
+            close();
+            return false;
+        }
+    } else {
+        _format = Format::Xyz;
+        index_xyz_lines();
+    }
+    return true;
+}
+
+void PointFile::close() {
+    if (_map) {
+        munmap((void*)_map, _map_size);
+        _map = nullptr;
+    }
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+    _count = 0;
+    _props.clear();
+    _range_begin.clear();
+    _range_first.clear();
+}
+
+PointFile::Converted PointFile::convert(Vert* dst) const {
+    Converted total = empty_bounds();
+
+    if (_format == Format::Ply) {
+        // blocks small enough to balance, large enough to stream
+        const size_t block = 1 << 18;
+        size_t blocks = (_count + block - 1) / block;
+        std::vector<Converted> parts(blocks);
+        _jobs.parallel_for(blocks, 1, [&](size_t b, size_t) {
+            parts[b] = convert_ply(
+                dst, b * block, std::min(_count, (b + 1) * block));
+        });
+        for (auto& part : parts) {
+            merge(total, part);
+        }
+        return total;
+    }
+
+    size_t ranges = _range_first.size();
+    std::vector<Converted> parts(ranges);
+    _jobs.parallel_for(ranges, 1, [&](size_t r, size_t) {
+        parts[r] = convert_xyz(dst, r);
+    });
+    // close the gaps left by lines that didn't parse
+    for (size_t r = 0; r < ranges; ++r) {
+        if (total.count != _range_first[r] && parts[r].count > 0) {
+            memmove(dst + total.count,
+                    dst + _range_first[r],
+                    parts[r].count * sizeof(Vert));
+        }
+        merge(total, parts[r]);
+    }
+    return total;
+}
+
+// PLY
+
+bool PointFile::parse_ply_header() {
+    struct PlyType {
+        char const* name;
+        Type type;
+        uint32_t size;
+        float max;  // to normalize integer colors
+    };
+    static const PlyType types[] = {
+        {"char", Type::I8, 1, 127.f},
+        {"int8", Type::I8, 1, 127.f},
+        {"uchar", Type::U8, 1, 255.f},
+        {"uint8", Type::U8, 1, 255.f},
+        {"short", Type::I16, 2, 32767.f},
+        {"int16", Type::I16, 2, 32767.f},
+        {"ushort", Type::U16, 2, 65535.f},
+        {"uint16", Type::U16, 2, 65535.f},
+        {"int", Type::I32, 4, 2147483647.f},
+        {"int32", Type::I32, 4, 2147483647.f},
+        {"uint", Type::U32, 4, 4294967295.f},
+        {"uint32", Type::U32, 4, 4294967295.f},
+        {"float", Type::F32, 4, 1.f},
+        {"float32", Type::F32, 4, 1.f},
+        {"double", Type::F64, 8, 1.f},
+        {"float64", Type::F64, 8, 1.f},
+    };
+    // float index within Vert
+    static const std::pair<char const*, int32_t> targets[] = {
+        {"x", 0},     {"y", 1},     {"z", 2},    {"nx", 3},
+        {"ny", 4},    {"nz", 5},    {"red", 6},  {"green", 7},
+        {"blue", 8},  {"r", 6},     {"g", 7},    {"b", 8},
+    };
+
+    std::string_view file{_map, _map_size};
+    size_t end = file.find("end_header");
+    size_t data = end == file.npos ? end : file.find('\n', end);
+    if (data == file.npos) {
+        return false;
+    }
+    _data_offset = data + 1;
+
+    std::istringstream header{std::string{file.substr(0, end)}};
+    std::string line;
+    bool little_endian = false;
+    bool in_vertex = false;
+    bool seen_vertex = false;
+    uint32_t offset = 0;
+    uint32_t has_pos = 0;  // bit per axis
+    while (std::getline(header, line)) {
+        std::istringstream words{line};
+        std::string word;
+        words >> word;
+        if (word == "format") {
+            words >> word;
+            little_endian = word == "binary_little_endian";
+        } else if (word == "element") {
+            std::string name;
+            size_t count = 0;
+            words >> name >> count;
+            if (seen_vertex) {
+                in_vertex = false;  // faces etc. come after, ignore them
+            } else if (name == "vertex") {
+                in_vertex = seen_vertex = true;
+                _count = count;
+            } else if (count > 0) {
+                return false;  // would have to skip it to find the vertices
+            }
+        } else if (word == "property" && in_vertex) {
+            std::string type, name;
+            words >> type >> name;
+            auto t = std::find_if(std::begin(types),
+                                  std::end(types),
+                                  [&](auto& t) { return type == t.name; });
+            if (t == std::end(types)) {
+                return false;  // lists, e.g. per-vertex indices
+            }
+            for (auto& [target_name, target] : targets) {
+                if (name != target_name) {
+                    continue;
+                }
+                _props.push_back({
+                    .type = t->type,
+                    .offset = offset,
+                    .target = target,
+                    .scale = target >= 6 ? 1.f / t->max : 1.f,
+                });
+                if (target < 3) {
+                    has_pos |= 1 << target;
+                }
+            }
+            offset += t->size;
+        }
+    }
+    _stride = offset;
+    if (!little_endian || has_pos != 0b111 ||
+        _data_offset + _count * _stride > _map_size) {
+        return false;
+    }
+
+    // the usual layout: positions are copied as they are
+    auto packed = [&](Property const& p) {
+        return p.target < 3 && p.type == Type::F32 &&
+               p.offset == p.target * sizeof(float);
+    };
+    _packed_pos = std::count_if(_props.begin(), _props.end(), packed) == 3;
+    if (_packed_pos) {
+        _props.erase(std::remove_if(_props.begin(), _props.end(), packed),
+                     _props.end());
+    }
+    return true;
+}
+
+template <class T>
+static float load_as(char const* p) {
+    T v;
+    memcpy(&v, p, sizeof(T));  // unaligned
+    return (float)v;
+}
+
+PointFile::Converted PointFile::convert_ply(Vert* dst,
+                                            size_t first,
+                                            size_t end) const {
+    Converted out = empty_bounds();
+    char const* src = _map + _data_offset + first * _stride;
+    for (size_t i = first; i < end; ++i, src += _stride) {
+        Vert v = {
+            .normal = {0, 0, 0},
+            .color = {1, 1, 1},
+        };
+        if (_packed_pos) {
+            memcpy(&v.pos, src, sizeof(v.pos));
+        }
+        float* f = (float*)&v;
+        for (auto& p : _props) {
+            float value = 0;
+            char const* s = src + p.offset;
+            switch (p.type) {
+                case Type::I8: value = load_as<int8_t>(s); break;
+                case Type::U8: value = load_as<uint8_t>(s); break;
+                case Type::I16: value = load_as<int16_t>(s); break;
+                case Type::U16: value = load_as<uint16_t>(s); break;
+                case Type::I32: value = load_as<int32_t>(s); break;
+                case Type::U32: value = load_as<uint32_t>(s); break;
+                case Type::F32: value = load_as<float>(s); break;
+                case Type::F64: value = load_as<double>(s); break;
+            }
+            f[p.target] = value * p.scale;
+        }
+        out.min = glm::min(out.min, v.pos);
+        out.max = glm::max(out.max, v.pos);
+        dst[i] = v;  // one sequential write, staging may be write-combined
+    }
+    out.count = end - first;
+    return out;
+}
+
+// XYZ
+
+/** Number of '\n' in [p, end). */
+static size_t count_newlines(char const* p, char const* end) {
+    size_t n = 0;
+#ifdef __SSE2__
+    // 16 bytes per compare, the scan runs at memory speed
+    __m128i newline = _mm_set1_epi8('\n');
+    for (; p + 16 <= end; p += 16) {
+        __m128i bytes = _mm_loadu_si128((__m128i const*)p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline));
+        n += __builtin_popcount(mask);
+    }
+#endif
+    return n + std::count(p, end, '\n');
+}
+
+/**
+ * Parse up to 6 numbers separated by spaces, tabs or commas from the line
+ * at `p`, and move `p` to the next line.  Returns how many, 0 if the line
+ * has anything else on it.
+ */
+static int parse_line(char const*& p, char const* end, float* values) {
+    int n = 0;
+    while (p < end && *p != '\n') {
+        char c = *p;
+        if (c == ' ' || c == '\t' || c == ',' || c == '\r') {
+            ++p;
+            continue;
+        }
+        float value;
+        auto [next, err] = std::from_chars(p, end, value);
+        if (err != std::errc{}) {
+            n = 0;  // a header or a comment
+            p = (char const*)memchr(p, '\n', end - p);
+            p = p ? p : end;
+            break;
+        }
+        if (n < 6) {
+            values[n++] = value;
+        }
+        p = next;
+    }
+    if (p < end) {
+        ++p;  // '\n'
+    }
+    return n;
+}
+
+void PointFile::index_xyz_lines() {
+    // ranges of about 16 MB, starting at line breaks
+    const size_t range_size = 16 << 20;
+    size_t ranges = std::max<size_t>(1, _map_size / range_size);
+    _range_begin.assign(1, 0);
+    for (size_t r = 1; r < ranges; ++r) {
+        size_t begin = std::max(r * _map_size / ranges, _range_begin.back());
+        auto nl = (char const*)memchr(_map + begin, '\n', _map_size - begin);
+        _range_begin.push_back(nl ? nl + 1 - _map : _map_size);
+    }
+    _range_begin.push_back(_map_size);
+
+    // the line count of each range places it in the output
+    _range_first.assign(ranges, 0);
+    _jobs.parallel_for(ranges, 1, [&](size_t r, size_t) {
+        _range_first[r] = count_newlines(_map + _range_begin[r],
+                                         _map + _range_begin[r + 1]);
+    });
+    if (_map[_map_size - 1] != '\n') {
+        ++_range_first.back();  // unterminated last line
+    }
+    _count = 0;
+    for (auto& first : _range_first) {
+        size_t lines = first;
+        first = _count;
+        _count += lines;
+    }
+
+    // colors are either 0-1 or 0-255, guess from the first lines
+    _color_scale = 1.f;
+    char const* p = _map;
+    char const* end = _map + std::min<size_t>(_map_size, 1 << 16);
+    while (p < end) {
+        float v[6];
+        if (parse_line(p, end, v) == 6 &&
+            std::max({v[3], v[4], v[5]}) > 1.f) {
+            _color_scale = 1.f / 255.f;
+            break;
+        }
+    }
+}
+
+PointFile::Converted PointFile::convert_xyz(Vert* dst, size_t r) const {
+    Converted out = empty_bounds();
+    char const* p = _map + _range_begin[r];
+    char const* end = _map + _range_begin[r + 1];
+    Vert* next = dst + _range_first[r];
+    while (p < end) {
+        float v[6];
+        int n = parse_line(p, end, v);
+        if (n < 3) {
+            continue;  // blank or not a point
+        }
+        Vert vert = {
+            .pos = {v[0], v[1], v[2]},
+            .normal = {0, 0, 0},
+            .color = {1, 1, 1},
+        };
+        if (n == 6) {
+            vert.color = glm::vec3{v[3], v[4], v[5]} * _color_scale;
+        }
+        out.min = glm::min(out.min, vert.pos);
+        out.max = glm::max(out.max, vert.pos);
+        *next++ = vert;
+    }
+    out.count = next - (dst + _range_first[r]);
+    return out;
+}
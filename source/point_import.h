@@ -0,0 +1,92 @@
+#ifndef POINT_IMPORT_H
+#define POINT_IMPORT_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "job_system.h"
+#include "vk_mesh.h"
+
+/**
+ * A point cloud file, memory-mapped and converted straight into the
+ * engine's vertex layout, e.g. into a mapped staging buffer:
+ *
+ *   PointFile file{jobs};
+ *   if (file.open(path)) {
+ *       // map a staging buffer of file.count() vertices
+ *       auto result = file.convert((Vert*)mapped_staging);
+ *   }
+ *
+ * Supported are binary little endian PLY (a "vertex" element with x/y/z,
+ * optionally nx/ny/nz and red/green/blue, in any scalar type) and ASCII
+ * XYZ with "x y z" or "x y z r g b" per line (colors 0-255 or 0-1).
+ */
+class PointFile {
+   public:
+    struct Converted {
+        size_t count;
+        glm::vec3 min;  // bounds of the positions
+        glm::vec3 max;
+    };
+
+    /** Parsing and conversion run as jobs on `jobs`. */
+    explicit PointFile(JobSystem& jobs) : _jobs{jobs} {}
+    ~PointFile() { close(); }
+
+    bool open(std::string const& path);
+    void close();
+
+    size_t count() const { return _count; }
+
+    /**
+     * Write the vertices to `dst`, which has room for count(), in parallel.
+     * Fewer than count() are written if the file has lines that don't
+     * parse.
+     */
+    Converted convert(Vert* dst) const;
+
+   private:
+    enum class Format { Ply, Xyz };
+
+    enum class Type : uint8_t { I8, U8, I16, U16, I32, U32, F32, F64 };
+
+    /** A PLY property that ends up in the vertex. */
+    struct Property {
+        Type type;
+        uint32_t offset;  // within the PLY vertex
+        int32_t target;   // float index within Vert
+        float scale;      // e.g. 1/255 for 8 bit colors
+    };
+
+    bool parse_ply_header();
+    void index_xyz_lines();
+
+    /** Convert vertices [first, end). */
+    Converted convert_ply(Vert* dst, size_t first, size_t end) const;
+    /** Convert range `r` to dst + _range_first[r]. */
+    Converted convert_xyz(Vert* dst, size_t r) const;
+
+    JobSystem& _jobs;
+    int _fd{-1};
+    char const* _map{nullptr};
+    size_t _map_size{0};
+
+    Format _format{Format::Ply};
+    size_t _count{0};
+
+    // PLY
+    size_t _data_offset{0};
+    uint32_t _stride{0};
+    std::vector<Property> _props;
+    bool _packed_pos{false};  // float x, y, z at offset 0
+
+    // XYZ: the file is split into ranges at line breaks, converted in
+    // parallel.  Range r starts at byte _range_begin[r] and at vertex
+    // _range_first[r].
+    std::vector<size_t> _range_begin;
+    std::vector<size_t> _range_first;
+    float _color_scale{1.f};
+};
+
+#endif  // POINT_IMPORT_H
@@ -0,0 +1,317 @@
+#include "point_ingest.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <glm/gtc/constants.hpp>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+/** A UNIX socket address for `path`, false if it's too long. */
+bool socket_address(std::string const& path, sockaddr_un& addr) {
+    addr = {.sun_family = AF_UNIX};
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Socket path '" << path << "' is too long.\n";
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool is_fifo(std::string const& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+}  // namespace
+
+bool PointIngest::open(std::string const& path, uint32_t ring_points) {
+    close();
+    _ring.reset(ring_points);
+    _quit = false;
+
+    if (path == "-") {
+        _fd = dup(STDIN_FILENO);
+    } else if (is_fifo(path)) {
+        // don't wait for a writer here, see wait_readable()
+        _fd = ::open(path.c_str(), O_RDONLY | O_NONBLOCK);
+        if (_fd < 0) {
+            std::cerr << "Can't open pipe '" << path << "'.\n";
+            return false;
+        }
+    } else {
+        sockaddr_un addr;
+        if (!socket_address(path, addr)) {
+            return false;
+        }
+        // a socket left behind by an earlier run, but nothing else
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(path.c_str());
+        }
+        _listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (_listen_fd < 0 ||
+            bind(_listen_fd, (sockaddr const*)&addr, sizeof(addr)) < 0 ||
+            listen(_listen_fd, 1) < 0) {
+            std::cerr << "Can't listen on '" << path
+                      << "': " << strerror(errno) << ".\n";
+            close();
+            return false;
+        }
+        _socket_path = path;
+        std::cout << "Waiting for points on '" << path << "'.\n";
+    }
+    _thread = std::thread(&PointIngest::reader, this);
+    return true;
+}
+
+void PointIngest::close() {
+    _quit = true;
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+    if (_listen_fd >= 0) {
+        ::close(_listen_fd);
+        _listen_fd = -1;
+        unlink(_socket_path.c_str());
+        _socket_path.clear();
+    }
+}
+
+PointIngest::Stats PointIngest::stats() const {
+    return {
+        .packets = _packets.load(std::memory_order_relaxed),
+        .points = _points.load(std::memory_order_relaxed),
+        .dropped = _dropped.load(std::memory_order_relaxed),
+    };
+}
+
+void PointIngest::reader() {
+    if (_fd >= 0) {
+        read_packets(_fd);  // a pipe ends with its writer
+        return;
+    }
+    while (!_quit) {
+        if (!wait_readable(_listen_fd)) {
+            continue;
+        }
+        int fd = accept(_listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        // room for bursts while this thread is descheduled
+        int buf_size = 8 << 20;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+        std::cout << "Point producer connected.\n";
+        read_packets(fd);
+        ::close(fd);
+        std::cout << "Point producer hung up.\n";
+    }
+}
+
+void PointIngest::read_packets(int fd) {
+    // whole packets are parsed out, a partial one is kept for the next read
+    std::vector<uint8_t> buf(1 << 20);
+    size_t have = 0;
+    uint32_t left = 0;  // points still to come in the current packet
+    while (!_quit) {
+        if (!wait_readable(fd)) {
+            continue;
+        }
+        ssize_t n = read(fd, buf.data() + have, buf.size() - have);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        have += n;
+
+        size_t pos = 0;
+        while (true) {
+            if (left == 0) {
+                if (have - pos < sizeof(IngestPacket)) {
+                    break;
+                }
+                IngestPacket packet;
+                memcpy(&packet, buf.data() + pos, sizeof(packet));
+                if (packet.magic != INGEST_MAGIC) {
+                    std::cerr << "Bad point packet, hanging up.\n";
+                    return;
+                }
+                pos += sizeof(packet);
+                left = packet.count;
+                _packets.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            size_t count =
+                std::min<size_t>(left, (have - pos) / sizeof(Vert));
+            if (count == 0) {
+                break;
+            }
+            // packets and Verts are multiples of 4 bytes, so it's aligned
+            size_t queued =
+                _ring.push((Vert const*)(buf.data() + pos), count);
+            _points.fetch_add(queued, std::memory_order_relaxed);
+            _dropped.fetch_add(count - queued, std::memory_order_relaxed);
+            pos += count * sizeof(Vert);
+            left -= count;
+        }
+        memmove(buf.data(), buf.data() + pos, have - pos);
+        have -= pos;
+    }
+}
+
+bool PointIngest::wait_readable(int fd) const {
+    pollfd p = {.fd = fd, .events = POLLIN};
+    return poll(&p, 1, 100) > 0;  // so close() isn't kept waiting
+}
+
+namespace {
+
+/** Write all of `data`, false once the receiver is gone. */
+bool write_all(int fd, uint8_t const* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+/** Distance along a unit `dir` from `from` to a sphere, or -1. */
+float hit_sphere(glm::vec3 from, glm::vec3 dir, glm::vec3 center, float r) {
+    glm::vec3 oc = from - center;
+    float b = glm::dot(oc, dir);
+    float c = glm::dot(oc, oc) - r * r;
+    float disc = b * b - c;
+    if (disc < 0.f) {
+        return -1.f;
+    }
+    float t = -b - std::sqrt(disc);
+    return t > 0.f ? t : -1.f;
+}
+
+}  // namespace
+
+int run_ingest_producer(std::string const& path,
+                        uint32_t points_per_second,
+                        uint32_t packet_points) {
+    // a receiver hanging up is a write error, not a signal
+    signal(SIGPIPE, SIG_IGN);
+    int fd = -1;
+    if (path == "-") {
+        fd = dup(STDOUT_FILENO);
+    } else if (is_fifo(path)) {
+        fd = ::open(path.c_str(), O_WRONLY);
+    } else {
+        sockaddr_un addr;
+        if (!socket_address(path, addr)) {
+            return 1;
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 &&
+            connect(fd, (sockaddr const*)&addr, sizeof(addr)) < 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        // stdout may be the stream, so messages go to stderr
+        std::cerr << "Can't send points to '" << path
+                  << "': " << strerror(errno) << ".\n";
+        return 1;
+    }
+
+    // 32 beams from 25 degrees down to 5 up, spinning at 10 Hz, 1.8 units
+    // above a ground plane inside a 30 unit cylinder, with three spheres
+    // circling the scanner
+    const uint32_t beams = 32;
+    const float spin_hz = 10.f;
+    const glm::vec3 origin{0.f, 1.8f, 0.f};
+    const float wall = 30.f;
+    float columns_per_second = std::max(1u, points_per_second / beams);
+    float az_step = 2.f * glm::pi<float>() * spin_hz / columns_per_second;
+
+    std::vector<uint8_t> packet(sizeof(IngestPacket) +
+                                (size_t)packet_points * sizeof(Vert));
+    Vert* verts = (Vert*)(packet.data() + sizeof(IngestPacket));
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sent = 0;
+    while (true) {
+        for (uint32_t i = 0; i < packet_points; ++i) {
+            uint64_t n = sent + i;
+            uint64_t column = n / beams;
+            float t = column / columns_per_second;
+            float el = glm::radians(-25.f + 30.f * (n % beams) / (beams - 1));
+            float az = column * az_step;
+            glm::vec3 dir = {std::cos(el) * std::sin(az),
+                             std::sin(el),
+                             std::cos(el) * std::cos(az)};
+
+            float dist = wall / std::cos(el);
+            glm::vec3 color = {0.6f, 0.6f, 0.7f};
+            if (dir.y < 0.f && origin.y / -dir.y < dist) {
+                dist = origin.y / -dir.y;
+                color = {0.3f, 0.5f, 0.3f};
+            }
+            for (int k = 0; k < 3; ++k) {
+                float angle = 0.5f * t + k * 2.f * glm::pi<float>() / 3;
+                glm::vec3 center = {8.f * std::cos(angle),
+                                    1.f,
+                                    8.f * std::sin(angle)};
+                float hit = hit_sphere(origin, dir, center, 1.5f);
+                if (hit > 0.f && hit < dist) {
+                    dist = hit;
+                    color = glm::vec3{k == 0, k == 1, k == 2} * 0.8f + 0.2f;
+                }
+            }
+            verts[i] = {
+                .pos = origin + dir * dist,
+                .normal = -dir,
+                .color = color,
+            };
+        }
+        IngestPacket header = {
+            .magic = INGEST_MAGIC,
+            .count = packet_points,
+            .timestamp_ns = (uint64_t)std::chrono::duration_cast<
+                                std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start)
+                                .count(),
+        };
+        memcpy(packet.data(), &header, sizeof(header));
+        if (!write_all(fd, packet.data(), packet.size())) {
+            break;
+        }
+        sent += packet_points;
+
+        // keep to the rate on average
+        std::this_thread::sleep_until(
+            start + std::chrono::duration<double>((double)sent /
+                                                  points_per_second));
+    }
+    ::close(fd);
+    std::cerr << "Sent " << sent << " points.\n";
+    return 0;
+}
@@ -0,0 +1,85 @@
+#ifndef POINT_INGEST_H
+#define POINT_INGEST_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include "spsc_ring.h"
+#include "vk_mesh.h"
+
+/*
+ * Live point stream, little endian, packets back to back:
+ *   IngestPacket
+ *   Vert[count]
+ */
+#define INGEST_MAGIC 0x31545050u  // "PPT1"
+
+struct IngestPacket {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t timestamp_ns;  // capture time, producer's clock
+};
+
+/**
+ * Receives points from a capture process on a background thread and
+ * queues them for the main thread through a lock-free ring.  The source
+ * is a UNIX stream socket this listens on (one producer at a time, the
+ * next may connect once it hangs up), a named pipe, or standard input
+ * for "-".
+ *
+ * take() never waits.  When the main thread falls behind and the ring
+ * fills up, newly received points are dropped and counted, rather than
+ * stalling the sender.
+ */
+class PointIngest {
+   public:
+    struct Stats {
+        uint64_t packets;
+        uint64_t points;   // queued
+        uint64_t dropped;  // ring full
+    };
+
+    ~PointIngest() { close(); }
+
+    bool open(std::string const& path, uint32_t ring_points = 1 << 22);
+    void close();
+
+    /** Move up to `max` queued points to `out`, oldest first. */
+    size_t take(Vert* out, size_t max) { return _ring.pop(out, max); }
+
+    Stats stats() const;
+
+   private:
+    void reader();
+
+    /** Parse packets from `fd` into the ring until it hangs up or quit. */
+    void read_packets(int fd);
+
+    /** Wait up to 100 ms for `fd` to be readable, false if it isn't. */
+    bool wait_readable(int fd) const;
+
+    std::string _socket_path;  // to unlink, if listening
+    int _listen_fd{-1};
+    int _fd{-1};  // pipe or stdin
+
+    SpscRing<Vert> _ring;
+    std::atomic<bool> _quit{false};
+    std::atomic<uint64_t> _packets{0};
+    std::atomic<uint64_t> _points{0};
+    std::atomic<uint64_t> _dropped{0};
+    std::thread _thread;
+};
+
+/**
+ * Stand-in for a capture process: a spinning multi-beam scanner over a
+ * ground plane and a few moving objects, sent to `path` (a socket to
+ * connect to, a named pipe, or "-" for standard output) as IngestPackets
+ * of `packet_points` at `points_per_second`.  Runs until the receiver
+ * hangs up.
+ */
+int run_ingest_producer(std::string const& path,
+                        uint32_t points_per_second,
+                        uint32_t packet_points = 4096);
+
+#endif  // POINT_INGEST_H
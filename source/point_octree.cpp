@@ -0,0 +1,190 @@
+#include "point_octree.h"
+#include <algorithm>
+#include <queue>
+#include "frustum.h"
+#include "job_system.h"
+#include "point_sort.h"
+
+void PointOctree::build(std::vector<Vert>& verts,
+                        JobSystem& jobs,
+                        Params const& params) {
+    _params = params;
+    _nodes.clear();
+    _depth = 0;
+    if (verts.empty()) {
+        return;
+    }
+
+    // root is the bounding cube, padded so no point sits on the far faces
+    glm::vec3 lo = verts[0].pos;
+    glm::vec3 hi = verts[0].pos;
+    for (auto& v : verts) {
+        lo = glm::min(lo, v.pos);
+        hi = glm::max(hi, v.pos);
+    }
+    glm::vec3 extent = hi - lo;
+    float size = std::max({extent.x, extent.y, extent.z}) * 1.001f + 1e-6f;
+
+    std::vector<uint32_t> idx(verts.size());
+    for (uint32_t i = 0; i < idx.size(); ++i) {
+        idx[i] = i;
+    }
+    std::vector<uint32_t> order;
+    order.reserve(verts.size());
+    build_node(verts, std::move(idx), lo, size, 0, order);
+
+    // Node first, then Morton order within the node's cube.  Nodes are
+    // numbered in pre-order, so they keep their ranges; their points get
+    // close in memory if they're close in space.
+    const uint32_t morton_bits = 13;  // per axis, leaving 25 for the node
+    std::vector<uint64_t> keys(order.size());
+    jobs.parallel_for(_nodes.size(), 16, [&](size_t begin, size_t end) {
+        for (size_t n = begin; n < end; ++n) {
+            auto& node = _nodes[n];
+            auto& range = node.points;
+            for (uint32_t i = range.first; i < range.first + range.count;
+                 ++i) {
+                glm::vec3 rel = (verts[order[i]].pos - node.min) / node.size;
+                keys[i] = n << 3 * morton_bits | morton_code(rel, morton_bits);
+            }
+        }
+    });
+    std::vector<uint32_t> sorted_order;
+    radix_sort(keys, sorted_order, jobs);
+
+    std::vector<Vert> sorted(verts.size());
+    jobs.parallel_for(order.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            sorted[i] = verts[order[sorted_order[i]]];
+        }
+    });
+    verts = std::move(sorted);
+}
+
+int32_t PointOctree::build_node(std::vector<Vert> const& verts,
+                                std::vector<uint32_t>&& idx,
+                                glm::vec3 min,
+                                float size,
+                                uint32_t level,
+                                std::vector<uint32_t>& order) {
+    int32_t n = _nodes.size();
+    _nodes.push_back({
+        .min = min,
+        .size = size,
+        .points = {(uint32_t)order.size(), 0},
+        .level = level,
+    });
+    std::fill_n(_nodes[n].children, 8, -1);
+    _depth = std::max(_depth, level + 1);
+
+    if (idx.size() <= _params.leaf_size || level + 1 >= _params.max_depth) {
+        order.insert(order.end(), idx.begin(), idx.end());
+        _nodes[n].points.count = idx.size();
+        return n;
+    }
+
+    // first point per grid cell stays here, the rest goes to the octants
+    uint32_t res = _params.grid_res;
+    std::vector<bool> taken(res * res * res, false);
+    std::vector<uint32_t> octants[8];
+    float half = size / 2;
+    for (auto i : idx) {
+        glm::vec3 rel = (verts[i].pos - min) / size;
+        glm::uvec3 cell =
+            glm::min(glm::uvec3(glm::max(rel, 0.f) * (float)res), res - 1);
+        uint32_t c = (cell.z * res + cell.y) * res + cell.x;
+        if (!taken[c]) {
+            taken[c] = true;
+            order.push_back(i);
+            continue;
+        }
+        int o = (cell.x >= res / 2) | (cell.y >= res / 2) << 1 |
+                (cell.z >= res / 2) << 2;
+        octants[o].push_back(i);
+    }
+    _nodes[n].points.count = order.size() - _nodes[n].points.first;
+    idx = {};  // free before recursing
+
+    for (int o = 0; o < 8; ++o) {
+        if (octants[o].empty()) {
+            continue;
+        }
+        glm::vec3 offset(o & 1, (o >> 1) & 1, (o >> 2) & 1);
+        int32_t child = build_node(verts,
+                                   std::move(octants[o]),
+                                   min + offset * half,
+                                   half,
+                                   level + 1,
+                                   order);
+        _nodes[n].children[o] = child;  // _nodes may have grown
+    }
+    return n;
+}
+
+float PointOctree::projected_spacing(OctreeNode const& node,
+                                     glm::vec3 cam_pos,
+                                     float px_per_unit) const {
+    glm::vec3 center = node.min + node.size / 2;
+    float radius = node.size * 0.8660254f;  // half the cube's diagonal
+    float dist = std::max(glm::length(center - cam_pos) - radius, 1e-3f);
+    float spacing = node.size / _params.grid_res;
+    return spacing / dist * px_per_unit;
+}
+
+uint32_t PointOctree::select(glm::mat4 const& viewproj,
+                             glm::vec3 cam_pos,
+                             float px_per_unit,
+                             float max_spacing_px,
+                             uint32_t point_budget,
+                             std::vector<PointRange>& out) const {
+    if (_nodes.empty()) {
+        return 0;
+    }
+
+    Frustum frustum{viewproj};
+
+    // coarsest looking nodes first
+    using Entry = std::pair<float, int32_t>;
+    std::priority_queue<Entry> queue;
+    auto& root = _nodes[0];
+    if (frustum.intersects_cube(root.min, root.size)) {
+        queue.push({projected_spacing(root, cam_pos, px_per_unit), 0});
+    }
+
+    std::vector<PointRange> selected;
+    uint32_t points = 0;
+    while (!queue.empty()) {
+        auto [spacing, n] = queue.top();
+        queue.pop();
+        auto& node = _nodes[n];
+        if (points + node.points.count > point_budget) {
+            break;  // children can't be drawn without their parent
+        }
+        selected.push_back(node.points);
+        points += node.points.count;
+
+        if (spacing <= max_spacing_px) {
+            continue;  // dense enough
+        }
+        for (auto c : node.children) {
+            if (c >= 0 &&
+                frustum.intersects_cube(_nodes[c].min, _nodes[c].size)) {
+                queue.push(
+                    {projected_spacing(_nodes[c], cam_pos, px_per_unit), c});
+            }
+        }
+    }
+
+    // pre-order layout: a parent followed by its first child is one range
+    std::sort(selected.begin(), selected.end(), [](auto a, auto b) {
+        return a.first < b.first;
+    });
+    for (auto& r : selected) {
+        if (!out.empty() && out.back().first + out.back().count == r.first) {
+            out.back().count += r.count;
+        } else {
+            out.push_back(r);
+        }
+    }
+    return points;
+}
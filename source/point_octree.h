@@ -0,0 +1,84 @@
+#ifndef POINT_OCTREE_H
+#define POINT_OCTREE_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include "vk_mesh.h"
+
+class JobSystem;
+
+struct OctreeNode {
+    glm::vec3 min;  // cube corner
+    float size;     // edge length
+    PointRange points;
+    int32_t children[8];  // node indices, -1 if empty
+    uint32_t level;
+};
+
+/**
+ * Level of detail for point clouds.  Every node keeps a spatially uniform
+ * subsample of the points inside it (at most one per cell of a
+ * `grid_res`^3 grid), and passes the rest on to its children.  Detail is
+ * additive: drawing a node and its children shows all their points.
+ *
+ * build() reorders the vertices so that each node's points are contiguous
+ * (pre-order, so a subtree is one range) and in Morton order within the
+ * node, and select() picks the ranges to draw for a camera within a point
+ * budget.
+ */
+class PointOctree {
+   public:
+    struct Params {
+        uint32_t grid_res = 32;     // sampling grid per node and axis
+        uint32_t leaf_size = 8192;  // don't split nodes smaller than this
+        uint32_t max_depth = 16;    // guards against duplicate points
+    };
+
+    /** Build over `verts`, which are reordered in place on `jobs`. */
+    void build(std::vector<Vert>& verts,
+               JobSystem& jobs,
+               Params const& params);
+    void build(std::vector<Vert>& verts, JobSystem& jobs) {
+        build(verts, jobs, Params{});
+    }
+
+    /**
+     * Append the ranges to draw to `out`, merging adjacent ones, and return
+     * the number of points.  Nodes are refined, most coarse on screen
+     * first, until their points are at most `max_spacing_px` apart or the
+     * budget is used up.  Nodes outside the frustum are culled.
+     *
+     * `viewproj` and `cam_pos` are in the point cloud's model space.
+     * `px_per_unit` is the screen-space size of one unit at distance 1,
+     * i.e. viewport height / (2 tan(fov_y / 2)).
+     */
+    uint32_t select(glm::mat4 const& viewproj,
+                    glm::vec3 cam_pos,
+                    float px_per_unit,
+                    float max_spacing_px,
+                    uint32_t point_budget,
+                    std::vector<PointRange>& out) const;
+
+    std::vector<OctreeNode> const& nodes() const { return _nodes; }
+    uint32_t depth() const { return _depth; }
+
+   private:
+    int32_t build_node(std::vector<Vert> const& verts,
+                       std::vector<uint32_t>&& idx,
+                       glm::vec3 min,
+                       float size,
+                       uint32_t level,
+                       std::vector<uint32_t>& order);
+
+    /** Point spacing of a node in pixels, seen from `cam_pos`. */
+    float projected_spacing(OctreeNode const& node,
+                            glm::vec3 cam_pos,
+                            float px_per_unit) const;
+
+    Params _params;
+    std::vector<OctreeNode> _nodes;  // [0] is the root
+    uint32_t _depth{0};
+};
+
+#endif  // POINT_OCTREE_H
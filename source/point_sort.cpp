@@ -0,0 +1,172 @@
+#include "point_sort.h"
+#include <algorithm>
+#include <cfloat>
+#include "job_system.h"
+
+namespace {
+
+/** Put two zero bits between each of the low 21 bits of `x`. */
+uint64_t spread_bits(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffff;
+    x = (x | x << 16) & 0x1f0000ff0000ff;
+    x = (x | x << 8) & 0x100f00f00f00f00f;
+    x = (x | x << 4) & 0x10c30c30c30c30c3;
+    x = (x | x << 2) & 0x1249249249249249;
+    return x;
+}
+
+}  // namespace
+
+uint64_t morton_code(glm::vec3 rel, uint32_t bits) {
+    uint32_t cells = 1u << bits;
+    return morton_code(glm::min(
+        glm::uvec3(glm::clamp(rel, 0.f, 1.f) * (float)cells), cells - 1));
+}
+
+uint64_t morton_code(glm::uvec3 cell) {
+    return spread_bits(cell.x) | spread_bits(cell.y) << 1 |
+           spread_bits(cell.z) << 2;
+}
+
+void point_bounds(Vert const* points,
+                  size_t count,
+                  JobSystem& jobs,
+                  glm::vec3& min,
+                  glm::vec3& max) {
+    min = glm::vec3{FLT_MAX};
+    max = glm::vec3{-FLT_MAX};
+    if (count == 0) {
+        return;
+    }
+    // a box per batch, then theirs
+    const size_t batch = 1 << 16;
+    size_t batches = (count + batch - 1) / batch;
+    std::vector<glm::vec3> lo(batches, glm::vec3{FLT_MAX});
+    std::vector<glm::vec3> hi(batches, glm::vec3{-FLT_MAX});
+    jobs.parallel_for(count, batch, [&](size_t begin, size_t end) {
+        size_t b = begin / batch;
+        for (size_t i = begin; i < end; ++i) {
+            lo[b] = glm::min(lo[b], points[i].pos);
+            hi[b] = glm::max(hi[b], points[i].pos);
+        }
+    });
+    for (size_t b = 0; b < batches; ++b) {
+        min = glm::min(min, lo[b]);
+        max = glm::max(max, hi[b]);
+    }
+}
+
+void radix_sort(std::vector<uint64_t>& keys,
+                std::vector<uint32_t>& order,
+                JobSystem& jobs) {
+    size_t n = keys.size();
+    order.resize(n);
+    if (n == 0) {
+        return;
+    }
+
+    // a few batches per worker, each with its own histogram
+    size_t batch = std::max<size_t>(1 << 14, n / (jobs.worker_count() * 4));
+    size_t batches = (n + batch - 1) / batch;
+
+    // bits that differ anywhere, so passes over constant digits are skipped
+    std::vector<uint64_t> differ(batches, 0);
+    jobs.parallel_for(n, batch, [&](size_t begin, size_t end) {
+        uint64_t bits = 0;
+        for (size_t i = begin; i < end; ++i) {
+            order[i] = i;
+            bits |= keys[i] ^ keys[0];
+        }
+        differ[begin / batch] = bits;
+    });
+    uint64_t varying = 0;
+    for (auto bits : differ) {
+        varying |= bits;
+    }
+
+    std::vector<uint64_t> keys_out(n);
+    std::vector<uint32_t> order_out(n);
+    std::vector<uint32_t> offsets(batches * 256);
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        if (((varying >> shift) & 0xff) == 0) {
+            continue;
+        }
+        jobs.parallel_for(n, batch, [&](size_t begin, size_t end) {
+            uint32_t* hist = &offsets[begin / batch * 256];
+            std::fill_n(hist, 256, 0);
+            for (size_t i = begin; i < end; ++i) {
+                ++hist[(keys[i] >> shift) & 0xff];
+            }
+        });
+        // digit by digit, and within one batch by batch, so it's stable
+        uint32_t sum = 0;
+        for (size_t digit = 0; digit < 256; ++digit) {
+            for (size_t b = 0; b < batches; ++b) {
+                uint32_t count = offsets[b * 256 + digit];
+                offsets[b * 256 + digit] = sum;
+                sum += count;
+            }
+        }
+        jobs.parallel_for(n, batch, [&](size_t begin, size_t end) {
+            uint32_t* next = &offsets[begin / batch * 256];
+            for (size_t i = begin; i < end; ++i) {
+                uint32_t to = next[(keys[i] >> shift) & 0xff]++;
+                keys_out[to] = keys[i];
+                order_out[to] = order[i];
+            }
+        });
+        keys.swap(keys_out);
+        order.swap(order_out);
+    }
+}
+
+std::vector<PointChunk> sort_points_morton(Vert const* src,
+                                           Vert* dst,
+                                           size_t count,
+                                           JobSystem& jobs,
+                                           uint32_t chunk_size) {
+    if (count == 0) {
+        return {};
+    }
+
+    // bounding cube
+    glm::vec3 min, max;
+    point_bounds(src, count, jobs, min, max);
+    glm::vec3 extent = max - min;
+    float size = std::max({extent.x, extent.y, extent.z, 1e-20f});
+
+    const size_t batch = 1 << 16;
+    std::vector<uint64_t> keys(count);
+    jobs.parallel_for(count, batch, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            keys[i] = morton_code((src[i].pos - min) / size);
+        }
+    });
+    std::vector<uint32_t> order;
+    radix_sort(keys, order, jobs);
+
+    // gathered chunk by chunk, with their bounds
+    size_t chunk_count = (count + chunk_size - 1) / chunk_size;
+    std::vector<PointChunk> chunks(chunk_count);
+    jobs.parallel_for(chunk_count, 1, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            uint32_t first = c * chunk_size;
+            uint32_t last = std::min<size_t>(count, first + chunk_size);
+            auto& chunk = chunks[c];
+            chunk = {
+                .first = first,
+                .count = last - first,
+                .min = src[order[first]].pos,
+                .max = src[order[first]].pos,
+            };
+            for (uint32_t i = first; i < last; ++i) {
+                Vert const& v = src[order[i]];
+                dst[i] = v;
+                chunk.min = glm::min(chunk.min, v.pos);
+                chunk.max = glm::max(chunk.max, v.pos);
+            }
+        }
+    });
+    return chunks;
+}
@@ -0,0 +1,49 @@
+#ifndef POINT_SORT_H
+#define POINT_SORT_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+#include "vk_mesh.h"
+
+class JobSystem;
+
+/**
+ * Z-order curve index of a position `rel` in the unit cube, `bits` bits
+ * per axis (at most 21), interleaved as ...zyxzyx.  Points close in the
+ * cube tend to be close in the order.
+ */
+uint64_t morton_code(glm::vec3 rel, uint32_t bits = 21);
+
+/** Z-order curve index of a grid cell, the low 21 bits of each axis. */
+uint64_t morton_code(glm::uvec3 cell);
+
+/** Bounding box of `count` points, computed in parallel on `jobs`. */
+void point_bounds(Vert const* points,
+                  size_t count,
+                  JobSystem& jobs,
+                  glm::vec3& min,
+                  glm::vec3& max);
+
+/**
+ * Sort `keys` ascending, and set `order` to where each came from:
+ * keys_after[i] == keys_before[order[i]].  A stable LSD radix sort, eight
+ * bits per pass; histograms and scattering run in parallel on `jobs`.
+ * Passes over digits that are the same for all keys are skipped.
+ */
+void radix_sort(std::vector<uint64_t>& keys,
+                std::vector<uint32_t>& order,
+                JobSystem& jobs);
+
+/**
+ * Write `count` points from `src` to `dst` in Morton order over their
+ * bounding cube, and return the bounds of every `chunk_size` of them.
+ * `dst` is only written, never read, so it may be a mapped staging buffer.
+ */
+std::vector<PointChunk> sort_points_morton(Vert const* src,
+                                           Vert* dst,
+                                           size_t count,
+                                           JobSystem& jobs,
+                                           uint32_t chunk_size = 1 << 14);
+
+#endif  // POINT_SORT_H
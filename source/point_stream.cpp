@@ -0,0 +1,290 @@
+#include "point_stream.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include "engine.h"
+
+bool write_synthetic_pcc(std::string const& path,
+                         uint32_t chunks_per_axis,
+                         uint32_t points_per_chunk) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    uint32_t chunk_count = chunks_per_axis * chunks_per_axis * chunks_per_axis;
+    const float chunk_size = 1.f;
+    float extent = chunks_per_axis * chunk_size;
+    PccHeader header = {
+        .version = 1,
+        .chunk_count = chunk_count,
+        .point_count = (uint64_t)chunk_count * points_per_chunk,
+        .min = glm::vec3{-extent / 2, 0, -extent / 2},
+        .max = glm::vec3{extent / 2, extent, extent / 2},
+    };
+    memcpy(header.magic, PCC_MAGIC, sizeof(header.magic));
+
+    std::vector<PccChunk> table(chunk_count);
+    uint64_t offset = sizeof(PccHeader) + chunk_count * sizeof(PccChunk);
+    for (uint32_t c = 0; c < chunk_count; ++c) {
+        glm::uvec3 cell = {c % chunks_per_axis,
+                           c / chunks_per_axis % chunks_per_axis,
+                           c / (chunks_per_axis * chunks_per_axis)};
+        table[c] = {
+            .min = header.min + glm::vec3(cell) * chunk_size,
+            .size = chunk_size,
+            .offset = offset,
+            .count = points_per_chunk,
+        };
+        offset += (uint64_t)points_per_chunk * sizeof(Vert);
+    }
+    file.write((char const*)&header, sizeof(header));
+    file.write((char const*)table.data(), table.size() * sizeof(PccChunk));
+
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<float> unit{0.f, 1.f};
+    std::vector<Vert> verts(points_per_chunk);
+    for (auto& chunk : table) {
+        for (auto& v : verts) {
+            glm::vec3 rel = {unit(rng), unit(rng), unit(rng)};
+            v = {
+                .pos = chunk.min + rel * chunk.size,
+                .color = (chunk.min - header.min) / extent + rel * 0.1f,
+            };
+        }
+        file.write((char const*)verts.data(), verts.size() * sizeof(Vert));
+    }
+    return file.good();
+}
+
+bool PointStream::open(std::string const& path,
+                       VmaAllocator allocator,
+                       MemoryStats* stats,
+                       uint32_t staging_slots,
+                       uint32_t threads) {
+    _fd = ::open(path.c_str(), O_RDONLY);
+    if (_fd < 0) {
+        std::cerr << "Can't open point cloud '" << path << "'.\n";
+        return false;
+    }
+    struct stat st;
+    fstat(_fd, &st);
+    _map_size = st.st_size;
+    void* map = mmap(nullptr, _map_size, PROT_READ, MAP_PRIVATE, _fd, 0);
+    if (map == MAP_FAILED || _map_size < sizeof(PccHeader)) {
+        std::cerr << "Can't map point cloud '" << path << "'.\n";
+        close();
+        return false;
+    }
+    _map = (uint8_t const*)map;
+
+    memcpy(&_header, _map, sizeof(PccHeader));
+    size_t table_end =
+        sizeof(PccHeader) + (size_t)_header.chunk_count * sizeof(PccChunk);
+    if (memcmp(_header.magic, PCC_MAGIC, sizeof(_header.magic)) != 0 ||
+        table_end > _map_size) {
+        std::cerr << "'" << path << "' is not a chunked point cloud.\n";
+        close();
+        return false;
+    }
+    _chunks.resize(_header.chunk_count);
+    memcpy(_chunks.data(),
+           _map + sizeof(PccHeader),
+           _chunks.size() * sizeof(PccChunk));
+
+    // every slot fits the largest chunk
+    uint32_t max_count = 0;
+    for (auto& chunk : _chunks) {
+        if (chunk.offset + (uint64_t)chunk.count * sizeof(Vert) > _map_size) {
+            std::cerr << "'" << path << "' is truncated.\n";
+            close();
+            return false;
+        }
+        max_count = std::max(max_count, chunk.count);
+    }
+    // chunks are read in order of interest, not of the file
+    madvise(map, _map_size, MADV_RANDOM);
+
+    _allocator = allocator;
+    _slots.resize(staging_slots);
+    for (auto& slot : _slots) {
+        VkBufferCreateInfo buf_info = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .size = std::max(max_count, 1u) * sizeof(Vert),
+            .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        };
+        VmaAllocationCreateInfo alloc_info = {
+            .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+            .usage = VMA_MEMORY_USAGE_CPU_ONLY,
+        };
+        VmaAllocationInfo info;
+        VK_CHECK(vmaCreateBuffer(allocator,
+                                 &buf_info,
+                                 &alloc_info,
+                                 &slot.staging.buf,
+                                 &slot.staging.alloc,
+                                 &info));
+        slot.mapped = info.pMappedData;
+        if (stats) {
+            stats->track(allocator,
+                         slot.staging.alloc,
+                         MemCategory::Staging,
+                         "point stream staging");
+        }
+    }
+
+    _quit = false;
+    for (uint32_t i = 0; i < threads; ++i) {
+        _workers.emplace_back(&PointStream::worker, this);
+    }
+    std::cout << "Streaming " << _header.point_count / 1e6 << "M points in "
+              << _chunks.size() << " chunks (" << _map_size / 1e9
+              << " GB) from '" << path << "'.\n";
+    return true;
+}
+
+void PointStream::close() {
+    {
+        std::lock_guard lock{_mutex};
+        _quit = true;
+    }
+    _cv.notify_all();
+    for (auto& t : _workers) {
+        t.join();
+    }
+    _workers.clear();
+
+    for (auto& slot : _slots) {
+        destroy_buffer(_allocator, slot.staging);
+    }
+    _slots.clear();
+    _ready.clear();
+    _wanted.clear();
+    _chunks.clear();
+
+    if (_map) {
+        munmap((void*)_map, _map_size);
+        _map = nullptr;
+    }
+    if (_fd >= 0) {
+        ::close(_fd);
+        _fd = -1;
+    }
+}
+
+int PointStream::find_slot(uint32_t chunk) const {
+    for (int s = 0; s < (int)_slots.size(); ++s) {
+        if (_slots[s].state != SlotState::Empty && _slots[s].chunk == chunk) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+int PointStream::victim_slot() const {
+    int victim = -1;
+    for (int s = 0; s < (int)_slots.size(); ++s) {
+        auto& slot = _slots[s];
+        if (slot.state == SlotState::Empty) {
+            return s;
+        }
+        if (slot.state == SlotState::Cached &&
+            (victim < 0 || slot.last_used < _slots[victim].last_used)) {
+            victim = s;
+        }
+    }
+    return victim;
+}
+
+void PointStream::request(std::vector<uint32_t> const& chunks) {
+    {
+        std::lock_guard lock{_mutex};
+        ++_tick;
+        _wanted.clear();
+        for (auto c : chunks) {
+            int s = find_slot(c);
+            if (s < 0) {
+                _wanted.push_back(c);
+                continue;
+            }
+            auto& slot = _slots[s];
+            slot.last_used = _tick;
+            if (slot.state == SlotState::Cached) {
+                // still in host memory, no need to touch the disk
+                slot.state = SlotState::Ready;
+                _ready.push_back({
+                    .chunk = c,
+                    .slot = (uint32_t)s,
+                    .staging = slot.staging,
+                    .bytes = _chunks[c].count * sizeof(Vert),
+                });
+            }
+        }
+    }
+    _cv.notify_all();
+}
+
+void PointStream::take_ready(std::vector<Ready>& out) {
+    std::lock_guard lock{_mutex};
+    out.insert(out.end(), _ready.begin(), _ready.end());
+    _ready.clear();
+}
+
+void PointStream::release(uint32_t slot) {
+    {
+        std::lock_guard lock{_mutex};
+        _slots[slot].state = SlotState::Cached;
+    }
+    _cv.notify_all();  // workers may have been waiting for a free slot
+}
+
+void PointStream::worker() {
+    std::unique_lock lock{_mutex};
+    while (true) {
+        int s = -1;
+        _cv.wait(lock, [&] {
+            return _quit ||
+                   (!_wanted.empty() && (s = victim_slot()) >= 0);
+        });
+        if (_quit) {
+            return;
+        }
+        uint32_t c = _wanted.front();
+        _wanted.pop_front();
+        auto& slot = _slots[s];
+        slot.state = SlotState::Loading;
+        slot.chunk = c;
+        slot.last_used = _tick;
+        auto chunk = _chunks[c];
+        void* dst = slot.mapped;
+        AllocatedBuffer staging = slot.staging;
+        lock.unlock();
+
+        // the copy is where the pages get read in from disk
+        size_t bytes = chunk.count * sizeof(Vert);
+        uint8_t const* src = _map + chunk.offset;
+        memcpy(dst, src, bytes);
+
+        // drop the pages again, we keep our own copy in the staging buffer
+        size_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t begin = (uintptr_t)src / page * page;
+        uintptr_t end = (uintptr_t)src + bytes;
+        madvise((void*)begin, end - begin, MADV_DONTNEED);
+
+        lock.lock();
+        slot.state = SlotState::Ready;
+        _ready.push_back({
+            .chunk = c,
+            .slot = (uint32_t)s,
+            .staging = staging,
+            .bytes = bytes,
+        });
+    }
+}
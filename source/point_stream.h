@@ -0,0 +1,134 @@
+#ifndef POINT_STREAM_H
+#define POINT_STREAM_H
+
+#include <vk_mem_alloc.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "memory_stats.h"
+#include "vk_mesh.h"
+#include "vk_types.h"
+
+/*
+ * Chunked point cloud file (.pcc), little endian:
+ *   PccHeader
+ *   PccChunk[chunk_count]
+ *   Vert[point_count], each chunk's points contiguous at its offset
+ */
+#define PCC_MAGIC "PCCHUNK1"
+
+struct PccHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t chunk_count;
+    uint64_t point_count;
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+struct PccChunk {
+    glm::vec3 min;  // cube corner
+    float size;     // edge length
+    uint64_t offset;  // in bytes, from the start of the file
+    uint32_t count;
+    uint32_t reserved;
+};
+
+/**
+ * Write a synthetic .pcc of `chunks_per_axis`^3 chunks, each filled with
+ * `points_per_chunk` random points.  Generated one chunk at a time, so the
+ * file can be much larger than memory.
+ */
+bool write_synthetic_pcc(std::string const& path,
+                         uint32_t chunks_per_axis,
+                         uint32_t points_per_chunk);
+
+/**
+ * Pages chunks of a memory-mapped .pcc file into host-visible staging
+ * buffers on background threads.  The staging buffers double as an LRU
+ * cache of recently loaded chunks, and chunk pages are dropped from the
+ * mapping after the copy, so host memory stays at `staging_slots` times
+ * the largest chunk however large the file is.
+ *
+ * Main thread protocol, once per frame: request() the chunks wanted on
+ * the device, most important first; take_ready() the ones paged in so
+ * far, copy them from their staging buffer, then release() them.
+ */
+class PointStream {
+   public:
+    struct Ready {
+        uint32_t chunk;
+        uint32_t slot;
+        AllocatedBuffer staging;
+        VkDeviceSize bytes;
+    };
+
+    ~PointStream() { close(); }
+
+    bool open(std::string const& path,
+              VmaAllocator allocator,
+              MemoryStats* stats,
+              uint32_t staging_slots = 16,
+              uint32_t threads = 2);
+    void close();
+
+    std::vector<PccChunk> const& chunks() const { return _chunks; }
+    PccHeader const& header() const { return _header; }
+
+    /** Replace the wanted chunks.  Ones already queued but no longer
+     * wanted are dropped. */
+    void request(std::vector<uint32_t> const& chunks);
+
+    /** Chunks that finished paging in since the last call. */
+    void take_ready(std::vector<Ready>& out);
+
+    /** Done copying from a slot's staging buffer. */
+    void release(uint32_t slot);
+
+   private:
+    enum class SlotState { Empty, Loading, Ready, Cached };
+
+    struct Slot {
+        SlotState state{SlotState::Empty};
+        uint32_t chunk{0};
+        uint64_t last_used{0};
+        AllocatedBuffer staging;
+        void* mapped{nullptr};
+    };
+
+    void worker();
+
+    /** Slot holding `chunk`, or -1.  Call with the lock held. */
+    int find_slot(uint32_t chunk) const;
+
+    /** Empty or least recently used cached slot, or -1.  Lock held. */
+    int victim_slot() const;
+
+    // file
+    int _fd{-1};
+    uint8_t const* _map{nullptr};
+    size_t _map_size{0};
+    PccHeader _header{};
+    std::vector<PccChunk> _chunks;
+
+    VmaAllocator _allocator{VK_NULL_HANDLE};
+
+    // shared with the workers, guarded by _mutex
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::deque<uint32_t> _wanted;
+    std::vector<Slot> _slots;
+    std::vector<Ready> _ready;
+    uint64_t _tick{0};
+    bool _quit{false};
+
+    std::vector<std::thread> _workers;
+};
+
+#endif  // POINT_STREAM_H
@@ -0,0 +1,955 @@
+#include "render_graph.h"
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include "engine.h"
+#include "vk_init.h"
+
+static constexpr VkAccessFlags WRITE_ACCESS =
+    VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+static bool is_attachment(RGAccess type) {
+    return type == RGAccess::ColorWrite || type == RGAccess::DepthWrite;
+}
+
+static bool is_write(RGAccess type) {
+    return is_attachment(type) || type == RGAccess::StorageWrite ||
+           type == RGAccess::TransferWrite;
+}
+
+static VkImageLayout layout_for(RGAccess type) {
+    switch (type) {
+        case RGAccess::ColorWrite:
+            return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        case RGAccess::DepthWrite:
+            return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        case RGAccess::Sampled:
+            return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        case RGAccess::StorageRead:
+        case RGAccess::StorageWrite:
+            return VK_IMAGE_LAYOUT_GENERAL;
+        case RGAccess::TransferWrite:
+            return VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        default:
+            return VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+}
+
+static VkAccessFlags access_for(RGAccess type) {
+    switch (type) {
+        case RGAccess::ColorWrite:
+            return VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
+                   VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        case RGAccess::DepthWrite:
+            return VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        case RGAccess::Sampled:
+        case RGAccess::StorageRead:
+            return VK_ACCESS_SHADER_READ_BIT;
+        case RGAccess::StorageWrite:
+            return VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        case RGAccess::IndirectRead:
+            return VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        case RGAccess::TransferWrite:
+            return VK_ACCESS_TRANSFER_WRITE_BIT;
+        case RGAccess::VertexRead:
+            return VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    }
+    return 0;
+}
+
+static VkImageUsageFlags usage_for(RGAccess type) {
+    switch (type) {
+        case RGAccess::ColorWrite:
+            return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        case RGAccess::DepthWrite:
+            return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        case RGAccess::Sampled:
+            return VK_IMAGE_USAGE_SAMPLED_BIT;
+        case RGAccess::StorageRead:
+        case RGAccess::StorageWrite:
+            return VK_IMAGE_USAGE_STORAGE_BIT;
+        case RGAccess::TransferWrite:
+            return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        default:
+            return 0;
+    }
+}
+
+static const char* load_op_str(VkAttachmentLoadOp op) {
+    switch (op) {
+        case VK_ATTACHMENT_LOAD_OP_LOAD:
+            return "LOAD";
+        case VK_ATTACHMENT_LOAD_OP_CLEAR:
+            return "CLEAR";
+        default:
+            return "DONT_CARE";
+    }
+}
+
+static const char* store_op_str(VkAttachmentStoreOp op) {
+    return op == VK_ATTACHMENT_STORE_OP_STORE ? "STORE" : "DONT_CARE";
+}
+
+// Pass declaration
+
+RenderGraph::Pass& RenderGraph::Pass::write_color(
+    RGResource res,
+    std::optional<VkClearValue> clear) {
+    accesses.push_back({
+        .res = res,
+        .type = RGAccess::ColorWrite,
+        .stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .clear = clear,
+    });
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::write_depth(
+    RGResource res,
+    std::optional<VkClearValue> clear) {
+    accesses.push_back({
+        .res = res,
+        .type = RGAccess::DepthWrite,
+        .stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        .clear = clear,
+    });
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::read_sampled(
+    RGResource res,
+    VkPipelineStageFlags stages) {
+    accesses.push_back(
+        {.res = res, .type = RGAccess::Sampled, .stages = stages});
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::read_storage(
+    RGResource res,
+    VkPipelineStageFlags stages) {
+    accesses.push_back(
+        {.res = res, .type = RGAccess::StorageRead, .stages = stages});
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::write_storage(
+    RGResource res,
+    VkPipelineStageFlags stages) {
+    accesses.push_back(
+        {.res = res, .type = RGAccess::StorageWrite, .stages = stages});
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::read_indirect(RGResource res) {
+    accesses.push_back({
+        .res = res,
+        .type = RGAccess::IndirectRead,
+        .stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+    });
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::write_transfer(RGResource res) {
+    accesses.push_back({
+        .res = res,
+        .type = RGAccess::TransferWrite,
+        .stages = VK_PIPELINE_STAGE_TRANSFER_BIT,
+    });
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::read_vertices(RGResource res) {
+    accesses.push_back({
+        .res = res,
+        .type = RGAccess::VertexRead,
+        .stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+    });
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::execute(ExecuteFn&& f) {
+    fn = f;
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::record_secondary() {
+    secondary = true;
+    return *this;
+}
+
+RenderGraph::Pass& RenderGraph::Pass::enable_if(std::function<bool()>&& pred) {
+    enabled = pred;
+    return *this;
+}
+
+// Graph declaration
+
+RGResource RenderGraph::create_image(std::string const& name,
+                                     RGImageDesc const& desc) {
+    Resource res{
+        .name = name,
+        .is_image = true,
+        .imported = false,
+        .desc = desc,
+    };
+    _resources.push_back(res);
+    return _resources.size() - 1;
+}
+
+RGResource RenderGraph::import_image(std::string const& name,
+                                     RGImageDesc const& desc,
+                                     std::vector<VkImage> const& imgs,
+                                     std::vector<VkImageView> const& views,
+                                     VkImageLayout final_layout) {
+    assert(!imgs.empty() && imgs.size() == views.size());
+    Resource res{
+        .name = name,
+        .is_image = true,
+        .imported = true,
+        .desc = desc,
+        .final_layout = final_layout,
+        .imgs = imgs,
+        .views = views,
+    };
+    _resources.push_back(res);
+    return _resources.size() - 1;
+}
+
+RGResource RenderGraph::import_buffer(std::string const& name, VkBuffer buf) {
+    Resource res{
+        .name = name,
+        .is_image = false,
+        .imported = true,
+        .buf = buf,
+    };
+    _resources.push_back(res);
+    return _resources.size() - 1;
+}
+
+RenderGraph::Pass& RenderGraph::add_graphics_pass(std::string const& name) {
+    Pass pass;
+    pass.name = name;
+    pass.graphics = true;
+    _passes.push_back(pass);
+    return _passes.back();  // valid until the next add_*_pass()
+}
+
+RenderGraph::Pass& RenderGraph::add_compute_pass(std::string const& name) {
+    Pass pass;
+    pass.name = name;
+    pass.graphics = false;
+    _passes.push_back(pass);
+    return _passes.back();
+}
+
+void RenderGraph::set_output(RGResource res) {
+    _resources[res].output = true;
+}
+
+// Compilation
+
+void RenderGraph::compile(VkDevice device,
+                          VmaAllocator allocator,
+                          MemoryStats* stats) {
+    // laid out for every pass that may be enabled, so images can stay put
+    // when passes are switched on or off
+    cull_passes(true);
+    compute_lifetimes();
+    allocate_images(device, allocator, stats);
+    link(device);
+}
+
+void RenderGraph::link(VkDevice device) {
+    cull_passes(false);
+    compute_lifetimes();
+
+    // Walk the frame twice: the first walk yields the state everything is
+    // left in, which is where the next frame starts off.
+    std::vector<State> state(_resources.size());
+    state = walk_passes(state, false);
+    auto end_state = walk_passes(state, true);
+
+    // Graph images read before being written within a frame must be in the
+    // expected layout the first time around.
+    _init_barriers.clear();
+    _init_dst_stages = 0;
+    _first_execute = true;
+    for (RGResource r = 0; r < _resources.size(); ++r) {
+        auto& res = _resources[r];
+        if (!res.is_image || res.imported || !first_access_reads(r) ||
+            end_state[r].layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+            continue;
+        }
+        VkImageMemoryBarrier barrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .pNext = nullptr,
+            .srcAccessMask = 0,
+            .dstAccessMask = end_state[r].access,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = end_state[r].layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = res.imgs[0],
+            .subresourceRange = {res.desc.aspect, 0, 1, 0, 1},
+        };
+        _init_barriers.push_back(barrier);
+        _init_dst_stages |= end_state[r].stages;
+    }
+
+    for (auto& pass : _passes) {
+        if (pass.live && pass.graphics) {
+            create_render_pass(device, pass);
+        }
+    }
+}
+
+bool RenderGraph::outdated() const {
+    for (auto& pass : _passes) {
+        if (pass.enabled && pass.enabled() != pass.was_enabled) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RenderGraph::relink(VkDevice device) {
+    for (auto& pass : _passes) {
+        for (auto fb : pass.framebuffers) {
+            vkDestroyFramebuffer(device, fb, nullptr);
+        }
+        if (pass.render_pass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(device, pass.render_pass, nullptr);
+        }
+        pass.render_pass = VK_NULL_HANDLE;
+        pass.framebuffers.clear();
+        pass.attachments.clear();
+        pass.attachment_res.clear();
+        pass.clears.clear();
+        pass.dependency = {};
+        pass.extent = {};
+        pass.image_barriers.clear();
+        pass.barrier_res.clear();
+        pass.memory_barrier = {};
+        pass.src_stages = 0;
+        pass.dst_stages = 0;
+    }
+    link(device);
+    ++_generation;
+}
+
+void RenderGraph::cull_passes(bool all) {
+    std::vector<bool> needed(_resources.size(), false);
+    for (auto& pass : _passes) {
+        pass.was_enabled = all || !pass.enabled || pass.enabled();
+        pass.live = false;
+    }
+
+    // Go backwards, twice: resources read at the start of a frame may be
+    // produced at the end of the previous one.
+    for (int round = 0; round < 2; ++round) {
+        for (RGResource r = 0; r < _resources.size(); ++r) {
+            needed[r] = needed[r] || _resources[r].output;
+        }
+        for (int p = _passes.size() - 1; p >= 0; --p) {
+            auto& pass = _passes[p];
+            for (auto& a : pass.accesses) {
+                if (is_write(a.type) && needed[a.res] && pass.was_enabled) {
+                    pass.live = true;
+                }
+            }
+            if (!pass.live) {
+                continue;
+            }
+            // cleared attachments don't depend on earlier writers...
+            for (auto& a : pass.accesses) {
+                if (is_attachment(a.type) && a.clear) {
+                    needed[a.res] = false;
+                }
+            }
+            // ...but everything else this pass touches does
+            for (auto& a : pass.accesses) {
+                if (!(is_attachment(a.type) && a.clear)) {
+                    needed[a.res] = true;
+                }
+            }
+        }
+    }
+}
+
+void RenderGraph::compute_lifetimes() {
+    for (auto& res : _resources) {
+        res.first_pass = -1;
+        res.last_pass = -1;
+    }
+    for (int p = 0; p < (int)_passes.size(); ++p) {
+        if (!_passes[p].live) {
+            continue;
+        }
+        for (auto& a : _passes[p].accesses) {
+            auto& res = _resources[a.res];
+            if (res.first_pass < 0) {
+                res.first_pass = p;
+            }
+            res.last_pass = p;
+            res.usage |= usage_for(a.type);
+        }
+    }
+}
+
+bool RenderGraph::first_access_reads(RGResource r) const {
+    auto& res = _resources[r];
+    if (res.first_pass < 0) {
+        return false;
+    }
+    for (auto& a : _passes[res.first_pass].accesses) {
+        if (a.res == r) {
+            // attachments never load across frames, see walk_passes()
+            return !is_attachment(a.type);
+        }
+    }
+    return false;
+}
+
+void RenderGraph::allocate_images(VkDevice device,
+                                  VmaAllocator allocator,
+                                  MemoryStats* stats) {
+    // An attachment that lives in a single pass never has to hit memory.
+    for (auto& res : _resources) {
+        if (!res.is_image || res.imported || res.output ||
+            res.first_pass < 0 || res.first_pass != res.last_pass) {
+            continue;
+        }
+        auto& pass = _passes[res.first_pass];
+        res.transient = std::all_of(
+            pass.accesses.cbegin(), pass.accesses.cend(), [&](auto& a) {
+                return &_resources[a.res] != &res || is_attachment(a.type);
+            });
+    }
+
+    std::vector<RGResource> aliasable;
+
+    for (RGResource r = 0; r < _resources.size(); ++r) {
+        auto& res = _resources[r];
+        if (!res.is_image || res.imported || res.first_pass < 0) {
+            continue;
+        }
+
+        res.usage |= res.desc.usage;
+        if (res.transient) {
+            res.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+        VkExtent3D extent = {res.desc.extent.width, res.desc.extent.height, 1};
+        auto img_info =
+            vkinit::image_create_info(res.desc.format, res.usage, extent);
+        res.imgs.resize(1);
+        VK_CHECK(vkCreateImage(device, &img_info, nullptr, &res.imgs[0]));
+
+        if (res.transient) {
+            // on tilers, this memory is never actually backed
+            VmaAllocationCreateInfo lazy_info = {
+                .usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED,
+            };
+            if (vmaAllocateMemoryForImage(allocator,
+                                          res.imgs[0],
+                                          &lazy_info,
+                                          &res.alloc,
+                                          nullptr) == VK_SUCCESS) {
+                res.lazy = true;
+                VK_CHECK(vmaBindImageMemory(allocator, res.alloc, res.imgs[0]));
+                if (stats) {
+                    // counts the requested size, tilers may never back it
+                    stats->track(allocator,
+                                 res.alloc,
+                                 MemCategory::Attachment,
+                                 res.name.c_str());
+                }
+            }
+        }
+
+        if (!res.lazy) {
+            if (first_access_reads(r)) {
+                // contents survive the frame, can't share memory
+                VmaAllocationCreateInfo alloc_info = {
+                    .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+                };
+                VK_CHECK(vmaAllocateMemoryForImage(
+                    allocator, res.imgs[0], &alloc_info, &res.alloc, nullptr));
+                VK_CHECK(vmaBindImageMemory(allocator, res.alloc, res.imgs[0]));
+                if (stats) {
+                    stats->track(allocator,
+                                 res.alloc,
+                                 MemCategory::Attachment,
+                                 res.name.c_str());
+                }
+            } else {
+                aliasable.push_back(r);
+            }
+        }
+    }
+
+    // Greedily pack images with disjoint lifetimes into shared slots
+    std::sort(aliasable.begin(), aliasable.end(), [&](auto a, auto b) {
+        return _resources[a].first_pass < _resources[b].first_pass;
+    });
+    for (auto r : aliasable) {
+        auto& res = _resources[r];
+        VkMemoryRequirements reqs;
+        vkGetImageMemoryRequirements(device, res.imgs[0], &reqs);
+
+        for (int s = 0; s < (int)_slots.size(); ++s) {
+            auto& slot = _slots[s];
+            if (slot.last_pass < res.first_pass &&
+                (slot.reqs.memoryTypeBits & reqs.memoryTypeBits)) {
+                slot.reqs.size = std::max(slot.reqs.size, reqs.size);
+                slot.reqs.alignment =
+                    std::max(slot.reqs.alignment, reqs.alignment);
+                slot.reqs.memoryTypeBits &= reqs.memoryTypeBits;
+                slot.last_pass = res.last_pass;
+                res.memory_slot = s;
+                break;
+            }
+        }
+        if (res.memory_slot < 0) {
+            _slots.push_back({.reqs = reqs, .last_pass = res.last_pass});
+            res.memory_slot = _slots.size() - 1;
+        }
+    }
+
+    VmaAllocationCreateInfo slot_info = {
+        .usage = VMA_MEMORY_USAGE_GPU_ONLY,
+    };
+    for (int s = 0; s < (int)_slots.size(); ++s) {
+        auto& slot = _slots[s];
+        VK_CHECK(vmaAllocateMemory(
+            allocator, &slot.reqs, &slot_info, &slot.alloc, nullptr));
+        if (stats) {
+            auto name = "aliased slot " + std::to_string(s);
+            stats->track(
+                allocator, slot.alloc, MemCategory::Attachment, name.c_str());
+        }
+    }
+    for (auto r : aliasable) {
+        auto& res = _resources[r];
+        VK_CHECK(vmaBindImageMemory(
+            allocator, _slots[res.memory_slot].alloc, res.imgs[0]));
+    }
+
+    // views
+    for (auto& res : _resources) {
+        if (!res.is_image || res.imported || res.first_pass < 0) {
+            continue;
+        }
+        auto view_info = vkinit::imageview_create_info(
+            res.desc.format, res.imgs[0], res.desc.aspect);
+        res.views.resize(1);
+        VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &res.views[0]));
+    }
+}
+
+bool RenderGraph::contents_needed_after(int p, RGResource r) const {
+    auto& res = _resources[r];
+    for (int q = p + 1; q < (int)_passes.size(); ++q) {
+        if (!_passes[q].live) {
+            continue;
+        }
+        for (auto& a : _passes[q].accesses) {
+            if (a.res == r) {
+                return !(is_attachment(a.type) && a.clear);
+            }
+        }
+    }
+    return res.imported || res.output || first_access_reads(r);
+}
+
+std::vector<RenderGraph::State> RenderGraph::walk_passes(
+    std::vector<State> state,
+    bool emit) {
+    for (auto& s : state) {
+        s.written = false;
+    }
+
+    // Aliased images wait for the previous slot owner, but start off with
+    // undefined contents.  At the start of the frame that's the last owner
+    // of the previous frame.
+    std::vector<int> slot_owner(_slots.size(), -1);
+    for (RGResource r = 0; r < _resources.size(); ++r) {
+        int s = _resources[r].memory_slot;
+        if (s < 0 || _resources[r].first_pass < 0) {
+            continue;  // not aliased, or unused while its passes are culled
+        }
+        int owner = slot_owner[s];
+        if (owner < 0 ||
+            _resources[owner].first_pass < _resources[r].first_pass) {
+            slot_owner[s] = r;
+        }
+    }
+
+    for (int p = 0; p < (int)_passes.size(); ++p) {
+        auto& pass = _passes[p];
+        if (!pass.live) {
+            continue;
+        }
+        if (emit) {
+            pass.attachments.clear();
+            pass.attachment_res.clear();
+            pass.clears.clear();
+            pass.image_barriers.clear();
+            pass.barrier_res.clear();
+            pass.memory_barrier = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .pNext = nullptr,
+            };
+            pass.dependency = {
+                .srcSubpass = VK_SUBPASS_EXTERNAL,
+                .dstSubpass = 0,
+            };
+            pass.src_stages = 0;
+            pass.dst_stages = 0;
+        }
+
+        for (auto& a : pass.accesses) {
+            auto& res = _resources[a.res];
+            State prev = state[a.res];
+            int slot = res.memory_slot;
+            if (slot >= 0 && p == res.first_pass) {
+                int owner = slot_owner[slot];
+                if (owner >= 0 && owner != a.res) {
+                    // the memory is the owner's, whatever this image had
+                    // in it before is gone
+                    prev = {
+                        .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                        .stages = state[owner].stages,
+                        .access = state[owner].access,
+                    };
+                }
+                slot_owner[slot] = a.res;
+            }
+
+            VkImageLayout layout = layout_for(a.type);
+            VkAccessFlags access = access_for(a.type);
+            VkAccessFlags prev_writes = prev.access & WRITE_ACCESS;
+
+            if (is_attachment(a.type)) {
+                // Attachments only load what was written earlier this frame
+                bool load = !a.clear && prev.written;
+                bool last = p == res.last_pass;
+                VkImageLayout final_layout = layout;
+                if (last && res.final_layout != VK_IMAGE_LAYOUT_UNDEFINED) {
+                    final_layout = res.final_layout;
+                }
+                bool store = contents_needed_after(p, a.res);
+
+                VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                if (a.clear) {
+                    load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                } else if (load) {
+                    load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+                }
+
+                if (emit) {
+                    VkAttachmentDescription desc = {
+                        .format = res.desc.format,
+                        .samples = VK_SAMPLE_COUNT_1_BIT,
+                        .loadOp = load_op,
+                        .storeOp = store ? VK_ATTACHMENT_STORE_OP_STORE
+                                         : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                        .initialLayout =
+                            load ? prev.layout : VK_IMAGE_LAYOUT_UNDEFINED,
+                        .finalLayout = final_layout,
+                    };
+                    pass.attachments.push_back(desc);
+                    pass.attachment_res.push_back(a.res);
+                    pass.clears.push_back(a.clear.value_or(VkClearValue{}));
+                    pass.extent = res.desc.extent;
+
+                    // previous users have to be done before we touch it
+                    if (prev.stages) {
+                        pass.dependency.srcStageMask |= prev.stages;
+                        pass.dependency.srcAccessMask |= prev_writes;
+                        pass.dependency.dstStageMask |= a.stages;
+                        pass.dependency.dstAccessMask |= access;
+                    }
+                }
+
+                state[a.res] = {
+                    .layout = final_layout,
+                    .stages = a.stages,
+                    .access = access,
+                    .written = true,
+                    .write_stages = a.stages,
+                    .write_access = access & WRITE_ACCESS,
+                };
+                continue;
+            }
+
+            // Everything else gets a barrier ahead of the pass
+            bool transition = res.is_image && prev.layout != layout;
+            bool hazard = prev_writes || (is_write(a.type) && prev.stages);
+            // a read in a new stage, after one that synchronized the write
+            bool unseen = !is_write(a.type) && !prev_writes &&
+                          prev.write_stages && (a.stages & ~prev.stages);
+            if (unseen) {
+                prev.stages = prev.write_stages;
+                prev_writes = prev.write_access;
+            }
+            if (emit && (transition || hazard || unseen)) {
+                pass.src_stages |= prev.stages;
+                pass.dst_stages |= a.stages;
+                if (res.is_image) {
+                    VkImageMemoryBarrier barrier = {
+                        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                        .pNext = nullptr,
+                        .srcAccessMask = prev_writes,
+                        .dstAccessMask = access,
+                        .oldLayout = prev.layout,
+                        .newLayout = layout,
+                        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                        .image = VK_NULL_HANDLE,  // set in execute()
+                        .subresourceRange = {res.desc.aspect, 0, 1, 0, 1},
+                    };
+                    pass.image_barriers.push_back(barrier);
+                    pass.barrier_res.push_back(a.res);
+                } else {
+                    pass.memory_barrier.srcAccessMask |= prev_writes;
+                    pass.memory_barrier.dstAccessMask |= access;
+                }
+            }
+
+            if (!transition && !is_write(a.type) && (!prev_writes || unseen)) {
+                // read after read: later writers have to wait for all readers
+                state[a.res].stages |= a.stages;
+                state[a.res].access |= access;
+            } else {
+                bool write = is_write(a.type);
+                state[a.res] = {
+                    .layout = res.is_image ? layout : VK_IMAGE_LAYOUT_UNDEFINED,
+                    .stages = a.stages,
+                    .access = access,
+                    .written = prev.written || write,
+                    .write_stages = write ? a.stages : prev.write_stages,
+                    .write_access =
+                        write ? access & WRITE_ACCESS : prev.write_access,
+                };
+            }
+        }
+    }
+    return state;
+}
+
+void RenderGraph::create_render_pass(VkDevice device, Pass& pass) {
+    std::vector<VkAttachmentReference> color_refs;
+    VkAttachmentReference depth_ref;
+    bool has_depth = false;
+    uint32_t view_count = 1;
+
+    for (uint32_t i = 0; i < pass.attachments.size(); ++i) {
+        auto& res = _resources[pass.attachment_res[i]];
+        view_count = std::max(view_count, (uint32_t)res.views.size());
+        if (res.desc.aspect & VK_IMAGE_ASPECT_DEPTH_BIT) {
+            depth_ref = {
+                .attachment = i,
+                .layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+            };
+            has_depth = true;
+        } else {
+            color_refs.push_back({
+                .attachment = i,
+                .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            });
+        }
+    }
+
+    VkSubpassDescription subpass = {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = (uint32_t)color_refs.size(),
+        .pColorAttachments = color_refs.data(),
+        .pDepthStencilAttachment = has_depth ? &depth_ref : nullptr,
+    };
+
+    bool has_dep = pass.dependency.srcStageMask != 0;
+    VkRenderPassCreateInfo render_pass_info = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = (uint32_t)pass.attachments.size(),
+        .pAttachments = pass.attachments.data(),
+        .subpassCount = 1,
+        .pSubpasses = &subpass,
+        .dependencyCount = has_dep ? 1u : 0u,
+        .pDependencies = &pass.dependency,
+    };
+    VK_CHECK(vkCreateRenderPass(
+        device, &render_pass_info, nullptr, &pass.render_pass));
+
+    // one framebuffer per view of imported attachments (swapchain images)
+    pass.framebuffers.resize(view_count);
+    for (uint32_t v = 0; v < view_count; ++v) {
+        std::vector<VkImageView> views;
+        for (auto r : pass.attachment_res) {
+            auto& res = _resources[r];
+            uint32_t idx = std::min(v, (uint32_t)res.views.size() - 1);
+            views.push_back(res.views[idx]);
+        }
+        VkFramebufferCreateInfo fb_info = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .pNext = nullptr,
+            .renderPass = pass.render_pass,
+            .attachmentCount = (uint32_t)views.size(),
+            .pAttachments = views.data(),
+            .width = pass.extent.width,
+            .height = pass.extent.height,
+            .layers = 1,
+        };
+        VK_CHECK(vkCreateFramebuffer(
+            device, &fb_info, nullptr, &pass.framebuffers[v]));
+    }
+}
+
+// Execution
+
+void RenderGraph::execute(VkCommandBuffer cmd, uint32_t view_idx) {
+    if (_first_execute && !_init_barriers.empty()) {
+        vkCmdPipelineBarrier(cmd,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             _init_dst_stages,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             _init_barriers.size(),
+                             _init_barriers.data());
+    }
+    _first_execute = false;
+
+    for (auto& pass : _passes) {
+        if (!pass.live) {
+            continue;
+        }
+
+        if (pass.dst_stages) {
+            for (size_t i = 0; i < pass.image_barriers.size(); ++i) {
+                auto& res = _resources[pass.barrier_res[i]];
+                uint32_t idx =
+                    std::min(view_idx, (uint32_t)res.imgs.size() - 1);
+                pass.image_barriers[i].image = res.imgs[idx];
+            }
+            bool has_mem_barrier = pass.memory_barrier.srcAccessMask ||
+                                   pass.memory_barrier.dstAccessMask;
+            vkCmdPipelineBarrier(cmd,
+                                 pass.src_stages
+                                     ? pass.src_stages
+                                     : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                 pass.dst_stages,
+                                 0,
+                                 has_mem_barrier ? 1 : 0,
+                                 &pass.memory_barrier,
+                                 0,
+                                 nullptr,
+                                 pass.image_barriers.size(),
+                                 pass.image_barriers.data());
+        }
+
+        if (!pass.graphics) {
+            if (pass.fn) {
+                pass.fn(cmd);
+            }
+            continue;
+        }
+
+        uint32_t fb_idx =
+            std::min(view_idx, (uint32_t)pass.framebuffers.size() - 1);
+        VkRenderPassBeginInfo rp_info = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+            .pNext = nullptr,
+            .renderPass = pass.render_pass,
+            .framebuffer = pass.framebuffers[fb_idx],
+            .renderArea = {.offset = {0, 0}, .extent = pass.extent},
+            .clearValueCount = (uint32_t)pass.clears.size(),
+            .pClearValues = pass.clears.data(),
+        };
+        vkCmdBeginRenderPass(cmd,
+                             &rp_info,
+                             pass.secondary
+                                 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                 : VK_SUBPASS_CONTENTS_INLINE);
+        if (pass.fn) {
+            pass.fn(cmd);
+        }
+        vkCmdEndRenderPass(cmd);
+    }
+}
+
+void RenderGraph::destroy(VkDevice device, VmaAllocator allocator) {
+    for (auto& pass : _passes) {
+        for (auto fb : pass.framebuffers) {
+            vkDestroyFramebuffer(device, fb, nullptr);
+        }
+        if (pass.render_pass != VK_NULL_HANDLE) {
+            vkDestroyRenderPass(device, pass.render_pass, nullptr);
+        }
+    }
+    for (auto& res : _resources) {
+        if (res.imported || !res.is_image) {
+            continue;
+        }
+        for (auto view : res.views) {
+            vkDestroyImageView(device, view, nullptr);
+        }
+        for (auto img : res.imgs) {
+            vkDestroyImage(device, img, nullptr);
+        }
+        if (res.alloc != VK_NULL_HANDLE) {
+            free_memory(allocator, res.alloc);
+        }
+    }
+    for (auto& slot : _slots) {
+        free_memory(allocator, slot.alloc);
+    }
+    _passes.clear();
+    _resources.clear();
+    _slots.clear();
+}
+
+VkRenderPass RenderGraph::get_render_pass(std::string const& pass_name) const {
+    for (auto& pass : _passes) {
+        if (pass.name == pass_name) {
+            return pass.render_pass;
+        }
+    }
+    return VK_NULL_HANDLE;
+}
+
+VkImageView RenderGraph::get_image_view(RGResource res) const {
+    auto& views = _resources[res].views;
+    return views.empty() ? VK_NULL_HANDLE : views[0];
+}
+
+void RenderGraph::print() const {
+    for (auto& pass : _passes) {
+        std::cout << "  Pass '" << pass.name << "'"
+                  << (pass.live ? "" : " (culled)") << "\n";
+        for (size_t i = 0; i < pass.attachments.size(); ++i) {
+            auto& res = _resources[pass.attachment_res[i]];
+            auto& att = pass.attachments[i];
+            std::cout << "    " << res.name << ": "
+                      << load_op_str(att.loadOp) << "/"
+                      << store_op_str(att.storeOp)
+                      << (res.lazy ? ", lazily allocated" : "") << "\n";
+        }
+    }
+    for (size_t s = 0; s < _slots.size(); ++s) {
+        std::cout << "  Memory slot " << s << " ("
+                  << _slots[s].reqs.size / 1e6 << "MB):";
+        for (auto& res : _resources) {
+            if (res.memory_slot == (int)s) {
+                std::cout << " " << res.name;
+            }
+        }
+        std::cout << "\n";
+    }
+}
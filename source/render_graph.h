@@ -0,0 +1,231 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+#include "memory_stats.h"
+
+/** Handle to an image or buffer tracked by a RenderGraph. */
+using RGResource = uint32_t;
+
+struct RGImageDesc {
+    VkFormat format;
+    VkExtent2D extent;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    VkImageUsageFlags usage = 0;  // extra usage, the rest is derived
+};
+
+enum class RGAccess {
+    ColorWrite,    // color attachment
+    DepthWrite,    // depth attachment
+    Sampled,       // sampled image, read-only
+    StorageRead,   // storage image/buffer, read-only
+    StorageWrite,  // storage image/buffer, read-write
+    IndirectRead,  // indirect draw/dispatch arguments
+    TransferWrite,  // copy or fill destination
+    VertexRead,     // vertex buffer
+};
+
+/**
+ * A frame described as a list of passes that declare which resources they
+ * read and write.  compile() culls passes that don't contribute to an
+ * output, derives load/store ops, layouts and the barriers between passes,
+ * and backs attachments that never leave their pass with lazily allocated
+ * (or aliased) memory.  execute() records the whole frame.
+ *
+ * Passes run in declaration order.  Passes with an enable_if() predicate
+ * are culled while it is false; images are laid out for all of them, the
+ * rest is redone by relink().
+ */
+class RenderGraph {
+   public:
+    using ExecuteFn = std::function<void(VkCommandBuffer cmd)>;
+
+    struct Access {
+        RGResource res;
+        RGAccess type;
+        VkPipelineStageFlags stages;
+        std::optional<VkClearValue> clear;  // attachments only
+    };
+
+    struct Pass {
+        std::string name;
+        bool graphics;
+        std::vector<Access> accesses;
+        ExecuteFn fn;
+        bool secondary{false};  // fn only executes secondary cmd buffers
+        std::function<bool()> enabled;  // always, if empty
+
+        Pass& write_color(RGResource res,
+                          std::optional<VkClearValue> clear = std::nullopt);
+        Pass& write_depth(RGResource res,
+                          std::optional<VkClearValue> clear = std::nullopt);
+        Pass& read_sampled(RGResource res, VkPipelineStageFlags stages);
+        Pass& read_storage(RGResource res, VkPipelineStageFlags stages);
+        Pass& write_storage(RGResource res, VkPipelineStageFlags stages);
+        Pass& read_indirect(RGResource res);
+        Pass& write_transfer(RGResource res);
+        Pass& read_vertices(RGResource res);
+        Pass& execute(ExecuteFn&& f);
+
+        /**
+         * Cull the pass while `pred` returns false, along with what only
+         * it needs.  Checked by outdated(), applied by relink().
+         */
+        Pass& enable_if(std::function<bool()>&& pred);
+
+        /**
+         * Begin the render pass for secondary command buffers, which fn
+         * records elsewhere and executes with vkCmdExecuteCommands().
+         * Inherit get_render_pass() of this pass, subpass 0.
+         */
+        Pass& record_secondary();
+
+        // Filled in by compile()
+        bool was_enabled{true};  // when last linked
+        bool live{false};
+        VkRenderPass render_pass{VK_NULL_HANDLE};
+        std::vector<VkFramebuffer> framebuffers;  // one per imported view
+        std::vector<VkAttachmentDescription> attachments;
+        std::vector<RGResource> attachment_res;
+        std::vector<VkClearValue> clears;
+        VkSubpassDependency dependency{};
+        VkExtent2D extent{};
+
+        // barrier recorded before the pass (before the render pass begins)
+        std::vector<VkImageMemoryBarrier> image_barriers;
+        std::vector<RGResource> barrier_res;
+        VkMemoryBarrier memory_barrier{};
+        VkPipelineStageFlags src_stages{0};
+        VkPipelineStageFlags dst_stages{0};
+    };
+
+    /** Image owned by the graph, allocated in compile(). */
+    RGResource create_image(std::string const& name, RGImageDesc const& desc);
+
+    /**
+     * Image owned by someone else, e.g. the swapchain.  `views` holds one
+     * view per swapchain image; execute() picks one by `view_idx`.
+     * The image is transitioned to `final_layout` after its last use.
+     */
+    RGResource import_image(std::string const& name,
+                            RGImageDesc const& desc,
+                            std::vector<VkImage> const& imgs,
+                            std::vector<VkImageView> const& views,
+                            VkImageLayout final_layout);
+
+    RGResource import_buffer(std::string const& name, VkBuffer buf);
+
+    Pass& add_graphics_pass(std::string const& name);
+    Pass& add_compute_pass(std::string const& name);
+
+    /** Passes not contributing to an output are culled. */
+    void set_output(RGResource res);
+
+    /** Graph images are accounted as attachments in `stats`, if given. */
+    void compile(VkDevice device,
+                 VmaAllocator allocator,
+                 MemoryStats* stats = nullptr);
+    void execute(VkCommandBuffer cmd, uint32_t view_idx);
+
+    /** Whether an enable_if() predicate changed since the last link. */
+    bool outdated() const;
+
+    /**
+     * Cull passes by their enable_if() predicates again, and redo render
+     * passes, load/store ops and barriers for what's left.  Images keep
+     * their memory, but contents carried across frames are lost.  The GPU
+     * must be done with all frames recorded before.
+     */
+    void relink(VkDevice device);
+
+    /** Bumped by relink(), for secondaries that inherit render passes. */
+    uint32_t generation() const { return _generation; }
+
+    void destroy(VkDevice device, VmaAllocator allocator);
+
+    VkRenderPass get_render_pass(std::string const& pass_name) const;
+    VkImageView get_image_view(RGResource res) const;
+
+    /** Print passes, load/store ops and memory aliasing. */
+    void print() const;
+
+   private:
+    struct Resource {
+        std::string name;
+        bool is_image;
+        bool imported;
+        bool output{false};
+        RGImageDesc desc{};
+        VkImageLayout final_layout{VK_IMAGE_LAYOUT_UNDEFINED};
+
+        // images: one entry, or one per swapchain image if imported
+        std::vector<VkImage> imgs;
+        std::vector<VkImageView> views;
+        VkBuffer buf{VK_NULL_HANDLE};
+
+        // Filled in by compile()
+        VkImageUsageFlags usage{0};
+        int first_pass{-1};
+        int last_pass{-1};
+        bool transient{false};
+        bool lazy{false};
+        int memory_slot{-1};
+        VmaAllocation alloc{VK_NULL_HANDLE};
+    };
+
+    /** Memory shared by graph images with disjoint lifetimes. */
+    struct MemorySlot {
+        VkMemoryRequirements reqs;
+        int last_pass;
+        VmaAllocation alloc{VK_NULL_HANDLE};
+    };
+
+    /** Last known state of a resource while walking the passes. */
+    struct State {
+        VkImageLayout layout{VK_IMAGE_LAYOUT_UNDEFINED};
+        VkPipelineStageFlags stages{0};
+        VkAccessFlags access{0};
+        bool written{false};
+        // the last write, for readers in stages it wasn't made visible to
+        VkPipelineStageFlags write_stages{0};
+        VkAccessFlags write_access{0};
+    };
+
+    /** With `all`, as if every enable_if() predicate were true. */
+    void cull_passes(bool all);
+    void compute_lifetimes();
+    void allocate_images(VkDevice device,
+                         VmaAllocator allocator,
+                         MemoryStats* stats);
+    void create_render_pass(VkDevice device, Pass& pass);
+
+    /** Cull, walk the passes and create render passes, after allocation. */
+    void link(VkDevice device);
+
+    /**
+     * Track resource state through all live passes.  With `emit`, also fill
+     * in attachment descriptions and barriers.  Returns the end state.
+     */
+    std::vector<State> walk_passes(std::vector<State> state, bool emit);
+
+    /** Whether a resource's contents are read at the start of a frame. */
+    bool first_access_reads(RGResource r) const;
+
+    /** Whether anything after pass `p` (or the next frame) reads `r`. */
+    bool contents_needed_after(int p, RGResource r) const;
+
+    std::vector<Resource> _resources;
+    std::vector<Pass> _passes;
+    std::vector<MemorySlot> _slots;
+    std::vector<VkImageMemoryBarrier> _init_barriers;
+    VkPipelineStageFlags _init_dst_stages{0};
+    bool _first_execute{true};
+    uint32_t _generation{0};
+};
+
+#endif  // RENDER_GRAPH_H
@@ -0,0 +1,88 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Bounded queue from one producer thread to one consumer thread, without
+ * locks.  Items are pushed and popped in bulk and copied in at most two
+ * spans, where the ring wraps around.  Neither side ever waits: push()
+ * takes what fits and pop() what is there.
+ *
+ * Each side keeps a cached copy of the other's index and only reloads it
+ * when the cached one says the ring is full (or empty), and the indices
+ * live on separate cache lines, so the two threads rarely touch the same
+ * line.
+ */
+template <class T>
+class SpscRing {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+   public:
+    /**
+     * Room for `capacity` items, rounded up to a power of two.  Not thread
+     * safe, call before either side starts.
+     */
+    void reset(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size *= 2;
+        }
+        _items.assign(size, T{});
+        _mask = size - 1;
+        _head.store(0, std::memory_order_relaxed);
+        _tail.store(0, std::memory_order_relaxed);
+        _tail_cache = 0;
+        _head_cache = 0;
+    }
+
+    size_t capacity() const { return _items.size(); }
+
+    /** Producer: append up to `count` items, returns how many fit. */
+    size_t push(T const* items, size_t count) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (capacity() - (head - _tail_cache) < count) {
+            _tail_cache = _tail.load(std::memory_order_acquire);
+        }
+        count = std::min(count, capacity() - (head - _tail_cache));
+        size_t at = head & _mask;
+        size_t first = std::min(count, capacity() - at);
+        std::copy_n(items, first, _items.data() + at);
+        std::copy_n(items + first, count - first, _items.data());
+        _head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /** Consumer: take up to `max` items, oldest first, returns how many. */
+    size_t pop(T* out, size_t max) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (_head_cache - tail < max) {
+            _head_cache = _head.load(std::memory_order_acquire);
+        }
+        size_t count = std::min(max, _head_cache - tail);
+        size_t at = tail & _mask;
+        size_t first = std::min(count, capacity() - at);
+        std::copy_n(_items.data() + at, first, out);
+        std::copy_n(_items.data(), count - first, out + first);
+        _tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+   private:
+    std::vector<T> _items;
+    size_t _mask{0};
+
+    // producer's line
+    alignas(64) std::atomic<size_t> _head{0};  // items pushed, ever
+    size_t _tail_cache{0};
+
+    // consumer's line
+    alignas(64) std::atomic<size_t> _tail{0};  // items popped, ever
+    size_t _head_cache{0};
+};
+
+#endif  // SPSC_RING_H
@@ -0,0 +1,135 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "job_system.h"
+
+namespace detail {
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;  // whoever awaits the task
+    bool detached{false};                  // nobody does, see Task::detach()
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+
+        template <class Promise>
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<Promise> h) noexcept {
+            auto& p = h.promise();
+            if (p.continuation) {
+                return p.continuation;  // straight back, no stack growth
+            }
+            if (p.detached) {
+                h.destroy();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() const { std::terminate(); }
+};
+
+template <class T>
+struct Promise : PromiseBase {
+    std::optional<T> value;
+
+    void return_value(T v) { value = std::move(v); }
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+    void return_void() const {}
+};
+
+}  // namespace detail
+
+/**
+ * A coroutine returning `T`.  It starts when awaited, and resumes the
+ * awaiting coroutine when it's done, on whatever thread it finished on:
+ *
+ *   Task<Mesh> load(std::string path) {
+ *       co_await engine.background();  // now on a worker
+ *       co_return Mesh::load_from_obj(path.c_str());
+ *   }
+ *   Task<> show(std::string path) {
+ *       Mesh mesh = co_await load(path);
+ *       ...
+ *   }
+ *
+ * Top-level tasks are started with detach(), or Engine::spawn().
+ */
+template <class T = void>
+class [[nodiscard]] Task {
+   public:
+    struct promise_type : detail::Promise<T> {
+        Task get_return_object() {
+            return Task{std::coroutine_handle<promise_type>::from_promise(
+                *this)};
+        }
+    };
+
+    Task(Task&& t) noexcept : _h{std::exchange(t._h, {})} {}
+    Task& operator=(Task&& t) noexcept {
+        if (this != &t) {
+            reset();
+            _h = std::exchange(t._h, {});
+        }
+        return *this;
+    }
+    ~Task() { reset(); }
+
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<> awaiting) noexcept {
+        _h.promise().continuation = awaiting;
+        return _h;
+    }
+
+    T await_resume() {
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*_h.promise().value);
+        }
+    }
+
+    /** Start it, it frees itself when done. */
+    void detach() && {
+        auto h = std::exchange(_h, {});
+        h.promise().detached = true;
+        h.resume();
+    }
+
+   private:
+    explicit Task(std::coroutine_handle<promise_type> h) : _h{h} {}
+
+    void reset() {
+        if (_h) {
+            _h.destroy();
+            _h = {};
+        }
+    }
+
+    std::coroutine_handle<promise_type> _h;
+};
+
+/** co_await to continue as a background job, see run_background(). */
+struct ResumeInBackground {
+    JobSystem& jobs;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        jobs.run_background([h] { h.resume(); });
+    }
+    void await_resume() const noexcept {}
+};
+
+#endif  // TASK_H
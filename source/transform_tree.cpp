@@ -0,0 +1,213 @@
+#include "transform_tree.h"
+#include <algorithm>
+#include <type_traits>
+#include "job_system.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define TRANSFORM_TREE_SSE
+#endif
+
+namespace {
+
+#ifdef TRANSFORM_TREE_SSE
+// quaternions as x, y, z, w lanes, vectors with w = 0
+__m128 load(glm::quat q) {
+    return _mm_setr_ps(q.x, q.y, q.z, q.w);
+}
+
+__m128 load(glm::vec3 v) {
+    return _mm_setr_ps(v.x, v.y, v.z, 0.f);
+}
+
+template <int lane>
+__m128 splat(__m128 v) {
+    return _mm_shuffle_ps(v, v, _MM_SHUFFLE(lane, lane, lane, lane));
+}
+
+/** Cross product of the xyz lanes, w is 0. */
+__m128 cross(__m128 a, __m128 b) {
+    // (a * b.yzx - a.yzx * b).yzx
+    __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+    return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+}
+#endif
+
+/** `parent` after the local transform from its parts. */
+void compose(Trs const& parent,
+             glm::vec3 t,
+             glm::quat q,
+             glm::vec3 s,
+             Trs& out) {
+#ifdef TRANSFORM_TREE_SSE
+    __m128 pq = load(parent.rotation);
+    __m128 lq = load(q);
+    __m128 pw = splat<3>(pq);
+
+    // parent rotation times (parent scale times t):
+    // v + 2w (u x v) + 2 u x (u x v), u and w the quaternion's parts
+    __m128 v = _mm_mul_ps(load(parent.scale), load(t));
+    __m128 uv2 = _mm_add_ps(cross(pq, v), cross(pq, v));
+    __m128 moved =
+        _mm_add_ps(_mm_add_ps(v, _mm_mul_ps(pw, uv2)), cross(pq, uv2));
+    alignas(16) float tr[4];
+    _mm_store_ps(tr, _mm_add_ps(load(parent.translation), moved));
+
+    // xyz: pw lu + lw pu + pu x lu, w: pw lw - pu . lu
+    __m128 lw = splat<3>(lq);
+    __m128 xyz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pw, lq), _mm_mul_ps(lw, pq)),
+                            cross(pq, lq));
+    alignas(16) float r[4];
+    alignas(16) float d[4];
+    _mm_store_ps(r, xyz);
+    _mm_store_ps(d, _mm_mul_ps(pq, lq));
+
+    out.translation = {tr[0], tr[1], tr[2]};
+    out.rotation = glm::quat{d[3] - d[0] - d[1] - d[2], r[0], r[1], r[2]};
+#else
+    out.translation = parent.apply(t);
+    out.rotation = parent.rotation * q;
+#endif
+    out.scale = parent.scale * s;
+}
+
+}  // namespace
+
+glm::mat4 Trs::matrix() const {
+    glm::mat4 m = glm::mat4_cast(rotation);
+    m[0] *= scale.x;
+    m[1] *= scale.y;
+    m[2] *= scale.z;
+    m[3] = glm::vec4(translation, 1.f);
+    return m;
+}
+
+glm::vec3 Trs::apply(glm::vec3 p) const {
+    return translation + rotation * (scale * p);
+}
+
+float Trs::max_scale() const {
+    return std::max({scale.x, scale.y, scale.z});
+}
+
+uint32_t TransformTree::add(Trs const& local, uint32_t parent) {
+    uint32_t id = _index.size();
+    uint32_t at = _parent.size();
+    uint32_t depth = 0;
+    if (parent != NONE) {
+        parent = _index[parent];
+        depth = _depth[parent] + 1;
+    }
+    _parent.push_back(parent);
+    _depth.push_back(depth);
+    _translation.push_back(local.translation);
+    _rotation.push_back(local.rotation);
+    _scale.push_back(local.scale);
+    _world.emplace_back();
+    _dirty.push_back(1);
+    _id.push_back(id);
+    _index.push_back(at);
+    _any_dirty = true;
+
+    // still breadth first if it's as deep as the deepest, or one deeper
+    uint32_t deepest = _levels.size() < 2 ? 0 : _levels.size() - 2;
+    if (_levels.empty()) {
+        _levels = {0, 1};
+    } else if (depth == deepest) {
+        _levels.back() = at + 1;
+    } else if (depth == deepest + 1) {
+        _levels.push_back(at + 1);
+    } else {
+        _sorted = false;
+    }
+    return id;
+}
+
+Trs TransformTree::local(uint32_t id) const {
+    uint32_t i = _index[id];
+    return {_translation[i], _rotation[i], _scale[i]};
+}
+
+void TransformTree::set_local(uint32_t id, Trs const& local) {
+    uint32_t i = _index[id];
+    _translation[i] = local.translation;
+    _rotation[i] = local.rotation;
+    _scale[i] = local.scale;
+    _dirty[i] = 1;
+    _any_dirty = true;
+}
+
+void TransformTree::update(JobSystem& jobs) {
+    if (!_sorted) {
+        sort();
+    }
+    if (!_any_dirty) {
+        return;
+    }
+    static const Trs identity{};
+    for (size_t l = 0; l + 1 < _levels.size(); ++l) {
+        uint32_t first = _levels[l];
+        uint32_t count = _levels[l + 1] - first;
+        jobs.parallel_for(count, 4096, [&, first](size_t begin, size_t end) {
+            for (size_t i = first + begin; i < first + end; ++i) {
+                // a dirty parent was done the level before, and marked its
+                // children's subtrees dirty on the way
+                uint32_t p = _parent[i];
+                if (!_dirty[i] && (p == NONE || !_dirty[p])) {
+                    continue;
+                }
+                _dirty[i] = 1;
+                compose(p == NONE ? identity : _world[p],
+                        _translation[i],
+                        _rotation[i],
+                        _scale[i],
+                        _world[i]);
+            }
+        });
+    }
+    std::fill(_dirty.begin(), _dirty.end(), 0);
+    _any_dirty = false;
+}
+
+void TransformTree::sort() {
+    // counting sort by depth, stable, so siblings keep their order
+    uint32_t n = size();
+    uint32_t depths = *std::max_element(_depth.begin(), _depth.end()) + 1;
+    _levels.assign(depths + 1, 0);
+    for (uint32_t i = 0; i < n; ++i) {
+        ++_levels[_depth[i] + 1];
+    }
+    for (uint32_t d = 0; d < depths; ++d) {
+        _levels[d + 1] += _levels[d];
+    }
+    std::vector<uint32_t> to(n);
+    std::vector<uint32_t> next(_levels.begin(), _levels.end() - 1);
+    for (uint32_t i = 0; i < n; ++i) {
+        to[i] = next[_depth[i]]++;
+    }
+
+    auto permute = [&](auto& items) {
+        std::remove_reference_t<decltype(items)> moved(n);
+        for (uint32_t i = 0; i < n; ++i) {
+            moved[to[i]] = items[i];
+        }
+        items.swap(moved);
+    };
+    for (auto& p : _parent) {
+        p = p == NONE ? NONE : to[p];
+    }
+    permute(_parent);
+    permute(_depth);
+    permute(_translation);
+    permute(_rotation);
+    permute(_scale);
+    permute(_world);
+    permute(_dirty);
+    permute(_id);
+    for (uint32_t i = 0; i < n; ++i) {
+        _index[_id[i]] = i;
+    }
+    _sorted = true;
+}
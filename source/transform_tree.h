@@ -0,0 +1,80 @@
+#ifndef TRANSFORM_TREE_H
+#define TRANSFORM_TREE_H
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+
+class JobSystem;
+
+/** A transform: scale, then rotate, then translate. */
+struct Trs {
+    glm::vec3 translation{0.f};
+    glm::quat rotation{1.f, 0.f, 0.f, 0.f};
+    glm::vec3 scale{1.f};
+
+    glm::mat4 matrix() const;
+
+    /** Point `p` transformed. */
+    glm::vec3 apply(glm::vec3 p) const;
+
+    /** The largest of the axes' scales, e.g. for bounding spheres. */
+    float max_scale() const;
+};
+
+/**
+ * Parent/child transforms, with world transforms recomputed only below
+ * nodes whose local transform changed.  World transforms are kept as
+ * parts too, which is exact when the scales above a node are uniform: a
+ * parent's non-uniform scale can shear its children.
+ *
+ * The nodes are kept breadth first, as a struct of arrays: each depth is
+ * one contiguous run, after all of its parents.  update() goes a depth at
+ * a time, each one split over the workers, so no node ever waits on
+ * another.  Adding a node above the deepest level reorders the arrays at
+ * the next update(); ids stay valid, they are mapped to the current
+ * position.  The quaternion products of parent times local are done with
+ * SSE where available.
+ */
+class TransformTree {
+   public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    /** A node under `parent`, NONE for a root.  Returns its id. */
+    uint32_t add(Trs const& local, uint32_t parent = NONE);
+
+    Trs local(uint32_t id) const;
+
+    /** Replace a node's local transform, its subtree is updated next. */
+    void set_local(uint32_t id, Trs const& local);
+
+    /** World transform as of the last update(). */
+    Trs const& world(uint32_t id) const { return _world[_index[id]]; }
+
+    /** Recompute the world transforms of changed subtrees, on `jobs`. */
+    void update(JobSystem& jobs);
+
+    uint32_t size() const { return _parent.size(); }
+
+   private:
+    /** Restore breadth first order after adds, see the class comment. */
+    void sort();
+
+    // by position, breadth first
+    std::vector<uint32_t> _parent;  // position, or NONE
+    std::vector<uint32_t> _depth;
+    std::vector<glm::vec3> _translation;
+    std::vector<glm::quat> _rotation;
+    std::vector<glm::vec3> _scale;
+    std::vector<Trs> _world;
+    std::vector<uint8_t> _dirty;  // local changed, or a parent's world
+    std::vector<uint32_t> _id;    // inverse of _index
+
+    std::vector<uint32_t> _index;   // id -> position
+    std::vector<uint32_t> _levels;  // first position of each depth, and end
+    bool _sorted{true};
+    bool _any_dirty{false};
+};
+
+#endif  // TRANSFORM_TREE_H
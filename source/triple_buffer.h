@@ -0,0 +1,56 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Hands the latest of a stream of values from one writer thread to one
+ * reader thread, without locks and without either ever waiting.  One slot
+ * is the writer's, one the reader's, and the third holds the latest
+ * published value; publishing and acquiring swap a slot with it.  The
+ * reader skips values that were overwritten before it got to them.
+ *
+ *   // writer                     // reader
+ *   auto& v = buf.back();         auto& v = buf.acquire();
+ *   fill(v);                      use(v);  // until the next acquire()
+ *   buf.publish();
+ *
+ * Slots are reused, so vectors in T keep their capacity.
+ */
+template <class T>
+class TripleBuffer {
+   public:
+    /** The writer's slot, holding whatever was there three publishes ago. */
+    T& back() { return _slots[_back]; }
+
+    /** Make back() the latest, and get another slot to write to. */
+    void publish() {
+        _back = _latest.exchange(_back | FRESH, std::memory_order_acq_rel) &
+                INDEX;
+    }
+
+    /**
+     * The latest published value, or the same as last time if nothing was
+     * published since.  Stays valid until the next call.
+     */
+    T const& acquire() {
+        if (_latest.load(std::memory_order_relaxed) & FRESH) {
+            _front = _latest.exchange(_front, std::memory_order_acq_rel) &
+                     INDEX;
+        }
+        return _slots[_front];
+    }
+
+   private:
+    static constexpr uint8_t INDEX = 3;
+    static constexpr uint8_t FRESH = 4;  // published, not acquired yet
+
+    std::array<T, 3> _slots;
+    uint8_t _back{0};                 // writer only
+    uint8_t _front{1};                // reader only
+    std::atomic<uint8_t> _latest{2};  // slot index | FRESH
+};
+
+#endif  // TRIPLE_BUFFER_H
@@ -29,13 +29,15 @@ VkCommandBufferAllocateInfo vkinit::command_buffer_allocate_info(
 
 VkPipelineShaderStageCreateInfo vkinit::pipeline_shader_stage_create_info(
     VkShaderStageFlagBits stage,
-    VkShaderModule shader_module) {
+    VkShaderModule shader_module,
+    VkSpecializationInfo const* spec) {
     VkPipelineShaderStageCreateInfo info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .pNext = nullptr,
         .stage = stage,
         .module = shader_module,
         .pName = "main",  // entry point
+        .pSpecializationInfo = spec,  // nullptr: use constant defaults
     };
     return info;
 }
@@ -199,6 +201,21 @@ VkImageViewCreateInfo vkinit::imageview_create_info(VkFormat format,
     return info;
 }
 
+VkSamplerCreateInfo vkinit::sampler_create_info(
+    VkFilter filter,
+    VkSamplerAddressMode address_mode) {
+    VkSamplerCreateInfo info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext = nullptr,
+        .magFilter = filter,
+        .minFilter = filter,
+        .addressModeU = address_mode,
+        .addressModeV = address_mode,
+        .addressModeW = address_mode,
+    };
+    return info;
+}
+
 VkPipelineDepthStencilStateCreateInfo
 vkinit::depth_stencil_create_info(bool test, bool write, VkCompareOp compare) {
     VkPipelineDepthStencilStateCreateInfo info = {
@@ -17,7 +17,8 @@ VkCommandBufferAllocateInfo command_buffer_allocate_info(
 
 VkPipelineShaderStageCreateInfo pipeline_shader_stage_create_info(
     VkShaderStageFlagBits flags,
-    VkShaderModule shader_module);
+    VkShaderModule shader_module,
+    VkSpecializationInfo const* spec = nullptr);
 
 VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info();
 VkPipelineVertexInputStateCreateInfo vertex_input_state_create_info(
@@ -49,6 +50,10 @@ VkImageViewCreateInfo imageview_create_info(VkFormat format,
                                             VkImage image,
                                             VkImageAspectFlags flags);
 
+VkSamplerCreateInfo sampler_create_info(
+    VkFilter filter,
+    VkSamplerAddressMode address_mode = VK_SAMPLER_ADDRESS_MODE_REPEAT);
+
 VkPipelineDepthStencilStateCreateInfo
 depth_stencil_create_info(bool test, bool write, VkCompareOp compare);
 
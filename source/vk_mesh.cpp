@@ -1,7 +1,12 @@
 #include "vk_mesh.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
+#include <algorithm>
+#include <glm/geometric.hpp>
 #include <iostream>
+#include <random>
+#include "job_system.h"
+#include "mesh_simplify.h"
 
 VertInputDesc Vert::get_desc() {
     VkVertexInputBindingDescription main_binding = {
@@ -53,6 +58,31 @@ Vert Vert::from_idx(tinyobj::attrib_t const& attrib,
     return vert;
 }
 
+void Mesh::compute_bounds() {
+    if (verts.empty()) {
+        return;
+    }
+    glm::vec3 lo = verts[0].pos;
+    glm::vec3 hi = verts[0].pos;
+    for (auto& v : verts) {
+        lo = glm::min(lo, v.pos);
+        hi = glm::max(hi, v.pos);
+    }
+    glm::vec3 center = (lo + hi) / 2.f;
+    float radius = 0;
+    for (auto& v : verts) {
+        radius = std::max(radius, glm::length(v.pos - center));
+    }
+    bounds = glm::vec4(center, radius);
+}
+
+MeshLod Mesh::lod(uint32_t level) const {
+    if (lods.empty()) {
+        return {0, (uint32_t)vert_count, 0.f};
+    }
+    return lods[std::min<size_t>(level, lods.size() - 1)];
+}
+
 Mesh Mesh::make_simple_triangle() {
     return Mesh{.verts = {
                     {
@@ -70,24 +100,57 @@ Mesh Mesh::make_simple_triangle() {
                 }};
 }
 
-Mesh Mesh::make_point_cloud(size_t count) {
-    std::vector<Vert> verts{};
-    for (size_t i = 0; i < count; ++i) {
-        glm::vec3 pos{
-            (float)std::rand() / (float)RAND_MAX - 0.5f,
-            (float)std::rand() / (float)RAND_MAX - 0.5f,
-            (float)std::rand() / (float)RAND_MAX - 0.5f,
-        };
-        Vert v{
-            .pos = pos,
-            .color = pos + 0.5f,
-        };
-        verts.push_back(v);
+/** Random points in a unit cube, colored by position. */
+static void fill_points(Vert* verts,
+                        size_t count,
+                        JobSystem& jobs,
+                        uint32_t seed) {
+    const size_t batch = 1 << 16;
+    jobs.parallel_for(count, batch, [&](size_t begin, size_t end) {
+        // one generator per batch, so the result doesn't depend on who ran it
+        std::minstd_rand rng{seed * 7919u + (uint32_t)(begin / batch) + 1};
+        std::uniform_real_distribution<float> coord{-0.5f, 0.5f};
+        for (size_t i = begin; i < end; ++i) {
+            glm::vec3 pos{coord(rng), coord(rng), coord(rng)};
+            verts[i] = {
+                .pos = pos,
+                .color = pos + 0.5f,
+            };
+        }
+    });
+}
+
+Mesh Mesh::make_point_cloud(size_t count, JobSystem& jobs, uint32_t seed) {
+    std::vector<Vert> verts(count);
+    fill_points(verts.data(), count, jobs, seed);
+    return Mesh{.verts = std::move(verts)};
+}
+
+void Mesh::regenerate_points(uint32_t first,
+                             uint32_t count,
+                             JobSystem& jobs,
+                             uint32_t seed) {
+    count = std::min<size_t>(count, verts.size() - first);
+    fill_points(verts.data() + first, count, jobs, seed);
+    mark_dirty(first, count);
+}
+
+void Mesh::mark_dirty(uint32_t first, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+    // extend the last range if this one continues it, the common case
+    if (!dirty.empty()) {
+        auto& last = dirty.back();
+        if (first >= last.first && first <= last.first + last.count) {
+            last.count = std::max(last.count, first + count - last.first);
+            return;
+        }
     }
-    return Mesh{.verts = verts};
+    dirty.push_back({first, count});
 }
 
-Mesh Mesh::load_from_obj(const char* file_path, bool with_tris) {
+Mesh Mesh::load_from_obj(const char* file_path) {
     tinyobj::attrib_t attrib;  // vertex arrays
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
@@ -111,26 +174,19 @@ Mesh Mesh::load_from_obj(const char* file_path, bool with_tris) {
     Mesh m{};
     size_t idx_offset = 0;
     for (auto shape : shapes) {
-        if (with_tris) {  // as triangle list
-            for (auto vert_count : shape.mesh.num_face_vertices) {
-                int fv = 3;  // only tris for now
-                for (size_t v = 0; v < fv; ++v) {
-                    auto idx = shape.mesh.indices[idx_offset + v];
-                    auto vert = Vert::from_idx(
-                        attrib, fv * idx.vertex_index, fv * idx.normal_index);
-                    m.verts.push_back(vert);
-                }
-                idx_offset += fv;
-            }
-        } else {  // just load verts
-            auto n_verts = attrib.vertices.size() / 3;
-            for (size_t i = 0; i < n_verts; ++i) {
-                auto vert =
-                    Vert::from_idx(attrib, 3 * i, 3 * i);  // TODO correct?
+        // as triangle list
+        for (auto vert_count : shape.mesh.num_face_vertices) {
+            int fv = 3;  // only tris for now
+            for (size_t v = 0; v < fv; ++v) {
+                auto idx = shape.mesh.indices[idx_offset + v];
+                auto vert = Vert::from_idx(
+                    attrib, fv * idx.vertex_index, fv * idx.normal_index);
                 m.verts.push_back(vert);
             }
+            idx_offset += fv;
         }
     }
 
+    build_lod_chain(m);
     return m;
 }
@@ -3,12 +3,16 @@
 
 #include <tiny_obj_loader.h>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 #include <memory>
 #include <vector>
 #include "vk_types.h"
 
 #define ASSETS_DIRECTORY "../../assets/"
 
+class JobSystem;
+class PointOctree;
+
 struct VertInputDesc {
     std::vector<VkVertexInputBindingDescription> bindings;
     std::vector<VkVertexInputAttributeDescription> attribs;
@@ -26,14 +30,66 @@ struct Vert {
                          size_t normal_idx);
 };
 
+/** A level of detail: vertices [first, first + count) of the mesh. */
+struct MeshLod {
+    uint32_t first;
+    uint32_t count;
+    float error;  // how far the surface moved, in model units
+};
+
+/** Vertices [first, first + count) of a point cloud's vertex buffer. */
+struct PointRange {
+    uint32_t first;
+    uint32_t count;
+};
+
+/** Points [first, first + count) of a mesh, and their bounding box. */
+struct PointChunk {
+    uint32_t first;
+    uint32_t count;
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
 struct Mesh {
-    std::vector<Vert> verts;
-    std::shared_ptr<AllocatedBuffer> buf;
-    std::shared_ptr<AllocatedBuffer> staging_buf;
+    std::vector<Vert> verts;  // CPU copy, may be dropped after upload
+    size_t vert_count{0};     // in the device buffer
+    VkBuffer buf{VK_NULL_HANDLE};  // the geometry arena or own_buf, if any
+    uint32_t first_vert{0};        // where vertex 0 is in buf
+    std::shared_ptr<AllocatedBuffer> own_buf;  // too large for the arena
+    std::shared_ptr<AllocatedBuffer> staging_buf;  // while uploading
+    bool dynamic{false};  // re-uploaded at runtime
+    std::vector<PointRange> dirty;  // verts changed since the last upload
+    std::shared_ptr<PointOctree> octree;  // point clouds, verts in its order
+    glm::vec4 bounds{0.f};  // bounding sphere in model space: center, radius
+    std::vector<MeshLod> lods;  // finest first, all in verts; see lod()
+    std::vector<PointChunk> chunks;  // point clouds, see sort_points_morton()
+
+    /** Range of LOD `level`, clamped; the whole mesh if there are none. */
+    MeshLod lod(uint32_t level) const;
+
+    /** Set bounds from the vertices' bounding box. */
+    void compute_bounds();
+
+    /** Note that verts [first, first + count) changed, see dirty. */
+    void mark_dirty(uint32_t first, uint32_t count);
+
+    /**
+     * Replace points [first, first + count) of a make_point_cloud() cloud
+     * with new random ones, and mark them dirty.
+     */
+    void regenerate_points(uint32_t first,
+                           uint32_t count,
+                           JobSystem& jobs,
+                           uint32_t seed);
 
     static Mesh make_simple_triangle();
-    static Mesh load_from_obj(const char* file_path, bool with_tris = true);
-    static Mesh make_point_cloud(size_t count);
+    /** A triangle list with a LOD chain, see build_lod_chain(). */
+    static Mesh load_from_obj(const char* file_path);
+    /** Random points in a unit cube, generated on `jobs`. */
+    static Mesh make_point_cloud(size_t count,
+                                 JobSystem& jobs,
+                                 uint32_t seed = 0);
 };
 
 #endif  // VK_MESH_H
@@ -0,0 +1,88 @@
+#include "voxel_filter.h"
+#include <algorithm>
+#include <vector>
+#include "job_system.h"
+#include "point_sort.h"
+
+size_t voxel_downsample(Vert const* src,
+                        size_t count,
+                        Vert* dst,
+                        float voxel_size,
+                        VoxelMode mode,
+                        JobSystem& jobs) {
+    if (count == 0) {
+        return 0;
+    }
+
+    // 21 bits of cell per axis fit a 64-bit Morton code
+    const uint32_t max_cell = (1u << 21) - 1;
+    glm::vec3 min, max;
+    point_bounds(src, count, jobs, min, max);
+    glm::vec3 extent = max - min;
+    float largest = std::max({extent.x, extent.y, extent.z});
+    float inv_size = 1.f / std::max(voxel_size, largest / max_cell);
+
+    const size_t batch = 1 << 16;
+    std::vector<uint64_t> keys(count);
+    jobs.parallel_for(count, batch, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            glm::uvec3 cell = glm::min(
+                glm::uvec3((src[i].pos - min) * inv_size), max_cell);
+            keys[i] = morton_code(cell);
+        }
+    });
+    std::vector<uint32_t> order;
+    radix_sort(keys, order, jobs);
+
+    // where each voxel's run of points starts: counted per batch, summed
+    // up, then written
+    size_t batches = (count + batch - 1) / batch;
+    std::vector<size_t> firsts(batches + 1, 0);
+    jobs.parallel_for(count, batch, [&](size_t begin, size_t end) {
+        size_t runs = 0;
+        for (size_t i = begin; i < end; ++i) {
+            runs += i == 0 || keys[i] != keys[i - 1];
+        }
+        firsts[begin / batch + 1] = runs;
+    });
+    for (size_t b = 0; b < batches; ++b) {
+        firsts[b + 1] += firsts[b];
+    }
+    size_t voxels = firsts[batches];
+    std::vector<uint32_t> starts(voxels + 1);
+    starts[voxels] = count;
+    jobs.parallel_for(count, batch, [&](size_t begin, size_t end) {
+        size_t run = firsts[begin / batch];
+        for (size_t i = begin; i < end; ++i) {
+            if (i == 0 || keys[i] != keys[i - 1]) {
+                starts[run++] = i;
+            }
+        }
+    });
+
+    jobs.parallel_for(voxels, batch / 8, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            uint32_t first = starts[v];
+            uint32_t last = starts[v + 1];
+            if (mode == VoxelMode::First || last - first == 1) {
+                dst[v] = src[order[first]];
+                continue;
+            }
+            Vert sum = {};
+            for (uint32_t i = first; i < last; ++i) {
+                Vert const& p = src[order[i]];
+                sum.pos += p.pos;
+                sum.normal += p.normal;
+                sum.color += p.color;
+            }
+            float n = last - first;
+            float len = glm::length(sum.normal);
+            dst[v] = {
+                .pos = sum.pos / n,
+                .normal = len > 0.f ? sum.normal / len : glm::vec3{0.f},
+                .color = sum.color / n,
+            };
+        }
+    });
+    return voxels;
+}
@@ -0,0 +1,34 @@
+#ifndef VOXEL_FILTER_H
+#define VOXEL_FILTER_H
+
+#include <cstddef>
+#include "vk_mesh.h"
+
+class JobSystem;
+
+enum class VoxelMode {
+    Average,  // mean position, normal and color of the voxel's points
+    First,    // the voxel's first point, as it was
+};
+
+/**
+ * Keep one point per cube of edge `voxel_size`, on a grid anchored at the
+ * points' bounding box, and write them to `dst` in Morton order of their
+ * voxels.  Returns how many were kept, at most `count`.  `dst` is only
+ * written, so it may be a mapped staging buffer, but must not overlap
+ * `src`.
+ *
+ * Points are keyed by their voxel and grouped with radix_sort() rather
+ * than a shared hash table, so all of it runs in parallel on `jobs`
+ * without contention, and the result doesn't depend on the schedule.  The
+ * sort is stable, so the first point of a voxel is the first in `src`.
+ * Grids finer than 2^21 voxels along an axis are coarsened to that.
+ */
+size_t voxel_downsample(Vert const* src,
+                        size_t count,
+                        Vert* dst,
+                        float voxel_size,
+                        VoxelMode mode,
+                        JobSystem& jobs);
+
+#endif  // VOXEL_FILTER_H